@@ -8,6 +8,8 @@
 #include <QtCore/QUuid>
 #include <QtCore/QtEndian>
 
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 
 Q_LOGGING_CATEGORY(lcMqttClient, "qt.mqtt.client")
@@ -28,6 +30,15 @@ Q_LOGGING_CATEGORY(lcMqttClient, "qt.mqtt.client")
     might be interested in receiving, subscribe to request notifications on
     topics, unsubscribe to remove a request for notifications, and disconnect
     from the broker.
+
+    The client handles its transport and notifies subscriptions in the thread
+    it lives in. To keep slow receivers from delaying network traffic and keep
+    alive messages, a disconnected client can be moved to a dedicated thread
+    with QObject::moveToThread(). The transport it creates and its
+    subscriptions follow it. QMqttMessageQueue passes received messages on to
+    consumers in other threads, postPublish() sends messages produced in other
+    threads, and statistics() reads the counters of the client from any
+    thread.
 */
 
 /*!
@@ -151,6 +162,70 @@ Q_LOGGING_CATEGORY(lcMqttClient, "qt.mqtt.client")
     \sa keepAlive(), requestPing(), serverConnectionProperties(), pingResponseReceived()
 */
 
+/*!
+    \property QMqttClient::messageReceivedSignalEnabled
+    \since 6.9
+    \brief This property holds whether messageReceived() is emitted for every
+    received message.
+
+    Applications which only handle messages via subscriptions can disable the
+    signal to save its emission for each message. Subscriptions are notified
+    independently of this property.
+
+    The default of this property is \c true.
+
+    \sa QMqttSubscription::setMessageHandler()
+*/
+
+/*!
+    \property QMqttClient::payloadSharingEnabled
+    \since 6.9
+    \brief This property holds whether the payload of received messages shares
+    the memory of the receive buffer.
+
+    By default, the payload of each received message is copied out of the
+    receive buffer of the client. If payload sharing is enabled, the payload of
+    QMqttMessage and messageReceived() references the received data instead.
+    This avoids copying large payloads between the transport and the
+    subscribers.
+
+    \note A shared payload is not guaranteed to be null-terminated. Do not pass
+    \c{payload().constData()} to functions expecting a null-terminated string.
+
+    \note As long as a shared payload is referenced, the memory of the data
+    received together with it stays allocated. Applications storing received
+    messages for a long time should keep payload sharing disabled.
+
+    The default of this property is \c false.
+
+    \sa messageReceived(), QMqttMessage::payload()
+*/
+
+/*!
+    \property QMqttClient::publishQueueLimit
+    \since 6.9
+    \brief This property holds the maximum number of messages queued locally.
+
+    A value of \c 0 means that the number of queued messages is not limited.
+    Negative values are treated as \c 0.
+
+    The server announces the maximum number of QoS 1 and QoS 2 messages it
+    is willing to process concurrently as
+    QMqttServerConnectionProperties::maximumReceive(). Messages published
+    while this many messages are awaiting their acknowledgment are queued
+    locally and sent as soon as acknowledgments arrive. Once messages are
+    queued, messages of QoS 0 are queued as well to keep the order of all
+    messages.
+
+    If the queue is full, publish() fails and returns \c -1.
+
+    \note Messages still queued when the connection is closed are discarded.
+
+    The default of this property is \c 0.
+
+    \sa publishQueueSize(), publishBackpressureChanged()
+*/
+
 /*!
     \enum QMqttClient::TransportType
 
@@ -244,6 +319,8 @@ Q_LOGGING_CATEGORY(lcMqttClient, "qt.mqtt.client")
 
     This signal is emitted when a new message has been received. The category of
     the message is specified by \a topic with the content being \a message.
+
+    \sa messageReceivedSignalEnabled
 */
 
 /*!
@@ -281,6 +358,20 @@ Q_LOGGING_CATEGORY(lcMqttClient, "qt.mqtt.client")
     clientId.
 */
 
+/*!
+    \since 6.9
+    \fn QMqttClient::publishBackpressureChanged(bool backpressure)
+
+    This signal is emitted when messages start to be queued locally, with
+    \a backpressure set to \c true, and when all queued messages have been
+    sent, with \a backpressure set to \c false.
+
+    Producers publishing at a high rate can use this signal to pause
+    publishing while the server does not accept further messages.
+
+    \sa publishQueueLimit, publishQueueSize()
+*/
+
 /*!
     \since 5.12
     \fn QMqttClient::authenticationRequested(const QMqttAuthenticationProperties &p)
@@ -318,7 +409,8 @@ Q_LOGGING_CATEGORY(lcMqttClient, "qt.mqtt.client")
 QMqttClient::QMqttClient(QObject *parent) : QObject(*(new QMqttClientPrivate(this)), parent)
 {
     Q_D(QMqttClient);
-    d->m_connection.setClientPrivate(d);
+    d->m_connection = new QMqttConnection(this);
+    d->m_connection->setClientPrivate(d);
 }
 
 /*!
@@ -328,8 +420,8 @@ QMqttClient::QMqttClient(QObject *parent) : QObject(*(new QMqttClientPrivate(thi
 QMqttClient::~QMqttClient()
 {
     Q_D(QMqttClient);
-    if (d->m_connection.internalState() == QMqttConnection::BrokerConnected) {
-        d->m_connection.setClientDestruction();
+    if (d->m_connection->internalState() == QMqttConnection::BrokerConnected) {
+        d->m_connection->setClientDestruction();
         disconnectFromHost();
     }
 }
@@ -353,7 +445,7 @@ void QMqttClient::setTransport(QIODevice *device, QMqttClient::TransportType tra
         qCDebug(lcMqttClient) << "Changing transport layer while connected is not possible.";
         return;
     }
-    d->m_connection.setTransport(device, transport);
+    d->m_connection->setTransport(device, transport);
 }
 
 /*!
@@ -362,7 +454,7 @@ void QMqttClient::setTransport(QIODevice *device, QMqttClient::TransportType tra
 QIODevice *QMqttClient::transport() const
 {
     Q_D(const QMqttClient);
-    return d->m_connection.transport();
+    return d->m_connection->transport();
 }
 
 /*!
@@ -394,6 +486,14 @@ QMqttSubscription *QMqttClient::subscribe(const QMqttTopicFilter &topic, quint8
 
     \note \a properties will only be passed to the broker when the client
     specifies MQTT_5_0 as ProtocolVersion.
+
+    Since Qt 6.9, if \a properties do not specify a subscription identifier
+    and the broker supports subscription identifiers, the client assigns
+    one to dispatch received messages without matching their topic. Such
+    identifiers are reported by
+    QMqttPublishProperties::subscriptionIdentifiers() of received messages
+    like identifiers set with
+    QMqttSubscriptionProperties::setSubscriptionIdentifier().
 */
 QMqttSubscription *QMqttClient::subscribe(const QMqttTopicFilter &topic, const QMqttSubscriptionProperties &properties, quint8 qos)
 {
@@ -402,7 +502,30 @@ QMqttSubscription *QMqttClient::subscribe(const QMqttTopicFilter &topic, const Q
     if (d->m_state != QMqttClient::Connected)
         return nullptr;
 
-    return d->m_connection.sendControlSubscribe(topic, qos, properties);
+    return d->m_connection->sendControlSubscribe(topic, qos, properties);
+}
+
+/*!
+    \since 6.9
+
+    Adds a new subscription to receive notifications on \a topic with the
+    level \a qos and sets \a handler as its message handler.
+
+    This function returns a pointer to a \l QMqttSubscription, or \c nullptr if
+    the subscription could not be created. If the same topic is subscribed
+    twice, the return value points to the same subscription instance and
+    \a handler replaces its previous handler. The MQTT client is the owner of
+    the subscription.
+
+    \sa QMqttSubscription::setMessageHandler(), messageReceivedSignalEnabled
+*/
+QMqttSubscription *QMqttClient::subscribe(const QMqttTopicFilter &topic, quint8 qos,
+                                          const QMqttSubscription::MessageHandler &handler)
+{
+    QMqttSubscription *subscription = subscribe(topic, qos);
+    if (subscription)
+        subscription->setMessageHandler(handler);
+    return subscription;
 }
 
 /*!
@@ -433,9 +556,150 @@ void QMqttClient::unsubscribe(const QMqttTopicFilter &topic)
 void QMqttClient::unsubscribe(const QMqttTopicFilter &topic, const QMqttUnsubscriptionProperties &properties)
 {
     Q_D(QMqttClient);
-    d->m_connection.sendControlUnsubscribe(topic, properties);
+    d->m_connection->sendControlUnsubscribe(topic, properties);
 }
 
+#if QT_CONFIG(future)
+/*!
+    \since 6.9
+
+    Subscribes to \a topic with the level \a qos like subscribe(), and
+    returns a future which finishes once the broker acknowledged the
+    subscription.
+
+    See the overload taking QMqttSubscriptionProperties for details.
+*/
+QFuture<QMqttSubscription *> QMqttClient::subscribeAsync(const QMqttTopicFilter &topic, quint8 qos)
+{
+    return subscribeAsync(topic, QMqttSubscriptionProperties(), qos);
+}
+
+/*!
+    \since 6.9
+
+    Subscribes to \a topic with the specified \a properties and the level
+    \a qos like subscribe(), and returns a future which finishes once the
+    broker acknowledged the subscription.
+
+    The result of the future is the subscription. Its \l{QMqttSubscription::}{state()}
+    and \l{QMqttSubscription::}{reasonCode()} tell whether the broker accepted
+    it. If \a topic has been subscribed before, the future provides the
+    existing subscription once it has been acknowledged.
+
+    The future is canceled if the subscription could not be requested, for
+    instance because the client is not connected, or if the connection is
+    closed before the broker acknowledged it.
+
+    Unlike stateChanged() of the subscription, the future allows to await many
+    subscriptions without connecting to each of them. Continuations attached
+    with QFuture::then() without a context object are called in the thread of
+    the client.
+
+    \sa subscribe(), unsubscribeAsync()
+*/
+QFuture<QMqttSubscription *> QMqttClient::subscribeAsync(const QMqttTopicFilter &topic,
+                                                         const QMqttSubscriptionProperties &properties,
+                                                         quint8 qos)
+{
+    Q_D(QMqttClient);
+    QFutureInterface<QMqttSubscription *> result(QFutureInterfaceBase::Started);
+    const QFuture<QMqttSubscription *> future = result.future();
+    QMqttCompletion completion(result);
+
+    QMqttSubscription *subscription = nullptr;
+    if (d->m_state == QMqttClient::Connected)
+        subscription = d->m_connection->sendControlSubscribe(topic, qos, properties, &completion);
+
+    // An existing subscription has been returned, the SUBACK might still be pending.
+    if (subscription && completion.isPending()) {
+        if (subscription->state() == QMqttSubscription::SubscriptionPending) {
+            // Finished like the request which created the subscription: once the
+            // broker answered, or canceled if the connection is closed before.
+            // Both connections are dropped if the subscription is deleted, which
+            // cancels the future as well.
+            struct Waiter {
+                QMqttCompletion completion;
+                QMetaObject::Connection stateConnection;
+                QMetaObject::Connection disconnectConnection;
+                QMqttCompletion take()
+                {
+                    QObject::disconnect(stateConnection);
+                    QObject::disconnect(disconnectConnection);
+                    return std::move(completion);
+                }
+            };
+            auto waiter = std::make_shared<Waiter>();
+            waiter->completion = std::move(completion);
+            const auto onStateChanged = [subscription, waiter](QMqttSubscription::SubscriptionState state) {
+                switch (state) {
+                case QMqttSubscription::Subscribed:
+                case QMqttSubscription::Error:
+                    waiter->take().finish(subscription);
+                    break;
+                case QMqttSubscription::Unsubscribed:
+                    waiter->take().cancel();
+                    break;
+                default:
+                    break;
+                }
+            };
+            waiter->stateConnection = connect(subscription, &QMqttSubscription::stateChanged,
+                                              subscription, onStateChanged);
+            waiter->disconnectConnection = connect(this, &QMqttClient::disconnected,
+                                                   subscription, [waiter]() {
+                waiter->take().cancel();
+            });
+            return future;
+        }
+        completion.finish(subscription);
+    }
+    return future;
+}
+
+/*!
+    \since 6.9
+
+    Unsubscribes from \a topic like unsubscribe(), and returns a future which
+    finishes once the broker acknowledged it.
+
+    See the overload taking QMqttUnsubscriptionProperties for details.
+*/
+QFuture<QMqtt::ReasonCode> QMqttClient::unsubscribeAsync(const QMqttTopicFilter &topic)
+{
+    return unsubscribeAsync(topic, QMqttUnsubscriptionProperties());
+}
+
+/*!
+    \since 6.9
+
+    Unsubscribes from \a topic with the specified \a properties like
+    unsubscribe(), and returns a future which finishes once the broker
+    acknowledged it.
+
+    The result of the future is the reason code sent by the broker, or
+    QMqtt::ReasonCode::Success for MQTT 3.1 and 3.1.1. If the client is not
+    connected, the subscription is removed locally and the future finishes
+    with QMqtt::ReasonCode::Success right away.
+
+    The future is canceled if \a topic has not been subscribed, or if the
+    connection is closed before the broker acknowledged the request.
+
+    \sa unsubscribe(), subscribeAsync()
+*/
+QFuture<QMqtt::ReasonCode> QMqttClient::unsubscribeAsync(const QMqttTopicFilter &topic,
+                                                         const QMqttUnsubscriptionProperties &properties)
+{
+    Q_D(QMqttClient);
+    QFutureInterface<QMqtt::ReasonCode> result(QFutureInterfaceBase::Started);
+    const QFuture<QMqtt::ReasonCode> future = result.future();
+    QMqttCompletion completion(result);
+
+    if (d->m_connection->sendControlUnsubscribe(topic, properties, &completion))
+        completion.finish(QMqtt::ReasonCode::Success); // No-op if waiting for UNSUBACK
+    return future;
+}
+#endif // QT_CONFIG(future)
+
 /*!
     Publishes a \a message to the broker with the specified \a topic. \a qos
     specifies the QoS level required for transferring the message.
@@ -475,8 +739,128 @@ qint32 QMqttClient::publish(const QMqttTopicName &topic, const QMqttPublishPrope
     if (d->m_state != QMqttClient::Connected)
         return -1;
 
-    return d->m_connection.sendControlPublish(topic, message, qos, retain, properties);
+    return d->m_connection->sendControlPublish(topic, message, qos, retain, properties);
+}
+
+#if QT_CONFIG(future)
+/*!
+    \since 6.9
+
+    Publishes a \a message to the broker with the specified \a topic like
+    publish(). \a qos specifies the QoS level required for transferring the
+    message. If \a retain is set to \c true, the message will stay on the
+    broker for other clients to connect and receive the message.
+
+    See the overload taking QMqttPublishProperties for details.
+*/
+QFuture<QMqtt::ReasonCode> QMqttClient::publishAsync(const QMqttTopicName &topic,
+                                                     const QByteArray &message, quint8 qos,
+                                                     bool retain)
+{
+    return publishAsync(topic, QMqttPublishProperties(), message, qos, retain);
+}
+
+/*!
+    \since 6.9
+
+    Publishes a \a message to the broker with the specified \a properties and
+    \a topic like publish(). \a qos specifies the QoS level required for
+    transferring the message. If \a retain is set to \c true, the message
+    will stay on the broker for other clients to connect and receive the
+    message.
+
+    Returns a future which finishes once the delivery of the message has
+    been completed: when PUBACK has been received for QoS level 1, and when
+    PUBCOMP has been received for QoS level 2. The result is the reason code
+    sent by the broker, or QMqtt::ReasonCode::Success for MQTT 3.1 and 3.1.1.
+    A PUBREC with a failure reason code finishes the future with that code.
+    Messages with QoS level 0 are not acknowledged, the future finishes with
+    QMqtt::ReasonCode::Success once the message has been handed to the
+    transport or queued.
+
+    The future is canceled if the message could not be sent, or if it is
+    discarded before it has been acknowledged, for instance when reconnecting
+    without resuming the session.
+
+    The future allows pipelining many messages without keeping track of
+    their IDs and the messageStatusChanged() or messageSent() signals.
+    Continuations attached with QFuture::then() without a context object are
+    called in the thread of the client.
+
+    \sa publish(), postPublish()
+*/
+QFuture<QMqtt::ReasonCode> QMqttClient::publishAsync(const QMqttTopicName &topic,
+                                                     const QMqttPublishProperties &properties,
+                                                     const QByteArray &message, quint8 qos,
+                                                     bool retain)
+{
+    Q_D(QMqttClient);
+    QFutureInterface<QMqtt::ReasonCode> result(QFutureInterfaceBase::Started);
+    const QFuture<QMqtt::ReasonCode> future = result.future();
+    QMqttCompletion completion(result);
+
+    if (qos > 2 || d->m_state != QMqttClient::Connected)
+        return future;
+
+    const qint32 id = d->m_connection->sendControlPublish(topic, message, qos, retain, properties,
+                                                         &completion);
+    if (id == 0)
+        completion.finish(QMqtt::ReasonCode::Success);
+    return future;
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Publishes a \a message to the broker with the specified \a topic from any
+    thread. \a qos specifies the QoS level required for transferring the
+    message. If \a retain is set to \c true, the message will stay on the
+    broker for other clients to connect and receive the message.
+
+    See the overload taking QMqttPublishProperties for details.
+*/
+QFuture<qint32> QMqttClient::postPublish(const QMqttTopicName &topic, const QByteArray &message,
+                                         quint8 qos, bool retain)
+{
+    return postPublish(topic, QMqttPublishProperties(), message, qos, retain);
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Publishes a \a message to the broker with the specified \a properties and
+    \a topic, like publish(). \a qos specifies the QoS level required for
+    transferring the message. If \a retain is set to \c true, the message
+    will stay on the broker for other clients to connect and receive the
+    message.
+
+    Unlike publish(), this function can be called from any thread. The
+    message is added to a lock-free queue and sent from the thread the client
+    lives in. Messages posted until that thread processes the queue are sent
+    together in one batch, no event is posted for each of them. Messages
+    posted from the same thread are sent in the order they have been posted.
+
+    Returns a future providing the result of publish() once the message has
+    been sent: the ID of the message, \c 0 for QoS level 0, or \c -1 if the
+    message could not be sent, for instance because the client is not
+    connected. The future never reports \c -1 for a message which has been
+    sent.
+
+    \note The client must not be deleted while another thread calls this
+    function.
+
+    \sa publish(), beginBatch()
+*/
+QFuture<qint32> QMqttClient::postPublish(const QMqttTopicName &topic,
+                                         const QMqttPublishProperties &properties,
+                                         const QByteArray &message, quint8 qos, bool retain)
+{
+    Q_D(QMqttClient);
+    return d->m_connection->postPublish(topic, message, qos, retain, properties);
 }
+#endif // QT_CONFIG(future)
 
 /*!
     Sends a ping message to the broker and expects a reply.
@@ -497,7 +881,198 @@ qint32 QMqttClient::publish(const QMqttTopicName &topic, const QMqttPublishPrope
 bool QMqttClient::requestPing()
 {
     Q_D(QMqttClient);
-    return d->m_connection.sendControlPingRequest(false);
+    return d->m_connection->sendControlPingRequest(false);
+}
+
+/*!
+    \since 6.9
+
+    Starts a batch of outgoing packets.
+
+    While a batch is active, the PUBLISH packets created by publish() are
+    not written to the transport one by one. Instead, they are collected and
+    written together when the batch ends. This reduces the overhead per
+    packet when publishing many small messages at a high rate.
+
+    Batches can be nested. The collected packets are written when the
+    outermost batch ends. To limit the memory used by a batch, collected
+    packets are also written as soon as they exceed 64 KiB.
+
+    Other packets, like acknowledgments, keep-alive pings, subscriptions or
+    a disconnect, are never collected. Before such a packet is written, all
+    collected packets are written to keep the order.
+
+    Batching only applies to an established connection. If the collected
+    packets cannot be written, the messages are treated as if publish() had
+    failed for them and are not retransmitted.
+
+    \note Collected messages are not sent before endBatch() is called, so
+    each call to beginBatch() must be followed by a call to endBatch().
+
+    \sa endBatch()
+*/
+void QMqttClient::beginBatch()
+{
+    Q_D(QMqttClient);
+    d->m_connection->beginBatch();
+}
+
+/*!
+    \since 6.9
+
+    Ends a batch of outgoing packets started with beginBatch(). When the
+    outermost batch ends, all collected packets are written to the transport
+    at once.
+
+    Returns \c true if the packets could be written, or if the ended batch
+    is nested into another batch.
+
+    \sa beginBatch()
+*/
+bool QMqttClient::endBatch()
+{
+    Q_D(QMqttClient);
+    return d->m_connection->endBatch();
+}
+
+/*!
+    \since 6.9
+
+    Sets the session store used to persist outbound messages to \a store.
+    The client does not take ownership of \a store.
+
+    Messages published with a QoS level of 1 or 2 are stored in \a store
+    before they are sent, and removed once the server acknowledged them.
+    Setting a store restores the messages which have not been acknowledged
+    when the store was used before, for instance before a restart of the
+    application. These messages are resent if the server resumes the session
+    when connecting with \l cleanSession set to \c false. Otherwise, they are
+    discarded.
+
+    The session store can only be changed while the client is disconnected.
+
+    \sa sessionStore(), QMqttFileSessionStore
+*/
+void QMqttClient::setSessionStore(QMqttSessionStore *store)
+{
+    Q_D(QMqttClient);
+    if (d->m_state != Disconnected) {
+        qCDebug(lcMqttClient) << "Changing the session store while connected is not possible.";
+        return;
+    }
+    d->m_connection->setSessionStore(store);
+}
+
+/*!
+    \since 6.9
+
+    Returns the session store used to persist outbound messages.
+
+    \sa setSessionStore()
+*/
+QMqttSessionStore *QMqttClient::sessionStore() const
+{
+    Q_D(const QMqttClient);
+    return d->m_connection->sessionStore();
+}
+
+void QMqttClient::setPublishQueueLimit(qsizetype limit)
+{
+    Q_D(QMqttClient);
+    limit = qMax<qsizetype>(limit, 0);
+    if (d->m_publishQueueLimit == limit)
+        return;
+
+    d->m_publishQueueLimit = limit;
+    emit publishQueueLimitChanged(limit);
+}
+
+qsizetype QMqttClient::publishQueueLimit() const
+{
+    Q_D(const QMqttClient);
+    return d->m_publishQueueLimit;
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of messages queued locally, because the server does
+    not accept further messages before previous messages are acknowledged.
+
+    \sa publishQueueLimit, publishBackpressureChanged()
+*/
+qsizetype QMqttClient::publishQueueSize() const
+{
+    Q_D(const QMqttClient);
+    return d->m_connection->publishQueueSize();
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Returns a snapshot of the counters of the client, like the packets and
+    bytes sent and received per packet type, pending acknowledgments and
+    reconnections.
+
+    The counters are updated with relaxed atomic operations in the thread of
+    the client, which costs about as much as incrementing a plain integer.
+    This function only reads them and can be called from any thread, for
+    instance to export the counters periodically to a monitoring system.
+
+    \note The client must not be deleted while another thread calls this
+    function.
+
+    \sa latencyHistogram(), QMqttSubscription::receivedMessageCount()
+*/
+QMqttStatistics QMqttClient::statistics() const
+{
+    Q_D(const QMqttClient);
+    return d->m_connection->statistics();
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Returns a histogram of the round trip times of the packets acknowledged
+    by \a acknowledgment, in microseconds:
+
+    \table
+    \header
+        \li Acknowledgment
+        \li Round trip
+    \row
+        \li QMqttStatistics::PublishAcknowledge
+        \li PUBLISH with QoS 1 until PUBACK
+    \row
+        \li QMqttStatistics::PublishReceived
+        \li PUBLISH with QoS 2 until PUBREC
+    \row
+        \li QMqttStatistics::PublishComplete
+        \li PUBREL until PUBCOMP
+    \row
+        \li QMqttStatistics::PingResponse
+        \li PINGREQ until PINGRESP
+    \endtable
+
+    A round trip starts when the packet is written to the transport. Time a
+    message spends in the publish queue is not included, and a
+    retransmitted message is timed from its retransmission. For other
+    values of \a acknowledgment an empty histogram is returned.
+
+    The histograms have a fixed size and are updated like the counters of
+    statistics(), hence they can be read from any thread.
+
+    \note The client must not be deleted while another thread calls this
+    function.
+
+    \sa statistics(), requestPing()
+*/
+QMqttLatencyHistogram QMqttClient::latencyHistogram(QMqttStatistics::PacketType acknowledgment) const
+{
+    Q_D(const QMqttClient);
+    return d->m_connection->latencyHistogram(acknowledgment);
 }
 
 QString QMqttClient::hostname() const
@@ -530,7 +1105,7 @@ void QMqttClient::connectToHost()
 void QMqttClient::connectToHostEncrypted(const QSslConfiguration &conf)
 {
     Q_D(QMqttClient);
-    d->m_connection.m_sslConfiguration = conf;
+    d->m_connection->m_sslConfiguration = conf;
     connectToHost(true, QString());
 }
 #endif
@@ -549,7 +1124,7 @@ void QMqttClient::connectToHost(bool encrypted, const QString &sslPeerName)
         return;
     }
 
-    if (!d->m_connection.ensureTransport(encrypted)) {
+    if (!d->m_connection->ensureTransport(encrypted)) {
         qCDebug(lcMqttClient) << "Could not ensure connection.";
         d->setStateAndError(Disconnected, TransportInvalid);
         return;
@@ -558,9 +1133,9 @@ void QMqttClient::connectToHost(bool encrypted, const QString &sslPeerName)
     d->setStateAndError(Connecting);
 
     if (d->m_cleanSession)
-        d->m_connection.cleanSubscriptions();
+        d->m_connection->cleanSubscriptions();
 
-    if (!d->m_connection.ensureTransportOpen(sslPeerName)) {
+    if (!d->m_connection->ensureTransportOpen(sslPeerName)) {
         qCDebug(lcMqttClient) << "Could not ensure that connection is open.";
         d->setStateAndError(Disconnected, TransportInvalid);
         return;
@@ -578,16 +1153,16 @@ void QMqttClient::disconnectFromHost()
 {
     Q_D(QMqttClient);
 
-    switch (d->m_connection.internalState()) {
+    switch (d->m_connection->internalState()) {
     case QMqttConnection::BrokerConnected:
     case QMqttConnection::ClientDestruction:
-        d->m_connection.sendControlDisconnect();
+        d->m_connection->sendControlDisconnect();
         break;
     case QMqttConnection::BrokerDisconnected:
         break;
     case QMqttConnection::BrokerConnecting:
     case QMqttConnection::BrokerWaitForConnectAck:
-        d->m_connection.m_transport->close();
+        d->m_connection->m_transport->close();
         break;
     }
 }
@@ -759,7 +1334,39 @@ void QMqttClient::authenticate(const QMqttAuthenticationProperties &prop)
         qCDebug(lcMqttClient) << "Cannot send authentication request while disconnected.";
         return;
     }
-    d->m_connection.sendControlAuthenticate(prop);
+    d->m_connection->sendControlAuthenticate(prop);
+}
+
+void QMqttClient::setPayloadSharingEnabled(bool enabled)
+{
+    Q_D(QMqttClient);
+    if (d->m_payloadSharing == enabled)
+        return;
+
+    d->m_payloadSharing = enabled;
+    emit payloadSharingEnabledChanged(enabled);
+}
+
+bool QMqttClient::isPayloadSharingEnabled() const
+{
+    Q_D(const QMqttClient);
+    return d->m_payloadSharing;
+}
+
+void QMqttClient::setMessageReceivedSignalEnabled(bool enabled)
+{
+    Q_D(QMqttClient);
+    if (d->m_messageReceivedSignal == enabled)
+        return;
+
+    d->m_messageReceivedSignal = enabled;
+    emit messageReceivedSignalEnabledChanged(enabled);
+}
+
+bool QMqttClient::isMessageReceivedSignalEnabled() const
+{
+    Q_D(const QMqttClient);
+    return d->m_messageReceivedSignal;
 }
 
 QMqttClient::ClientError QMqttClient::error() const
@@ -8,10 +8,14 @@
 #include <QtMqtt/qmqttauthenticationproperties.h>
 #include <QtMqtt/qmqttconnectionproperties.h>
 #include <QtMqtt/qmqttpublishproperties.h>
+#include <QtMqtt/qmqttstatistics.h>
 #include <QtMqtt/qmqttsubscription.h>
 #include <QtMqtt/qmqttsubscriptionproperties.h>
 #include <QtMqtt/qmqtttopicfilter.h>
 
+#if QT_CONFIG(future)
+#include <QtCore/QFuture>
+#endif
 #include <QtCore/QIODevice>
 #include <QtCore/QObject>
 #include <QtCore/QSharedPointer>
@@ -23,6 +27,7 @@
 QT_BEGIN_NAMESPACE
 
 class QMqttClientPrivate;
+class QMqttSessionStore;
 
 class Q_MQTT_EXPORT QMqttClient : public QObject
 {
@@ -83,6 +88,12 @@ private:
     Q_PROPERTY(quint8 willQoS READ willQoS WRITE setWillQoS NOTIFY willQoSChanged)
     Q_PROPERTY(bool willRetain READ willRetain WRITE setWillRetain NOTIFY willRetainChanged)
     Q_PROPERTY(bool autoKeepAlive READ autoKeepAlive WRITE setAutoKeepAlive NOTIFY autoKeepAliveChanged)
+    Q_PROPERTY(bool messageReceivedSignalEnabled READ isMessageReceivedSignalEnabled
+               WRITE setMessageReceivedSignalEnabled NOTIFY messageReceivedSignalEnabledChanged)
+    Q_PROPERTY(bool payloadSharingEnabled READ isPayloadSharingEnabled
+               WRITE setPayloadSharingEnabled NOTIFY payloadSharingEnabledChanged)
+    Q_PROPERTY(qsizetype publishQueueLimit READ publishQueueLimit WRITE setPublishQueueLimit
+               NOTIFY publishQueueLimitChanged)
 public:
     explicit QMqttClient(QObject *parent = nullptr);
     ~QMqttClient() override;
@@ -93,18 +104,56 @@ public:
     QMqttSubscription *subscribe(const QMqttTopicFilter &topic, quint8 qos = 0);
     QMqttSubscription *subscribe(const QMqttTopicFilter &topic,
                                  const QMqttSubscriptionProperties &properties, quint8 qos = 0);
+    QMqttSubscription *subscribe(const QMqttTopicFilter &topic, quint8 qos,
+                                 const QMqttSubscription::MessageHandler &handler);
     void unsubscribe(const QMqttTopicFilter &topic);
     void unsubscribe(const QMqttTopicFilter &topic, const QMqttUnsubscriptionProperties &properties);
 
+#if QT_CONFIG(future)
+    QFuture<QMqttSubscription *> subscribeAsync(const QMqttTopicFilter &topic, quint8 qos = 0);
+    QFuture<QMqttSubscription *> subscribeAsync(const QMqttTopicFilter &topic,
+                                                const QMqttSubscriptionProperties &properties,
+                                                quint8 qos = 0);
+    QFuture<QMqtt::ReasonCode> unsubscribeAsync(const QMqttTopicFilter &topic);
+    QFuture<QMqtt::ReasonCode> unsubscribeAsync(const QMqttTopicFilter &topic,
+                                                const QMqttUnsubscriptionProperties &properties);
+#endif
+
     Q_INVOKABLE qint32 publish(const QMqttTopicName &topic, const QByteArray &message = QByteArray(),
                  quint8 qos = 0, bool retain = false);
     Q_INVOKABLE qint32 publish(const QMqttTopicName &topic, const QMqttPublishProperties &properties,
                                const QByteArray &message = QByteArray(),
                                quint8 qos = 0,
                                bool retain = false);
+#if QT_CONFIG(future)
+    QFuture<QMqtt::ReasonCode> publishAsync(const QMqttTopicName &topic,
+                                            const QByteArray &message = QByteArray(),
+                                            quint8 qos = 0, bool retain = false);
+    QFuture<QMqtt::ReasonCode> publishAsync(const QMqttTopicName &topic,
+                                            const QMqttPublishProperties &properties,
+                                            const QByteArray &message = QByteArray(),
+                                            quint8 qos = 0, bool retain = false);
+    QFuture<qint32> postPublish(const QMqttTopicName &topic, const QByteArray &message = QByteArray(),
+                                quint8 qos = 0, bool retain = false);
+    QFuture<qint32> postPublish(const QMqttTopicName &topic, const QMqttPublishProperties &properties,
+                                const QByteArray &message = QByteArray(), quint8 qos = 0,
+                                bool retain = false);
+#endif
 
     bool requestPing();
 
+    void beginBatch();
+    bool endBatch();
+
+    void setSessionStore(QMqttSessionStore *store);
+    QMqttSessionStore *sessionStore() const;
+
+    qsizetype publishQueueLimit() const;
+    qsizetype publishQueueSize() const;
+
+    QMqttStatistics statistics() const;
+    QMqttLatencyHistogram latencyHistogram(QMqttStatistics::PacketType acknowledgment) const;
+
     QString hostname() const;
     quint16 port() const;
     QString clientId() const;
@@ -139,6 +188,10 @@ public:
     QMqttServerConnectionProperties serverConnectionProperties() const;
 
     void authenticate(const QMqttAuthenticationProperties &prop);
+
+    bool isPayloadSharingEnabled() const;
+
+    bool isMessageReceivedSignalEnabled() const;
 Q_SIGNALS:
     void connected();
     void disconnected();
@@ -147,6 +200,7 @@ Q_SIGNALS:
     void messageSent(qint32 id);
     void pingResponseReceived();
     void brokerSessionRestored();
+    void publishBackpressureChanged(bool backpressure);
 
     void hostnameChanged(QString hostname);
     void portChanged(quint16 port);
@@ -164,6 +218,9 @@ Q_SIGNALS:
     void willMessageChanged(QByteArray willMessage);
     void willRetainChanged(bool willRetain);
     void autoKeepAliveChanged(bool autoKeepAlive);
+    void messageReceivedSignalEnabledChanged(bool enabled);
+    void payloadSharingEnabledChanged(bool enabled);
+    void publishQueueLimitChanged(qsizetype limit);
 
     void authenticationRequested(const QMqttAuthenticationProperties &p);
     void authenticationFinished(const QMqttAuthenticationProperties &p);
@@ -184,6 +241,9 @@ public Q_SLOTS:
     void setWillMessage(const QByteArray &willMessage);
     void setWillRetain(bool willRetain);
     void setAutoKeepAlive(bool autoKeepAlive);
+    void setMessageReceivedSignalEnabled(bool enabled);
+    void setPayloadSharingEnabled(bool enabled);
+    void setPublishQueueLimit(qsizetype limit);
 
 private:
     void connectToHost(bool encrypted, const QString &sslPeerName);
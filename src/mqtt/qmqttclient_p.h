@@ -35,7 +35,7 @@ public:
     QMqttClient *m_client{nullptr};
     QString m_hostname;
     quint16 m_port{0};
-    QMqttConnection m_connection;
+    QMqttConnection *m_connection{nullptr}; // Child of the client to follow it into other threads
     QString m_clientId; // auto-generated
     quint16 m_keepAlive{60};
     QMqttClient::ProtocolVersion m_protocolVersion{QMqttClient::MQTT_3_1_1};
@@ -49,6 +49,9 @@ public:
     QString m_username;
     QString m_password;
     bool m_cleanSession{true};
+    bool m_payloadSharing{false};
+    bool m_messageReceivedSignal{true};
+    qsizetype m_publishQueueLimit{0};
     QMqttConnectionProperties m_connectionProperties;
     QMqttLastWillProperties m_lastWillProperties;
     QMqttServerConnectionProperties m_serverConnectionProperties;
@@ -7,12 +7,17 @@
 #include "qmqttmessage_p.h"
 #include "qmqttpublishproperties_p.h"
 #include "qmqttsubscription_p.h"
+#include "qmqtttopicname_p.h"
 #include "qmqttclient_p.h"
 
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QVarLengthArray>
 #include <QtNetwork/QSslSocket>
 #include <QtNetwork/QTcpSocket>
 
+#include <qtmqtt_tracepoints_p.h>
+
+#include <algorithm>
 #include <limits>
 #include <cstdint>
 
@@ -58,6 +63,7 @@ QString QMqttConnection::readBufferTyped(qint64 *dataSize)
 
 QMqttConnection::QMqttConnection(QObject *parent) : QObject(parent)
 {
+    m_clock.start();
 }
 
 QMqttConnection::~QMqttConnection()
@@ -67,6 +73,14 @@ QMqttConnection::~QMqttConnection()
 
     if (m_ownTransport && m_transport)
         delete m_transport;
+
+#if QT_CONFIG(future)
+    // Do not leave anyone waiting for messages which are never sent
+    m_postedPublishes.drain([](std::optional<PostedPublish> &&posted) {
+        posted->result.reportResult(-1);
+        posted->result.reportFinished();
+    });
+#endif
 }
 
 void QMqttConnection::timerEvent(QTimerEvent *event)
@@ -122,9 +136,9 @@ bool QMqttConnection::ensureTransport(bool createSecureIfNeeded)
     }
     auto socket =
 #ifndef QT_NO_SSL
-            createSecureIfNeeded ? new QSslSocket() :
+            createSecureIfNeeded ? new QSslSocket(this) :
 #endif
-                                   new QTcpSocket();
+                                   new QTcpSocket(this);
     m_transport = socket;
     m_ownTransport = true;
     m_transportType =
@@ -157,7 +171,7 @@ bool QMqttConnection::ensureTransportOpen(const QString &sslPeerName)
 
         if (!m_transport->open(QIODevice::ReadWrite)) {
             qCDebug(lcMqttConnection) << "Could not open Transport IO device.";
-            m_internalState = BrokerDisconnected;
+            setInternalState(BrokerDisconnected);
             return false;
         }
         return sendControlConnect();
@@ -169,7 +183,7 @@ bool QMqttConnection::ensureTransportOpen(const QString &sslPeerName)
         if (socket->state() == QAbstractSocket::ConnectedState)
             return sendControlConnect();
 
-        m_internalState = BrokerConnecting;
+        setInternalState(BrokerConnecting);
         socket->connectToHost(m_clientPrivate->m_hostname, m_clientPrivate->m_port);
     }
 #ifndef QT_NO_SSL
@@ -179,7 +193,7 @@ bool QMqttConnection::ensureTransportOpen(const QString &sslPeerName)
         if (socket->state() == QAbstractSocket::ConnectedState)
             return sendControlConnect();
 
-        m_internalState = BrokerConnecting;
+        setInternalState(BrokerConnecting);
         if (!m_sslConfiguration.isNull())
             socket->setSslConfiguration(m_sslConfiguration);
         socket->connectToHostEncrypted(m_clientPrivate->m_hostname, m_clientPrivate->m_port, sslPeerName);
@@ -272,7 +286,7 @@ bool QMqttConnection::sendControlConnect()
     if (m_clientPrivate->m_password.size())
         packet.append(m_clientPrivate->m_password.toUtf8());
 
-    m_internalState = BrokerWaitForConnectAck;
+    setInternalState(BrokerWaitForConnectAck);
     m_missingData = 0;
 
     if (!writePacketToTransport(packet)) {
@@ -318,13 +332,31 @@ qint32 QMqttConnection::sendControlPublish(const QMqttTopicName &topic,
                                            const QByteArray &message,
                                            quint8 qos,
                                            bool retain,
-                                           const QMqttPublishProperties &properties)
+                                           const QMqttPublishProperties &properties,
+                                           QMqttCompletion *completion)
 {
     qCDebug(lcMqttConnection) << Q_FUNC_INFO << topic << " Size:" << message.size() << " bytes."
                               << "QoS:" << qos << " Retain:" << retain;
 
     if (!topic.isValid())
         return -1;
+    const QByteArray &topicUtf8 = QMqttTopicNamePrivate::get(topic)->utf8;
+
+    // MQTT-4.9 The number of unacknowledged QoS 1 and QoS 2 messages must not
+    // exceed the Receive Maximum of the server. Once messages are queued, all
+    // further messages are queued as well to keep their order.
+    const bool enqueue = !m_publishQueue.isEmpty()
+            || (qos > 0 && m_inflightPublishes >= m_clientPrivate->m_serverConnectionProperties.maximumReceive());
+    if (enqueue && m_clientPrivate->m_publishQueueLimit > 0
+            && m_publishQueue.size() >= m_clientPrivate->m_publishQueueLimit) {
+        qCDebug(lcMqttConnection) << "Publish queue is full, dropping message.";
+        return -1;
+    }
+
+    if (qos > 0 && m_inflight.isExhausted()) {
+        qCDebug(lcMqttConnection) << "Could not generate unique packet identifier.";
+        return -1;
+    }
 
     quint8 header = QMqttControlPacket::PUBLISH;
     if (qos == 1)
@@ -351,55 +383,309 @@ qint32 QMqttConnection::sendControlPublish(const QMqttTopicName &topic,
                 qCDebug(lcMqttConnection) << "TopicAlias publish: overflow.";
                 return -1;
             }
-            if (m_publishAliases.at(topicAlias - 1) != topic) {
+            if (m_publishAliases.set(topicAlias, topic)) {
                 qCDebug(lcMqttConnection) << "TopicAlias publish: Assign:" << topicAlias << ":" << topic;
-                m_publishAliases[topicAlias - 1] = topic;
-                packet->append(topic.name().toUtf8());
+                packet->append(topicUtf8);
+                m_statistics.topicAliasMisses.add();
             } else {
                 qCDebug(lcMqttConnectionVerbose) << "TopicAlias publish: Reuse:" << topicAlias;
                 packet->append(quint16(0));
+                m_statistics.topicAliasHits.add();
             }
-        } else if (m_publishAliases.size() > 0) { // Automatic module alias assignment
-            int autoAlias = m_publishAliases.indexOf(topic);
-            if (autoAlias != -1) {
+        } else if (m_publishAliases.maximum() > 0) { // Automatic module alias assignment
+            quint16 autoAlias = m_publishAliases.find(topic);
+            if (autoAlias != 0) {
                 qCDebug(lcMqttConnectionVerbose) << "TopicAlias publish: Use auto alias:" << autoAlias;
                 packet->append(quint16(0));
-                publishProperties.setTopicAlias(quint16(autoAlias + 1));
+                m_statistics.topicAliasHits.add();
             } else {
-                autoAlias = m_publishAliases.indexOf(QMqttTopicName());
-                if (autoAlias != -1) {
-                    qCDebug(lcMqttConnectionVerbose) << "TopicAlias publish: auto alias assignment:" << autoAlias;
-                    m_publishAliases[autoAlias] = topic;
-                    publishProperties.setTopicAlias(quint16(autoAlias) + 1);
-                } else
-                    qCDebug(lcMqttConnectionVerbose) << "TopicAlias publish: alias storage full, using full topic";
-                packet->append(topic.name().toUtf8());
+                // Once all aliases are in use, the least recently used one is reassigned.
+                autoAlias = m_publishAliases.assign(topic);
+                qCDebug(lcMqttConnectionVerbose) << "TopicAlias publish: auto alias assignment:" << autoAlias;
+                packet->append(topicUtf8);
+                m_statistics.topicAliasMisses.add();
             }
+            publishProperties.setTopicAlias(autoAlias);
         } else {
-            packet->append(topic.name().toUtf8());
+            packet->append(topicUtf8);
         }
     } else { // ! MQTT_5_0
-        packet->append(topic.name().toUtf8());
+        packet->append(topicUtf8);
     }
     quint16 identifier = 0;
     if (qos > 0) {
-        identifier = unusedPacketIdentifier();
+        identifier = m_inflight.allocate(QMqttInflightTable::PublishAck);
         packet->append(identifier);
-        m_pendingMessages.insert(identifier, packet);
     }
 
     if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0)
         packet->appendRaw(writePublishProperties(publishProperties));
 
-    packet->appendRaw(message);
+    packet->setApplicationMessage(message);
+
+    if (qos > 0) {
+        QMqttInflightTable::Entry *pending = m_inflight.find(identifier, QMqttInflightTable::PublishAck);
+        pending->packet = packet;
+        pending->sequence = ++m_publishSequence;
+        if (completion)
+            pending->completion = std::move(*completion);
+        // Topic aliases are only valid for the current connection. Keep a
+        // variable header stating the topic for retransmission instead.
+        if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0
+                && publishProperties.topicAlias() > 0) {
+            QMqttControlPacket resend;
+            resend.append(topicUtf8);
+            resend.append(identifier);
+            resend.appendRaw(writePublishProperties(publishProperties, false));
+            pending->resendHeader = resend.payload();
+        }
+    }
+
+    if (enqueue) {
+        qCDebug(lcMqttConnectionVerbose) << "Inflight window exhausted, queueing message:" << identifier;
+        m_publishQueue.enqueue({packet, identifier});
+        Q_TRACE(QMqttConnection_publishQueued, identifier, qos, m_publishQueue.size());
+        updatePublishBackpressure();
+        return identifier;
+    }
+
+    if (qos > 0) {
+        QMqttInflightTable::Entry &pending = *m_inflight.find(identifier, QMqttInflightTable::PublishAck);
+        persistPendingMessage(identifier, pending);
+        pending.sentTime = elapsed();
+    }
 
     const bool written = writePacketToTransport(*packet.data());
 
-    if (!written && qos > 0)
-        m_pendingMessages.remove(identifier);
+    if (!written && qos > 0) {
+        m_inflight.remove(identifier, QMqttInflightTable::PublishAck);
+        if (m_sessionStore)
+            m_sessionStore->removeMessage(identifier);
+    } else if (qos > 0) {
+        ++m_inflightPublishes;
+        // Rolled back by flushBatch() if the batch cannot be written
+        if (!m_batchBuffer.isEmpty())
+            m_batchedPublishes.append(identifier);
+    }
     return written ? identifier : -1;
 }
 
+void QMqttConnection::resendPendingMessages()
+{
+    // MQTT-4.4.0-1 Resend unacknowledged PUBLISH and PUBREL packets in the
+    // order in which the original PUBLISH packets were sent.
+    struct Retransmission {
+        quint64 sequence;
+        quint16 identifier;
+        bool release;
+    };
+    QList<Retransmission> retransmissions;
+    retransmissions.reserve(m_inflight.count(QMqttInflightTable::PublishAck)
+                            + m_inflight.count(QMqttInflightTable::PublishComplete));
+    m_inflight.forEach(QMqttInflightTable::PublishAck,
+                       [&retransmissions](quint16 id, const QMqttInflightTable::Entry &entry) {
+        retransmissions.append({entry.sequence, id, false});
+    });
+    m_inflight.forEach(QMqttInflightTable::PublishComplete,
+                       [&retransmissions](quint16 id, const QMqttInflightTable::Entry &entry) {
+        retransmissions.append({entry.sequence, id, true});
+    });
+    if (retransmissions.isEmpty())
+        return;
+
+    std::sort(retransmissions.begin(), retransmissions.end(),
+              [](const Retransmission &a, const Retransmission &b) { return a.sequence < b.sequence; });
+
+    qCDebug(lcMqttConnection) << "Resending" << retransmissions.size() << "unacknowledged messages.";
+
+    // MQTT-3.3.4-9 The Receive Maximum of the new connection applies to
+    // retransmissions as well. Messages exceeding it are queued and sent by
+    // sendQueuedPublishes() as acknowledgments arrive. PUBREL packets are not
+    // limited, but their messages count as unacknowledged until PUBCOMP.
+    const quint16 receiveMaximum = m_clientPrivate->m_serverConnectionProperties.maximumReceive();
+    beginBatch();
+    for (const Retransmission &retransmission : std::as_const(retransmissions)) {
+        if (!retransmission.release
+                && (!m_publishQueue.isEmpty() || m_inflightPublishes >= receiveMaximum)) {
+            QMqttInflightTable::Entry &pending =
+                    *m_inflight.find(retransmission.identifier, QMqttInflightTable::PublishAck);
+            prepareRetransmission(&pending);
+            m_publishQueue.enqueue({pending.packet, retransmission.identifier, true});
+            Q_TRACE(QMqttConnection_publishQueued, retransmission.identifier,
+                    (pending.packet->header() & 0x06) >> 1, m_publishQueue.size());
+            continue;
+        }
+
+        ++m_inflightPublishes;
+        if (retransmission.release) {
+            m_inflight.find(retransmission.identifier, QMqttInflightTable::PublishComplete)->sentTime =
+                    elapsed();
+            sendControlPublishRelease(retransmission.identifier);
+            continue;
+        }
+
+        QMqttInflightTable::Entry &pending =
+                *m_inflight.find(retransmission.identifier, QMqttInflightTable::PublishAck);
+        prepareRetransmission(&pending);
+        pending.sentTime = elapsed();
+        if (!writePacketToTransport(*pending.packet.data()))
+            qCDebug(lcMqttConnection) << "Could not resend message:" << retransmission.identifier;
+    }
+    endBatch();
+    if (!m_publishQueue.isEmpty()) {
+        qCDebug(lcMqttConnection) << "Receive Maximum reached, queueing" << m_publishQueue.size()
+                                  << "retransmissions.";
+        updatePublishBackpressure();
+    }
+}
+
+void QMqttConnection::prepareRetransmission(QMqttInflightTable::Entry *pending)
+{
+    if (!pending->resendHeader.isEmpty()) {
+        // Replace the aliased packet, the application message is not copied.
+        QSharedPointer<QMqttControlPacket> packet(new QMqttControlPacket(pending->packet->header()));
+        packet->appendRaw(pending->resendHeader);
+        packet->setApplicationMessage(pending->packet->applicationMessage());
+        pending->packet = packet;
+        pending->resendHeader.clear();
+    }
+    // MQTT-3.3.1-1 DUP flag must be set on retransmission
+    pending->packet->setDuplicateFlag();
+}
+
+void QMqttConnection::discardPendingMessages()
+{
+    const int unacknowledged = m_inflight.count(QMqttInflightTable::PublishAck);
+    const int unreleased = m_inflight.count(QMqttInflightTable::PublishComplete);
+    if (unacknowledged == 0 && unreleased == 0)
+        return;
+    qCDebug(lcMqttConnection) << "Session not present, discarding" << unacknowledged
+                              << "unacknowledged and" << unreleased << "unreleased messages.";
+    m_inflight.removeAll(QMqttInflightTable::PublishAck);
+    m_inflight.removeAll(QMqttInflightTable::PublishComplete);
+    if (m_sessionStore)
+        m_sessionStore->clear();
+}
+
+void QMqttConnection::persistPendingMessage(quint16 id, const QMqttInflightTable::Entry &pending)
+{
+    if (!m_sessionStore || !pending.packet)
+        return;
+
+    if (pending.resendHeader.isEmpty()) {
+        m_sessionStore->storeMessage(id, pending.packet->serialize());
+        return;
+    }
+    // Topic aliases are not valid for the next connection, store the topic instead.
+    QMqttControlPacket packet(pending.packet->header());
+    packet.appendRaw(pending.resendHeader);
+    packet.setApplicationMessage(pending.packet->applicationMessage());
+    m_sessionStore->storeMessage(id, packet.serialize());
+}
+
+void QMqttConnection::setSessionStore(QMqttSessionStore *store)
+{
+    m_sessionStore = store;
+    if (!m_sessionStore)
+        return;
+
+    // Restore the messages which have not been acknowledged before.
+    const QList<QMqttSessionStore::Message> messages = m_sessionStore->load();
+    for (const QMqttSessionStore::Message &message : messages) {
+        const quint16 id = message.packetIdentifier;
+
+        // Skip the fixed header, the remaining packet is the variable header
+        // followed by the application message.
+        const QByteArray &data = message.packet;
+        qsizetype offset = 1;
+        while (offset < data.size() && offset < QMqttControlPacket::MaximumFixedHeaderSize - 1
+               && (quint8(data.at(offset)) & 0x80)) {
+            ++offset;
+        }
+        ++offset;
+        if (data.isEmpty() || (quint8(data.at(0)) & 0xF0) != QMqttControlPacket::PUBLISH
+                || offset > data.size()) {
+            qCDebug(lcMqttConnection) << "Ignoring invalid message from session store:" << id;
+            continue;
+        }
+
+        QMqttInflightTable::Entry *pending =
+                m_inflight.insert(id, message.released ? QMqttInflightTable::PublishComplete
+                                                       : QMqttInflightTable::PublishAck);
+        if (!pending)
+            continue;
+        pending->packet.reset(new QMqttControlPacket(quint8(data.at(0))));
+        pending->packet->appendRaw(data.sliced(offset));
+        pending->sequence = ++m_publishSequence;
+    }
+    qCDebug(lcMqttConnection) << "Restored" << m_inflight.count(QMqttInflightTable::PublishAck)
+                                 + m_inflight.count(QMqttInflightTable::PublishComplete)
+                              << "messages from session store.";
+}
+
+void QMqttConnection::sendQueuedPublishes()
+{
+    const quint16 receiveMaximum = m_clientPrivate->m_serverConnectionProperties.maximumReceive();
+    while (!m_publishQueue.isEmpty()) {
+        const bool acknowledged = m_publishQueue.head().identifier != 0;
+        if (acknowledged && m_inflightPublishes >= receiveMaximum)
+            break;
+
+        const QueuedPublish queued = m_publishQueue.dequeue();
+        Q_TRACE(QMqttConnection_publishDequeued, queued.identifier, (queued.packet->header() & 0x06) >> 1);
+        if (acknowledged) {
+            // Round trips are measured from the time the message leaves the queue
+            QMqttInflightTable::Entry &pending =
+                    *m_inflight.find(queued.identifier, QMqttInflightTable::PublishAck);
+            if (!queued.retransmission)
+                persistPendingMessage(queued.identifier, pending);
+            pending.sentTime = elapsed();
+        }
+        if (!writePacketToTransport(*queued.packet.data())) {
+            qCDebug(lcMqttConnection) << "Could not write queued message:" << queued.identifier;
+            if (acknowledged && !queued.retransmission) {
+                m_inflight.remove(queued.identifier, QMqttInflightTable::PublishAck);
+                if (m_sessionStore)
+                    m_sessionStore->removeMessage(queued.identifier);
+            }
+            continue;
+        }
+        if (acknowledged) {
+            ++m_inflightPublishes;
+            if (!queued.retransmission && !m_batchBuffer.isEmpty())
+                m_batchedPublishes.append(queued.identifier);
+        }
+    }
+    updatePublishBackpressure();
+}
+
+void QMqttConnection::discardQueuedPublishes()
+{
+    // Queued messages have not been sent, hence they are not part of the
+    // session. Retransmissions stay pending and are resent on the next
+    // connection.
+    for (const QueuedPublish &queued : std::as_const(m_publishQueue)) {
+        if (queued.identifier != 0 && !queued.retransmission)
+            m_inflight.remove(queued.identifier, QMqttInflightTable::PublishAck);
+    }
+    if (!m_publishQueue.isEmpty())
+        qCDebug(lcMqttConnection) << "Discarding" << m_publishQueue.size() << "queued messages.";
+    m_publishQueue.clear();
+    m_inflightPublishes = 0;
+    updatePublishBackpressure();
+}
+
+void QMqttConnection::updatePublishBackpressure()
+{
+    m_statistics.queuedPublishes.set(m_publishQueue.size());
+    const bool backpressure = !m_publishQueue.isEmpty();
+    if (backpressure == m_publishBackpressure)
+        return;
+    m_publishBackpressure = backpressure;
+    if (m_internalState != ClientDestruction)
+        emit m_clientPrivate->m_client->publishBackpressureChanged(backpressure);
+}
+
 bool QMqttConnection::sendControlPublishAcknowledge(quint16 id)
 {
     qCDebug(lcMqttConnection) << Q_FUNC_INFO << id;
@@ -437,7 +723,8 @@ bool QMqttConnection::sendControlPublishComp(quint16 id)
 
 QMqttSubscription *QMqttConnection::sendControlSubscribe(const QMqttTopicFilter &topic,
                                                          quint8 qos,
-                                                         const QMqttSubscriptionProperties &properties)
+                                                         const QMqttSubscriptionProperties &properties,
+                                                         QMqttCompletion *completion)
 {
     qCDebug(lcMqttConnection) << Q_FUNC_INFO << " Topic:" << topic << " qos:" << qos;
 
@@ -476,14 +763,30 @@ QMqttSubscription *QMqttConnection::sendControlSubscribe(const QMqttTopicFilter
     QMqttControlPacket packet(header);
 
     // Add Packet Identifier
-    const quint16 identifier = unusedPacketIdentifier();
+    const quint16 identifier = m_inflight.allocate(QMqttInflightTable::SubscribeAck);
+    if (identifier == 0) {
+        qCDebug(lcMqttConnection) << "Could not generate unique packet identifier.";
+        return nullptr;
+    }
 
     packet.append(identifier);
 
-    if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0)
-        packet.appendRaw(writeSubscriptionProperties(properties));
+    // Assign a subscription identifier unless the user specified one, so that
+    // messages can be dispatched without matching their topic.
+    quint32 assignedIdentifier = 0;
+    if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0) {
+        if (properties.subscriptionIdentifier() == 0
+                && m_clientPrivate->m_serverConnectionProperties.subscriptionIdentifierSupported()) {
+            assignedIdentifier = allocateSubscriptionIdentifier();
+            QMqttSubscriptionProperties assignedProperties(properties);
+            assignedProperties.setSubscriptionIdentifier(assignedIdentifier);
+            packet.appendRaw(writeSubscriptionProperties(assignedProperties));
+        } else {
+            packet.appendRaw(writeSubscriptionProperties(properties));
+        }
+    }
 
-    packet.append(topic.filter().toUtf8());
+    packet.append(topic.toUtf8());
     char options = char(qos);
     if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0 && properties.noLocal())
         options |= 1 << 2;
@@ -500,18 +803,33 @@ QMqttSubscription *QMqttConnection::sendControlSubscribe(const QMqttTopicFilter
         result->setTopic(topic.filter().section(QLatin1Char('/'), 2));
     }
 
+    if (assignedIdentifier != 0) {
+        result->d_func()->m_subscriptionIdentifier = assignedIdentifier;
+        result->d_func()->m_assignedSubscriptionIdentifier = true;
+    } else if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0) {
+        result->d_func()->m_subscriptionIdentifier = properties.subscriptionIdentifier();
+    }
+
     if (!writePacketToTransport(packet)) {
+        m_inflight.remove(identifier, QMqttInflightTable::SubscribeAck);
+        if (assignedIdentifier != 0)
+            releaseSubscriptionIdentifier(assignedIdentifier);
         delete result;
         return nullptr;
     }
 
     // SUBACK must contain identifier MQTT-3.8.4-2
-    m_pendingSubscriptionAck.insert(identifier, result);
-    m_activeSubscriptions.insert(result->topic(), result);
+    QMqttInflightTable::Entry *pending = m_inflight.find(identifier, QMqttInflightTable::SubscribeAck);
+    pending->subscription = result;
+    if (completion)
+        pending->completion = std::move(*completion);
+    insertSubscription(result);
+    Q_TRACE(QMqttConnection_subscribe, result, identifier, qos);
     return result;
 }
 
-bool QMqttConnection::sendControlUnsubscribe(const QMqttTopicFilter &topic, const QMqttUnsubscriptionProperties &properties)
+bool QMqttConnection::sendControlUnsubscribe(const QMqttTopicFilter &topic, const QMqttUnsubscriptionProperties &properties,
+                                             QMqttCompletion *completion)
 {
     qCDebug(lcMqttConnection) << Q_FUNC_INFO << " Topic:" << topic;
 
@@ -523,7 +841,7 @@ bool QMqttConnection::sendControlUnsubscribe(const QMqttTopicFilter &topic, cons
         return false;
 
     if (m_internalState != QMqttConnection::BrokerConnected) {
-        m_activeSubscriptions.remove(topic);
+        removeSubscription(topic);
         return true;
     }
 
@@ -533,7 +851,11 @@ bool QMqttConnection::sendControlUnsubscribe(const QMqttTopicFilter &topic, cons
     QMqttControlPacket packet(header);
 
     // Add Packet Identifier
-    const quint16 identifier = unusedPacketIdentifier();
+    const quint16 identifier = m_inflight.allocate(QMqttInflightTable::UnsubscribeAck);
+    if (identifier == 0) {
+        qCDebug(lcMqttConnection) << "Could not generate unique packet identifier.";
+        return false;
+    }
 
     packet.append(identifier);
 
@@ -541,16 +863,22 @@ bool QMqttConnection::sendControlUnsubscribe(const QMqttTopicFilter &topic, cons
         packet.appendRaw(writeUnsubscriptionProperties(properties));
     }
 
-    packet.append(topic.filter().toUtf8());
+    packet.append(topic.toUtf8());
     auto sub = m_activeSubscriptions[topic];
     sub->setState(QMqttSubscription::UnsubscriptionPending);
 
-    if (!writePacketToTransport(packet))
+    if (!writePacketToTransport(packet)) {
+        m_inflight.remove(identifier, QMqttInflightTable::UnsubscribeAck);
         return false;
+    }
 
     // Do not remove from m_activeSubscriptions as there might be QoS1/2 messages to still
     // be sent before UNSUBSCRIBE is acknowledged.
-    m_pendingUnsubscriptions.insert(identifier, sub);
+    QMqttInflightTable::Entry *pending = m_inflight.find(identifier, QMqttInflightTable::UnsubscribeAck);
+    pending->subscription = sub;
+    if (completion)
+        pending->completion = std::move(*completion);
+    Q_TRACE(QMqttConnection_unsubscribe, sub, identifier);
 
     return true;
 }
@@ -581,6 +909,9 @@ bool QMqttConnection::sendControlPingRequest(bool isAuto)
         qCDebug(lcMqttConnection) << "Failed to write PINGREQ to transport.";
         return false;
     }
+    // Responses arrive in order, only the oldest outstanding request is timed
+    if (m_pingTimeout == 0)
+        m_pingSentTime = elapsed();
     m_pingTimeout++;
     return true;
 }
@@ -591,19 +922,22 @@ bool QMqttConnection::sendControlDisconnect()
 
     m_pingTimer.stop();
     m_pingTimeout = 0;
+    m_pingSentTime = -1;
 
-    m_activeSubscriptions.clear();
+    clearSubscriptions();
 
     m_receiveAliases.clear();
     m_publishAliases.clear();
 
+    discardQueuedPublishes();
+
     const QMqttControlPacket packet(QMqttControlPacket::DISCONNECT);
     if (!writePacketToTransport(packet)) {
         qCDebug(lcMqttConnection) << "Failed to write DISCONNECT to transport.";
         return false;
     }
     if (m_internalState != ClientDestruction)
-        m_internalState = BrokerDisconnected;
+        setInternalState(BrokerDisconnected);
 
     if (m_transport->waitForBytesWritten(30000)) {
         // MQTT-3.14.4-1 must disconnect
@@ -613,49 +947,209 @@ bool QMqttConnection::sendControlDisconnect()
     return false;
 }
 
-void QMqttConnection::setClientPrivate(QMqttClientPrivate *clientPrivate)
+void QMqttConnection::beginBatch()
 {
-    m_clientPrivate = clientPrivate;
+    ++m_batchNesting;
 }
 
-quint16 QMqttConnection::unusedPacketIdentifier() const
+bool QMqttConnection::endBatch()
 {
-    // MQTT-2.3.1-1 Control Packets MUST contain a non-zero 16-bit Packet Identifier
-    static quint16 packetIdentifierCounter = 1;
-    const std::uint16_t u16max = std::numeric_limits<std::uint16_t>::max();
+    if (m_batchNesting == 0) {
+        qCDebug(lcMqttConnection) << "Ending a batch which has not been started.";
+        return false;
+    }
+    if (--m_batchNesting > 0)
+        return true;
+    return flushBatch();
+}
 
-    // MQTT-2.3.1-2 ...it MUST assign it a currently unused Packet Identifier
-    const quint16 lastIdentifier = packetIdentifierCounter;
-    do {
-        if (packetIdentifierCounter == u16max)
-            packetIdentifierCounter = 1;
-        else
-            packetIdentifierCounter++;
+#if QT_CONFIG(future)
+QFuture<qint32> QMqttConnection::postPublish(const QMqttTopicName &topic, const QByteArray &message,
+                                             quint8 qos, bool retain,
+                                             const QMqttPublishProperties &properties)
+{
+    // Called from any thread. Only the queue and the atomic flag are touched
+    // here, everything else is owned by the thread of the connection.
+    QFutureInterface<qint32> result(QFutureInterfaceBase::Started);
+    QFuture<qint32> future = result.future();
+    m_postedPublishes.push(PostedPublish{topic, message, properties, std::move(result), qos, retain});
+
+    // One event for all messages posted until the queue is drained. The
+    // exchange is sequentially consistent and pairs with the one in
+    // sendPostedPublishes(), so either the message is drained or a call is
+    // scheduled.
+    if (m_postedPublishesScheduled.fetchAndStoreOrdered(1) == 0)
+        QMetaObject::invokeMethod(this, &QMqttConnection::sendPostedPublishes, Qt::QueuedConnection);
+    return future;
+}
 
-        if (lastIdentifier == packetIdentifierCounter) {
-            qCDebug(lcMqttConnection) << "Could not generate unique packet identifier.";
-            break;
-        }
-    } while (m_pendingSubscriptionAck.contains(packetIdentifierCounter)
-             || m_pendingUnsubscriptions.contains(packetIdentifierCounter)
-             || m_pendingMessages.contains(packetIdentifierCounter)
-             || m_pendingReleaseMessages.contains(packetIdentifierCounter));
-    return packetIdentifierCounter;
+void QMqttConnection::sendPostedPublishes()
+{
+    // Messages posted from now on schedule another call
+    m_postedPublishesScheduled.fetchAndStoreOrdered(0);
+
+    QMqttClient *client = m_clientPrivate->m_client;
+    int count = 0;
+    beginBatch();
+    m_postedPublishes.drain([client, &count](std::optional<PostedPublish> &&posted) {
+        const qint32 id = client->publish(posted->topic, posted->properties, posted->message,
+                                          posted->qos, posted->retain);
+        posted->result.reportResult(id);
+        posted->result.reportFinished();
+        ++count;
+    });
+    endBatch();
+    qCDebug(lcMqttConnectionVerbose) << "Sent" << count << "posted messages.";
+
+    // Do not leave messages behind without a scheduled call
+    if (!m_postedPublishes.isEmpty() && m_postedPublishesScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, &QMqttConnection::sendPostedPublishes, Qt::QueuedConnection);
 }
+#endif // QT_CONFIG(future)
 
-void QMqttConnection::cleanSubscriptions()
+QMqttStatistics QMqttConnection::statistics() const
 {
-    for (auto item : m_pendingSubscriptionAck)
-        item->setState(QMqttSubscription::Unsubscribed);
-    m_pendingSubscriptionAck.clear();
+    // Called from any thread, only atomic counters are read
+    return m_statistics.snapshot(m_inflight);
+}
 
-    for (auto item : m_pendingUnsubscriptions)
-        item->setState(QMqttSubscription::Unsubscribed);
-    m_pendingUnsubscriptions.clear();
+QMqttLatencyHistogram QMqttConnection::latencyHistogram(QMqttStatistics::PacketType acknowledgment) const
+{
+    // Called from any thread, see statistics()
+    switch (acknowledgment) {
+    case QMqttStatistics::PublishAcknowledge:
+        return m_statistics.publishAcknowledgeLatency.snapshot();
+    case QMqttStatistics::PublishReceived:
+        return m_statistics.publishReceivedLatency.snapshot();
+    case QMqttStatistics::PublishComplete:
+        return m_statistics.publishCompleteLatency.snapshot();
+    case QMqttStatistics::PingResponse:
+        return m_statistics.pingResponseLatency.snapshot();
+    default:
+        break;
+    }
+    return QMqttLatencyHistogram();
+}
+
+void QMqttConnection::recordLatency(QMqttLatencyRecorder &recorder, qint64 sentTime)
+{
+    // Messages restored from a session store have not been sent yet
+    if (sentTime >= 0)
+        recorder.record((elapsed() - sentTime) / 1000);
+}
+
+void QMqttConnection::setInternalState(InternalConnectionState state)
+{
+    Q_TRACE(QMqttConnection_stateChanged, m_internalState, state);
+    m_internalState = state;
+}
+
+void QMqttConnection::setClientPrivate(QMqttClientPrivate *clientPrivate)
+{
+    m_clientPrivate = clientPrivate;
+}
+
+void QMqttConnection::cleanSubscriptions()
+{
+    const auto unsubscribe = [](quint16, QMqttInflightTable::Entry &entry) {
+        if (entry.subscription)
+            entry.subscription->setState(QMqttSubscription::Unsubscribed);
+    };
+    m_inflight.removeAll(QMqttInflightTable::SubscribeAck, unsubscribe);
+    m_inflight.removeAll(QMqttInflightTable::UnsubscribeAck, unsubscribe);
 
     for (auto item : m_activeSubscriptions)
         item->setState(QMqttSubscription::Unsubscribed);
+    clearSubscriptions();
+}
+
+void QMqttConnection::insertSubscription(QMqttSubscription *subscription)
+{
+    const QMqttTopicFilter topic = subscription->topic();
+    // A shared subscription might replace another one for the same filter
+    removeSubscription(topic);
+    m_activeSubscriptions.insert(topic, subscription);
+    m_subscriptionTree.insert(topic, subscription);
+
+    const auto d = subscription->d_func();
+    if (d->m_assignedSubscriptionIdentifier)
+        m_subscriptionsByIdentifier[d->m_subscriptionIdentifier - 1] = subscription;
+    else if (d->m_subscriptionIdentifier != 0)
+        ++m_explicitSubscriptionIdentifiers;
+}
+
+void QMqttConnection::removeSubscription(const QMqttTopicFilter &topic)
+{
+    const auto it = m_activeSubscriptions.constFind(topic);
+    if (it == m_activeSubscriptions.cend())
+        return;
+
+    const auto d = (*it)->d_func();
+    if (d->m_assignedSubscriptionIdentifier)
+        releaseSubscriptionIdentifier(d->m_subscriptionIdentifier);
+    else if (d->m_subscriptionIdentifier != 0)
+        --m_explicitSubscriptionIdentifiers;
+
+    m_activeSubscriptions.erase(it);
+    m_subscriptionTree.remove(topic);
+}
+
+void QMqttConnection::cancelSubscriptionRequests()
+{
+    // Acknowledgments for these are never received on another connection
+    const auto cancel = [](quint16, QMqttInflightTable::Entry &entry) { entry.completion.cancel(); };
+    m_inflight.forEach(QMqttInflightTable::SubscribeAck, cancel);
+    m_inflight.forEach(QMqttInflightTable::UnsubscribeAck, cancel);
+}
+
+void QMqttConnection::clearSubscriptions()
+{
     m_activeSubscriptions.clear();
+    m_subscriptionTree.clear();
+    m_subscriptionsByIdentifier.clear();
+    m_unusedSubscriptionIdentifiers.clear();
+    m_explicitSubscriptionIdentifiers = 0;
+}
+
+quint32 QMqttConnection::allocateSubscriptionIdentifier()
+{
+    if (!m_unusedSubscriptionIdentifiers.isEmpty())
+        return m_unusedSubscriptionIdentifiers.takeLast();
+    m_subscriptionsByIdentifier.append(nullptr);
+    return quint32(m_subscriptionsByIdentifier.size());
+}
+
+void QMqttConnection::releaseSubscriptionIdentifier(quint32 identifier)
+{
+    m_subscriptionsByIdentifier[identifier - 1] = nullptr;
+    m_unusedSubscriptionIdentifiers.append(identifier);
+}
+
+// Looks up the subscriptions for a message by the subscription identifiers the
+// broker sent along. Returns false if the message has to be matched by its
+// topic instead, which is the case if the broker sent no identifiers, if any
+// identifier is unknown or if the user chose identifiers, which might be
+// shared by several subscriptions.
+bool QMqttConnection::matchSubscriptionIdentifiers(const QMqttTopicName &topic,
+                                                   const QVarLengthArray<quint32, 4> &identifiers,
+                                                   QList<QMqttSubscription *> *subscribers) const
+{
+    if (identifiers.isEmpty() || m_explicitSubscriptionIdentifiers > 0)
+        return false;
+
+    for (const quint32 identifier : identifiers) {
+        if (identifier == 0 || identifier > quint32(m_subscriptionsByIdentifier.size()))
+            return false;
+        QMqttSubscription *subscription = m_subscriptionsByIdentifier.at(identifier - 1);
+        // The identifier might belong to a subscription of a resumed session,
+        // which has been reused since. Checking a single filter is still
+        // cheaper than walking the subscription tree.
+        if (!subscription || !subscription->topic().match(topic))
+            return false;
+        if (!subscribers->contains(subscription))
+            subscribers->append(subscription);
+    }
+    return true;
 }
 
 void QMqttConnection::transportConnectionEstablished()
@@ -676,21 +1170,41 @@ void QMqttConnection::transportConnectionClosed()
 {
     m_readBuffer.clear();
     m_readPosition = 0;
+    m_statistics.readBufferSize.set(0);
+    m_batchBuffer.clear();
+    m_batchedPublishes.clear();
+    discardQueuedPublishes();
+    cancelSubscriptionRequests();
     m_pingTimer.stop();
     m_pingTimeout = 0;
+    m_pingSentTime = -1;
     if (m_internalState == ClientDestruction)
         return;
-    if (m_internalState == BrokerDisconnected) // We manually disconnected
+    if (m_internalState == BrokerDisconnected) { // We manually disconnected
         m_clientPrivate->setStateAndError(QMqttClient::Disconnected, QMqttClient::NoError);
-    else
-        m_clientPrivate->setStateAndError(QMqttClient::Disconnected, QMqttClient::TransportInvalid);
+        return;
+    }
+    if (m_internalState == BrokerConnected)
+        m_statistics.connectionLosses.add();
+    m_clientPrivate->setStateAndError(QMqttClient::Disconnected, QMqttClient::TransportInvalid);
 }
 
 void QMqttConnection::transportReadyRead()
 {
     qCDebug(lcMqttConnectionVerbose) << Q_FUNC_INFO;
-    m_readBuffer.append(m_transport->readAll());
+    // Packets are parsed in place and only advance m_readPosition. The data of
+    // already processed packets is dropped here, so that the unprocessed
+    // remainder is moved at most once per read notification.
+    if (m_readPosition == m_readBuffer.size()) {
+        m_readBuffer = m_transport->readAll();
+    } else {
+        m_readBuffer.remove(0, m_readPosition);
+        m_readBuffer.append(m_transport->readAll());
+    }
+    m_readPosition = 0;
+    m_statistics.readBufferPeak.raise(m_readBuffer.size());
     processData();
+    m_statistics.readBufferSize.set(m_readBuffer.size() - m_readPosition);
 }
 
 void QMqttConnection::transportError(QAbstractSocket::SocketError e)
@@ -733,12 +1247,22 @@ qint32 QMqttConnection::readVariableByteInteger(qint64 *dataSize)
 
 void QMqttConnection::closeConnection(QMqttClient::ClientError error)
 {
+    if (m_internalState == BrokerConnected)
+        m_statistics.connectionLosses.add();
+    if (error == QMqttClient::ProtocolViolation)
+        m_statistics.protocolErrors.add();
+
     m_readBuffer.clear();
     m_readPosition = 0;
+    m_batchBuffer.clear();
+    m_batchedPublishes.clear();
+    discardQueuedPublishes();
+    cancelSubscriptionRequests();
     m_pingTimer.stop();
     m_pingTimeout = 0;
-    m_activeSubscriptions.clear();
-    m_internalState = BrokerDisconnected;
+    m_pingSentTime = -1;
+    clearSubscriptions();
+    setInternalState(BrokerDisconnected);
     m_transport->disconnect();
     m_transport->close();
     m_clientPrivate->setStateAndError(QMqttClient::Disconnected, error);
@@ -756,6 +1280,27 @@ QByteArray QMqttConnection::readBuffer(quint64 size)
     return res;
 }
 
+QByteArray QMqttConnection::readBufferShared(quint64 size)
+{
+    if (Q_UNLIKELY(quint64(m_readBuffer.size() - m_readPosition) < size)) {
+        qCDebug(lcMqttConnection) << "Reaching out of buffer, protocol violation";
+        closeConnection(QMqttClient::ProtocolViolation);
+        return QByteArray();
+    }
+    // Raw data is not reference counted, hence it cannot be shared.
+    if (Q_UNLIKELY(m_readBuffer.data_ptr().d_ptr() == nullptr))
+        return readBuffer(size);
+
+    // The result references the allocation of the read buffer. Modifying the
+    // read buffer afterwards detaches it, so the content of the result stays
+    // valid for as long as it is referenced.
+    QByteArray::DataPointer slice = m_readBuffer.data_ptr();
+    slice.ptr += m_readPosition;
+    slice.size = qsizetype(size);
+    m_readPosition += size;
+    return QByteArray(std::move(slice));
+}
+
 void QMqttConnection::readAuthProperties(QMqttAuthenticationProperties &properties)
 {
     qint64 propertyLength = readVariableByteInteger(&m_missingData);
@@ -944,71 +1489,25 @@ void QMqttConnection::readMessageStatusProperties(QMqttMessageStatusProperties &
     }
 }
 
-void QMqttConnection::readPublishProperties(QMqttPublishProperties &properties)
+bool QMqttConnection::readPublishProperties(QByteArray *block,
+                                            QMqttPublishPropertyBlock::Summary *summary)
 {
-    qint64 propertyLength = readVariableByteInteger(&m_missingData);
+    const qint32 propertyLength = readVariableByteInteger(&m_missingData);
+    if (propertyLength < 0)
+        return false; // readVariableByteInteger closes connection
     m_missingData -= propertyLength;
 
-    QMqttUserProperties userProperties;
-    QList<quint32> subscriptionIds;
-
-    while (propertyLength > 0) {
-        const quint8 propertyId = readBufferTyped<quint8>(&propertyLength);
-        switch (propertyId) {
-        case 0x01: { // 3.3.2.3.2 Payload Format Indicator
-            const quint8 format = readBufferTyped<quint8>(&propertyLength);
-            if (format == 1)
-                properties.setPayloadFormatIndicator(QMqtt::PayloadFormatIndicator::UTF8Encoded);
-            break;
-        }
-        case 0x02: { // 3.3.2.3.3 Message Expiry Interval
-            const quint32 interval = readBufferTyped<quint32>(&propertyLength);
-            properties.setMessageExpiryInterval(interval);
-            break;
-        }
-        case 0x23: { // 3.3.2.3.4 Topic alias
-            const quint16 alias = readBufferTyped<quint16>(&propertyLength);
-            properties.setTopicAlias(alias);
-            break;
-        }
-        case 0x08: { // 3.3.2.3.5 Response Topic
-            const QString responseTopic = readBufferTyped<QString>(&propertyLength);
-            properties.setResponseTopic(responseTopic);
-            break;
-        }
-        case 0x09: { // 3.3.2.3.6 Correlation Data
-            const QByteArray data = readBufferTyped<QByteArray>(&propertyLength);
-            properties.setCorrelationData(data);
-            break;
-        }
-        case 0x26: { // 3.3.2.3.7 User property
-            const QString propertyName = readBufferTyped<QString>(&propertyLength);
-            const QString propertyValue = readBufferTyped<QString>(&propertyLength);
-            userProperties.append(QMqttStringPair(propertyName, propertyValue));
-            break;
-        }
-        case 0x0b: { // 3.3.2.3.8 Subscription Identifier
-            qint32 id = readVariableByteInteger(&propertyLength);
-            if (id < 0)
-                return; // readVariableByteInteger closes connection
-            subscriptionIds.append(quint32(id));
-            break;
-        }
-        case 0x03: { // 3.3.2.3.9 Content Type
-            const QString content = readBufferTyped<QString>(&propertyLength);
-            properties.setContentType(content);
-            break;
-        }
-        default:
-            qCDebug(lcMqttConnection) << "Unknown publish property received.";
-            break;
-        }
+    // Only check the block here, it is decoded once the properties are requested.
+    *block = m_clientPrivate->m_payloadSharing ? readBufferShared(quint64(propertyLength))
+                                               : readBuffer(quint64(propertyLength));
+    if (m_internalState == BrokerDisconnected)
+        return false;
+    if (!QMqttPublishPropertyBlock::validate(*block, summary)) {
+        qCDebug(lcMqttConnection) << "Malformed publish properties received.";
+        closeConnection(QMqttClient::ProtocolViolation);
+        return false;
     }
-    if (!userProperties.isEmpty())
-        properties.setUserProperties(userProperties);
-
-    if (!subscriptionIds.isEmpty())
-        properties.setSubscriptionIdentifiers(subscriptionIds);
+    return true;
 }
 
 void QMqttConnection::readSubscriptionProperties(QMqttSubscription *sub)
@@ -1185,7 +1684,8 @@ QByteArray QMqttConnection::writeLastWillProperties() const
     return properties.serializePayload();
 }
 
-QByteArray QMqttConnection::writePublishProperties(const QMqttPublishProperties &properties)
+QByteArray QMqttConnection::writePublishProperties(const QMqttPublishProperties &properties,
+                                                   bool includeTopicAlias)
 {
     QMqttControlPacket packet;
 
@@ -1215,7 +1715,7 @@ QByteArray QMqttConnection::writePublishProperties(const QMqttPublishProperties
     }
 
     // 3.3.2.3.4 Topic alias
-    if (properties.availableProperties() & QMqttPublishProperties::TopicAlias &&
+    if (includeTopicAlias && properties.availableProperties() & QMqttPublishProperties::TopicAlias &&
             properties.topicAlias() > 0) {
         qCDebug(lcMqttConnectionVerbose) << "Publish Properties: Topic Alias :"
                                          << properties.topicAlias();
@@ -1415,6 +1915,7 @@ void QMqttConnection::finalize_connack()
         // MQTT-4.1.0.-1 MQTT-4.1.0-2 Session not stored on broker side
         // regardless whether cleanSession is false
         cleanSubscriptions();
+        discardPendingMessages();
     }
 
     quint8 connectResultValue = readBufferTyped<quint8>(&m_missingData);
@@ -1430,8 +1931,9 @@ void QMqttConnection::finalize_connack()
     // MQTT 5.0 has variable part != 2 in the header
     if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0) {
         readConnackProperties(m_clientPrivate->m_serverConnectionProperties);
-        m_receiveAliases.resize(m_clientPrivate->m_serverConnectionProperties.maximumTopicAlias());
-        m_publishAliases.resize(m_clientPrivate->m_connectionProperties.maximumTopicAlias());
+        // Incoming aliases are limited by the client, outgoing ones by the server.
+        m_receiveAliases = QList<QMqttTopicName>(m_clientPrivate->m_connectionProperties.maximumTopicAlias());
+        m_publishAliases.reset(m_clientPrivate->m_serverConnectionProperties.maximumTopicAlias());
 
         // 3.2.2.2
         switch (QMqtt::ReasonCode(connectResultValue)) {
@@ -1481,7 +1983,13 @@ void QMqttConnection::finalize_connack()
         }
     }
 
-    m_internalState = BrokerConnected;
+    m_inflightPublishes = 0;
+    setInternalState(BrokerConnected);
+    if (m_statistics.connections.load() > 0)
+        m_statistics.reconnections.add();
+    m_statistics.connections.add();
+    if (sessionPresent)
+        resendPendingMessages();
     m_clientPrivate->setStateAndError(QMqttClient::Connected);
 
     if (m_clientPrivate->m_autoKeepAlive)
@@ -1491,8 +1999,10 @@ void QMqttConnection::finalize_connack()
 void QMqttConnection::finalize_suback()
 {
     const quint16 id = readBufferTyped<quint16>(&m_missingData);
+    Q_TRACE(QMqttConnection_acknowledgmentReceived, m_currentPacket, id);
 
-    auto sub = m_pendingSubscriptionAck.take(id);
+    QMqttInflightTable::Entry request = m_inflight.take(id, QMqttInflightTable::SubscribeAck);
+    auto sub = request.subscription;
     if (Q_UNLIKELY(sub == nullptr)) {
         qCDebug(lcMqttConnection) << "Received SUBACK for unknown subscription request.";
         return;
@@ -1546,20 +2056,26 @@ void QMqttConnection::finalize_suback()
             break;
         }
     } while (m_missingData > 0);
+
+    // Canceled instead if the connection has been closed
+    if (m_internalState == BrokerConnected)
+        request.completion.finish(sub);
 }
 
 void QMqttConnection::finalize_unsuback()
 {
     const quint16 id = readBufferTyped<quint16>(&m_missingData);
     qCDebug(lcMqttConnectionVerbose) << "Finalize UNSUBACK: " << id;
+    Q_TRACE(QMqttConnection_acknowledgmentReceived, m_currentPacket, id);
 
-    auto sub = m_pendingUnsubscriptions.take(id);
+    QMqttInflightTable::Entry request = m_inflight.take(id, QMqttInflightTable::UnsubscribeAck);
+    auto sub = request.subscription;
     if (Q_UNLIKELY(sub == nullptr)) {
         qCDebug(lcMqttConnection) << "Received UNSUBACK for unknown request.";
         return;
     }
 
-    m_activeSubscriptions.remove(sub->topic());
+    removeSubscription(sub->topic());
 
     if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0) {
         readSubscriptionProperties(sub);
@@ -1568,6 +2084,7 @@ void QMqttConnection::finalize_unsuback()
         // emulate successful unsubscription
         sub->d_func()->m_reasonCode = QMqtt::ReasonCode::Success;
         sub->setState(QMqttSubscription::Unsubscribed);
+        request.completion.finish(QMqtt::ReasonCode::Success);
         return;
     }
 
@@ -1597,24 +2114,31 @@ void QMqttConnection::finalize_unsuback()
             break;
         }
     } while (m_missingData > 0);
+
+    if (m_internalState == BrokerConnected)
+        request.completion.finish(sub->d_func()->m_reasonCode);
 }
 
 void QMqttConnection::finalize_publish()
 {
     // String topic
-    QMqttTopicName topic = readBufferTyped<QString>(&m_missingData);
-    const int topicLength = topic.name().size();
+    QByteArray topicUtf8 = readBufferTyped<QByteArray>(&m_missingData);
+    QMqttTopicName topic = QMqttTopicName::fromUtf8(topicUtf8);
+    const qsizetype topicLength = topicUtf8.size();
 
     quint16 id = 0;
     if (m_currentPublish.qos > 0)
         id = readBufferTyped<quint16>(&m_missingData);
 
-    QMqttPublishProperties publishProperties;
-    if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0)
-        readPublishProperties(publishProperties);
+    QByteArray publishPropertyBlock;
+    QMqttPublishPropertyBlock::Summary publishPropertySummary;
+    if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0
+            && !readPublishProperties(&publishPropertyBlock, &publishPropertySummary)) {
+        return;
+    }
 
-    if (publishProperties.availableProperties() & QMqttPublishProperties::TopicAlias) {
-        const quint16 topicAlias = publishProperties.topicAlias();
+    if (publishPropertySummary.details & QMqttPublishProperties::TopicAlias) {
+        const quint16 topicAlias = publishPropertySummary.topicAlias;
         if (topicAlias == 0 || topicAlias > m_clientPrivate->m_connectionProperties.maximumTopicAlias()) {
             qCDebug(lcMqttConnection) << "TopicAlias receive: overflow.";
             closeConnection(QMqttClient::ProtocolViolation);
@@ -1622,11 +2146,12 @@ void QMqttConnection::finalize_publish()
         }
         if (topicLength == 0) { // New message on existing topic alias
             topic = m_receiveAliases.at(topicAlias - 1);
-            if (topic.name().isEmpty()) {
+            if (QMqttTopicNamePrivate::get(topic)->utf8.isEmpty()) {
                 qCDebug(lcMqttConnection) << "TopicAlias receive: alias for unknown topic.";
                 closeConnection(QMqttClient::ProtocolViolation);
                 return;
             }
+            topicUtf8 = QMqttTopicNamePrivate::get(topic)->utf8;
             qCDebug(lcMqttConnectionVerbose) << "TopicAlias receive: Using " << topicAlias;
         } else { // Resetting a topic alias
             qCDebug(lcMqttConnection) << "TopicAlias receive: Resetting:" << topic.name() << " : " << topicAlias;
@@ -1636,33 +2161,47 @@ void QMqttConnection::finalize_publish()
 
     // message
     const quint64 payloadLength = quint64(m_missingData);
-    const QByteArray message = readBuffer(payloadLength);
+    const QByteArray message = m_clientPrivate->m_payloadSharing ? readBufferShared(payloadLength)
+                                                                 : readBuffer(payloadLength);
     m_missingData -= payloadLength;
 
     qCDebug(lcMqttConnectionVerbose) << "Finalize PUBLISH: topic:" << topic
                                      << " payloadLength:" << payloadLength;
 
-    emit m_clientPrivate->m_client->messageReceived(message, topic);
+    if (m_clientPrivate->m_messageReceivedSignal)
+        emit m_clientPrivate->m_client->messageReceived(message, topic);
 
     QMqttMessage qmsg(topic, message, id, m_currentPublish.qos,
                       m_currentPublish.dup, m_currentPublish.retain);
-    qmsg.d->m_publishProperties = publishProperties;
+    qmsg.d->m_publishPropertyBlock = publishPropertyBlock;
 
     if (id != 0) {
         QMqttMessageStatusProperties statusProp;
-        statusProp.data->userProperties = publishProperties.userProperties();
+        if (publishPropertySummary.details & QMqttPublishProperties::UserProperty)
+            statusProp.data->userProperties = qmsg.publishProperties().userProperties();
         emit m_clientPrivate->m_client->messageStatusChanged(id, QMqtt::MessageStatus::Published, statusProp);
     }
 
     // Store subscriptions in a temporary container as each messageReceived is allowed to subscribe
-    // again and thus invalid the iterator of the loop.
+    // again and thus modify the subscription tree.
     QList<QMqttSubscription *> subscribers;
-    for (const auto [key, value] : m_activeSubscriptions.asKeyValueRange()) {
-        if (key.match(topic))
-            subscribers.append(value);
-    }
-    for (const auto &s : subscribers)
+    if (topic.isValid()
+            && !matchSubscriptionIdentifiers(topic, publishPropertySummary.subscriptionIdentifiers,
+                                             &subscribers)) {
+        subscribers.clear();
+        m_subscriptionTree.match(topicUtf8, subscribers);
+    }
+    for (const auto &s : subscribers) {
+        const auto d = s->d_func();
+        d->m_receivedMessages.add();
+        d->m_receivedBytes.add(quint64(payloadLength));
+        // Called through a copy, the handler might replace itself
+        if (d->m_messageHandler) {
+            const QMqttSubscription::MessageHandler handler = d->m_messageHandler;
+            handler(qmsg);
+        }
         emit s->messageReceived(qmsg);
+    }
 
     if (m_currentPublish.qos == 1)
         sendControlPublishAcknowledge(id);
@@ -1674,6 +2213,7 @@ void QMqttConnection::finalize_pubAckRecRelComp()
 {
     qCDebug(lcMqttConnectionVerbose) << "Finalize PUBACK/REC/REL/COMP";
     const quint16 id = readBufferTyped<quint16>(&m_missingData);
+    Q_TRACE(QMqttConnection_acknowledgmentReceived, m_currentPacket, id);
 
     QMqttMessageStatusProperties properties;
     if (m_clientPrivate->m_protocolVersion == QMqttClient::MQTT_5_0 && m_missingData > 0) {
@@ -1724,28 +2264,77 @@ void QMqttConnection::finalize_pubAckRecRelComp()
 
     if ((m_currentPacket & 0xF0) == QMqttControlPacket::PUBCOMP) {
         qCDebug(lcMqttConnectionVerbose) << " PUBCOMP:" << id;
-        auto pendingRelease = m_pendingReleaseMessages.take(id);
-        if (!pendingRelease)
+        QMqttInflightTable::Entry released = m_inflight.take(id, QMqttInflightTable::PublishComplete);
+        if (released.state == QMqttInflightTable::Free) {
             qCDebug(lcMqttConnection) << "Received PUBCOMP for unknown released message.";
+        } else {
+            recordLatency(m_statistics.publishCompleteLatency, released.sentTime);
+            if (m_inflightPublishes > 0)
+                --m_inflightPublishes;
+            if (m_sessionStore)
+                m_sessionStore->removeMessage(id);
+            released.completion.finish(properties.reasonCode());
+        }
         emit m_clientPrivate->m_client->messageStatusChanged(id, QMqtt::MessageStatus::Completed, properties);
         emit m_clientPrivate->m_client->messageSent(id);
+        sendQueuedPublishes();
         return;
     }
 
-    auto pendingMsg = m_pendingMessages.take(id);
-    if (!pendingMsg) {
-        qCDebug(lcMqttConnection) << "Received PUBACK for unknown message: " << id;
-        return;
-    }
     if ((m_currentPacket & 0xF0) == QMqttControlPacket::PUBREC) {
         qCDebug(lcMqttConnectionVerbose) << " PUBREC:" << id;
-        m_pendingReleaseMessages.insert(id, pendingMsg);
+        // MQTT 5 4.3.3 A failure reason code in PUBREC ends the exchange, no
+        // PUBREL is sent. 4.9 The send quota is released like for PUBACK.
+        if (quint8(properties.reasonCode()) >= 0x80) {
+            QMqttInflightTable::Entry rejected = m_inflight.take(id, QMqttInflightTable::PublishAck);
+            if (rejected.state == QMqttInflightTable::Free) {
+                qCDebug(lcMqttConnection) << "Received PUBREC for unknown message: " << id;
+                return;
+            }
+            recordLatency(m_statistics.publishReceivedLatency, rejected.sentTime);
+            if (m_sessionStore)
+                m_sessionStore->removeMessage(id);
+            if (m_inflightPublishes > 0)
+                --m_inflightPublishes;
+            emit m_clientPrivate->m_client->messageStatusChanged(id, QMqtt::MessageStatus::Received, properties);
+            rejected.completion.finish(properties.reasonCode());
+            sendQueuedPublishes();
+            return;
+        }
+
+        QMqttInflightTable::Entry *pending = m_inflight.transition(id, QMqttInflightTable::PublishAck,
+                                                                   QMqttInflightTable::PublishComplete);
+        if (!pending) {
+            qCDebug(lcMqttConnection) << "Received PUBREC for unknown message: " << id;
+            return;
+        }
+        recordLatency(m_statistics.publishReceivedLatency, pending->sentTime);
+        // The message does not need to be retransmitted anymore, only PUBREL.
+        pending->packet.reset();
+        pending->resendHeader.clear();
+        if (m_sessionStore)
+            m_sessionStore->releaseMessage(id);
         emit m_clientPrivate->m_client->messageStatusChanged(id, QMqtt::MessageStatus::Received, properties);
+        // Slots connected to messageStatusChanged() might have modified the table
+        if (QMqttInflightTable::Entry *released = m_inflight.find(id, QMqttInflightTable::PublishComplete))
+            released->sentTime = elapsed();
         sendControlPublishRelease(id);
     } else {
         qCDebug(lcMqttConnectionVerbose) << " PUBACK:" << id;
+        QMqttInflightTable::Entry acknowledged = m_inflight.take(id, QMqttInflightTable::PublishAck);
+        if (acknowledged.state == QMqttInflightTable::Free) {
+            qCDebug(lcMqttConnection) << "Received PUBACK for unknown message: " << id;
+            return;
+        }
+        recordLatency(m_statistics.publishAcknowledgeLatency, acknowledged.sentTime);
+        if (m_sessionStore)
+            m_sessionStore->removeMessage(id);
+        if (m_inflightPublishes > 0)
+            --m_inflightPublishes;
         emit m_clientPrivate->m_client->messageStatusChanged(id, QMqtt::MessageStatus::Acknowledged, properties);
         emit m_clientPrivate->m_client->messageSent(id);
+        acknowledged.completion.finish(properties.reasonCode());
+        sendQueuedPublishes();
     }
 }
 
@@ -1760,6 +2349,7 @@ void QMqttConnection::finalize_pingresp()
         return;
     }
     m_pingTimeout--;
+    recordLatency(m_statistics.pingResponseLatency, std::exchange(m_pingSentTime, -1));
     emit m_clientPrivate->m_client->pingResponseReceived();
 }
 
@@ -1769,6 +2359,7 @@ bool QMqttConnection::processDataHelper()
         if ((m_readBuffer.size() - m_readPosition) < m_missingData)
             return false;
 
+        Q_TRACE_SCOPE(QMqttConnection_finalizePacket, m_currentPacket);
         switch (m_currentPacket & 0xF0) {
         case QMqttControlPacket::AUTH:
             finalize_auth();
@@ -1804,33 +2395,32 @@ bool QMqttConnection::processDataHelper()
             return false;
 
         Q_ASSERT(m_missingData == 0);
-
-        m_readBuffer = m_readBuffer.mid(m_readPosition);
-        m_readPosition = 0;
     }
 
     // MQTT-2.2 A fixed header of a control packet must be at least 2 bytes. If the payload is
     // longer than 127 bytes the header can be up to 5 bytes long.
-    switch (m_readBuffer.size()) {
+    const char *fixedHeader = m_readBuffer.constData() + m_readPosition;
+    switch (m_readBuffer.size() - m_readPosition) {
     case 0:
     case 1:
         return false;
     case 2:
-        if ((m_readBuffer.at(1) & 128) != 0)
+        if ((fixedHeader[1] & 128) != 0)
             return false;
         break;
     case 3:
-        if ((m_readBuffer.at(1) & 128) != 0 && (m_readBuffer.at(2) & 128) != 0)
+        if ((fixedHeader[1] & 128) != 0 && (fixedHeader[2] & 128) != 0)
             return false;
         break;
     case 4:
-        if ((m_readBuffer.at(1) & 128) != 0 && (m_readBuffer.at(2) & 128) != 0 && (m_readBuffer.at(3) & 128) != 0)
+        if ((fixedHeader[1] & 128) != 0 && (fixedHeader[2] & 128) != 0 && (fixedHeader[3] & 128) != 0)
             return false;
         break;
     default:
         break;
     }
 
+    const qsizetype packetStart = m_readPosition;
     readBuffer(reinterpret_cast<char *>(&m_currentPacket), 1);
 
     switch (m_currentPacket & 0xF0) {
@@ -1950,6 +2540,14 @@ bool QMqttConnection::processDataHelper()
             closeConnection(QMqttClient::ProtocolViolation);
             return false;
         }
+        {
+            // The reason code and properties are not evaluated
+            const qint32 remaining = readVariableByteInteger();
+            if (remaining < 0)
+                return false; // Connection closed inside readVariableByteInteger
+            m_statistics.countReceived(m_currentPacket, m_readPosition - packetStart + remaining);
+            Q_TRACE(QMqttConnection_packetReceived, m_currentPacket, m_readPosition - packetStart + remaining);
+        }
         closeConnection(QMqttClient::NoError);
         return false;
     default:
@@ -1961,6 +2559,8 @@ bool QMqttConnection::processDataHelper()
     /* set current command CONNACK - PINGRESP */
     /* read command size */
     /* calculate missing_data */
+    m_statistics.countReceived(m_currentPacket, m_readPosition - packetStart + m_missingData);
+    Q_TRACE(QMqttConnection_packetReceived, m_currentPacket, m_readPosition - packetStart + m_missingData);
     return true; // reiterate. implicitly finishes and enqueues
 }
 
@@ -1972,9 +2572,63 @@ void QMqttConnection::processData()
 
 bool QMqttConnection::writePacketToTransport(const QMqttControlPacket &p)
 {
-    const QByteArray writeData = p.serialize();
-    qCDebug(lcMqttConnectionVerbose) << Q_FUNC_INFO << " DataSize:" << writeData.size();
-    const qint64 res = m_transport->write(writeData.constData(), writeData.size());
+    // Buffered devices keep a QByteArray of at least this size by reference
+    // instead of copying it into their write buffer.
+    constexpr qsizetype SeparateMessageThreshold = 4096;
+    // A batch is written to the transport as soon as it reaches this size.
+    constexpr qsizetype BatchFlushThreshold = 64 * 1024;
+
+    const QByteArray &payload = p.payload();
+    const QByteArray &message = p.applicationMessage();
+    const bool separateMessage = m_transportType != QMqttClient::IODevice
+                                 && message.size() >= SeparateMessageThreshold;
+
+    char fixedHeader[QMqttControlPacket::MaximumFixedHeaderSize];
+    const int fixedHeaderSize = p.serializeFixedHeader(fixedHeader);
+
+    m_statistics.countSent(p.header(), fixedHeaderSize + payload.size() + message.size());
+    Q_TRACE(QMqttConnection_packetWritten, p.header(), fixedHeaderSize + payload.size() + message.size());
+
+    // Only PUBLISH packets are collected. Acknowledgments, pings and other
+    // control packets must not wait for the end of a batch, which might be
+    // several event loop iterations away.
+    if (m_batchNesting > 0 && !separateMessage && m_internalState == BrokerConnected
+            && (p.header() & 0xF0) == QMqttControlPacket::PUBLISH) {
+        m_batchBuffer.append(fixedHeader, fixedHeaderSize);
+        m_batchBuffer.append(payload);
+        m_batchBuffer.append(message);
+        if (m_batchBuffer.size() >= BatchFlushThreshold)
+            return flushBatch();
+        return true;
+    }
+
+    // Packets of a pending batch need to be sent first to keep the order.
+    if (!flushBatch())
+        return false;
+
+    // The fixed header, the variable header and small messages are assembled
+    // in one contiguous buffer, so that the transport receives a single write.
+    QVarLengthArray<char, 1024> writeData;
+    writeData.reserve(fixedHeaderSize + payload.size() + (separateMessage ? 0 : message.size()));
+    writeData.append(fixedHeader, fixedHeaderSize);
+    writeData.append(payload.constData(), payload.size());
+    if (!separateMessage)
+        writeData.append(message.constData(), message.size());
+
+    qCDebug(lcMqttConnectionVerbose) << Q_FUNC_INFO << " DataSize:"
+                                     << fixedHeaderSize + payload.size() + message.size();
+    // Persisted messages need to be durable before they are sent.
+    if (m_sessionStore)
+        m_sessionStore->sync();
+
+    m_statistics.transportWrites.add();
+    Q_TRACE(QMqttConnection_transportWrite, writeData.size());
+    qint64 res = m_transport->write(writeData.constData(), writeData.size());
+    if (res != -1 && separateMessage) {
+        m_statistics.transportWrites.add();
+        Q_TRACE(QMqttConnection_transportWrite, message.size());
+        res = m_transport->write(message);
+    }
     if (Q_UNLIKELY(res == -1)) {
         qCDebug(lcMqttConnection) << "Could not write frame to transport.";
         return false;
@@ -1982,4 +2636,32 @@ bool QMqttConnection::writePacketToTransport(const QMqttControlPacket &p)
     return true;
 }
 
+bool QMqttConnection::flushBatch()
+{
+    if (m_batchBuffer.isEmpty())
+        return true;
+
+    qCDebug(lcMqttConnectionVerbose) << Q_FUNC_INFO << " DataSize:" << m_batchBuffer.size();
+    if (m_sessionStore)
+        m_sessionStore->sync();
+    m_statistics.transportWrites.add();
+    Q_TRACE(QMqttConnection_transportWrite, m_batchBuffer.size());
+    const qint64 res = m_transport->write(m_batchBuffer);
+    m_batchBuffer.clear();
+    const QList<quint16> batchedPublishes = std::exchange(m_batchedPublishes, {});
+    if (Q_UNLIKELY(res == -1)) {
+        qCDebug(lcMqttConnection) << "Could not write batch to transport.";
+        // Same as a failed write in publish(), the messages have not been sent.
+        for (quint16 id : batchedPublishes) {
+            if (!m_inflight.remove(id, QMqttInflightTable::PublishAck))
+                continue;
+            --m_inflightPublishes;
+            if (m_sessionStore)
+                m_sessionStore->removeMessage(id);
+        }
+        return false;
+    }
+    return true;
+}
+
 QT_END_NAMESPACE
@@ -18,14 +18,29 @@
 #include "qmqttclient.h"
 #include "qmqttcontrolpacket_p.h"
 #include "qmqttmessage.h"
+#include "qmqttinflighttable_p.h"
+#include "qmqttmpscqueue_p.h"
+#include "qmqttpublishproperties_p.h"
+#include "qmqttsessionstore.h"
+#include "qmqttstatistics_p.h"
 #include "qmqttsubscription.h"
+#include "qmqttsubscriptiontree_p.h"
+#include "qmqtttopicaliastable_p.h"
 #include <QtCore/QBasicTimer>
 #include <QtCore/QBuffer>
+#include <QtCore/QElapsedTimer>
+#if QT_CONFIG(future)
+#include <QtCore/QFuture>
+#include <QtCore/QFutureInterface>
+#endif
 #include <QtCore/QHash>
 #include <QtCore/QObject>
+#include <QtCore/QQueue>
 #include <QtCore/QSharedPointer>
 #include <QtCore/QtEndian>
 
+#include <optional>
+
 QT_BEGIN_NAMESPACE
 
 class QMqttClientPrivate;
@@ -54,21 +69,39 @@ public:
     bool sendControlConnect();
     bool sendControlAuthenticate(const QMqttAuthenticationProperties &properties);
     qint32 sendControlPublish(const QMqttTopicName &topic, const QByteArray &message, quint8 qos = 0, bool retain = false,
-                              const QMqttPublishProperties &properties = QMqttPublishProperties());
+                              const QMqttPublishProperties &properties = QMqttPublishProperties(),
+                              QMqttCompletion *completion = nullptr);
     bool sendControlPublishAcknowledge(quint16 id);
     bool sendControlPublishRelease(quint16 id);
     bool sendControlPublishReceive(quint16 id);
     bool sendControlPublishComp(quint16 id);
-    QMqttSubscription *sendControlSubscribe(const QMqttTopicFilter &topic, quint8 qos, const QMqttSubscriptionProperties &properties);
-    bool sendControlUnsubscribe(const QMqttTopicFilter &topic, const QMqttUnsubscriptionProperties &properties);
+    QMqttSubscription *sendControlSubscribe(const QMqttTopicFilter &topic, quint8 qos, const QMqttSubscriptionProperties &properties,
+                                            QMqttCompletion *completion = nullptr);
+    bool sendControlUnsubscribe(const QMqttTopicFilter &topic, const QMqttUnsubscriptionProperties &properties,
+                                QMqttCompletion *completion = nullptr);
     bool sendControlPingRequest(bool isAuto = true);
     bool sendControlDisconnect();
 
+    void beginBatch();
+    bool endBatch();
+
+#if QT_CONFIG(future)
+    QFuture<qint32> postPublish(const QMqttTopicName &topic, const QByteArray &message, quint8 qos,
+                                bool retain, const QMqttPublishProperties &properties);
+#endif
+
+    inline qsizetype publishQueueSize() const { return m_publishQueue.size(); }
+
+    QMqttStatistics statistics() const;
+    QMqttLatencyHistogram latencyHistogram(QMqttStatistics::PacketType acknowledgment) const;
+
+    void setSessionStore(QMqttSessionStore *store);
+    inline QMqttSessionStore *sessionStore() const { return m_sessionStore; }
+
     void setClientPrivate(QMqttClientPrivate *clientPrivate);
 
-    inline quint16 unusedPacketIdentifier() const;
     inline InternalConnectionState internalState() const { return m_internalState; }
-    inline void setClientDestruction() { m_internalState = ClientDestruction; }
+    inline void setClientDestruction() { setInternalState(ClientDestruction); }
 
     void cleanSubscriptions();
 
@@ -77,6 +110,7 @@ private:
     void transportConnectionClosed();
     void transportReadyRead();
     void transportError(QAbstractSocket::SocketError e);
+    void setInternalState(InternalConnectionState state);
 
 protected:
     void timerEvent(QTimerEvent *event) override;
@@ -105,19 +139,21 @@ private:
     void readAuthProperties(QMqttAuthenticationProperties &properties);
     void readConnackProperties(QMqttServerConnectionProperties &properties);
     void readMessageStatusProperties(QMqttMessageStatusProperties &properties);
-    void readPublishProperties(QMqttPublishProperties &properties);
+    bool readPublishProperties(QByteArray *block, QMqttPublishPropertyBlock::Summary *summary);
     void readSubscriptionProperties(QMqttSubscription *sub);
     QByteArray writeConnectProperties();
     QByteArray writeLastWillProperties() const;
-    QByteArray writePublishProperties(const QMqttPublishProperties &properties);
+    QByteArray writePublishProperties(const QMqttPublishProperties &properties,
+                                      bool includeTopicAlias = true);
     QByteArray writeSubscriptionProperties(const QMqttSubscriptionProperties &properties);
     QByteArray writeUnsubscriptionProperties(const QMqttUnsubscriptionProperties &properties);
     QByteArray writeAuthenticationProperties(const QMqttAuthenticationProperties &properties);
     void closeConnection(QMqttClient::ClientError error);
     QByteArray readBuffer(quint64 size);
+    QByteArray readBufferShared(quint64 size);
     template<typename T> T readBufferTyped(qint64 *dataSize = nullptr);
     QByteArray m_readBuffer;
-    int m_readPosition{0};
+    qsizetype m_readPosition{0};
     qint64 m_missingData{0};
     struct PublishData {
         quint8 qos;
@@ -128,17 +164,69 @@ private:
     QMqttControlPacket::PacketType m_currentPacket{QMqttControlPacket::UNKNOWN};
 
     bool writePacketToTransport(const QMqttControlPacket &p);
-    QHash<quint16, QMqttSubscription *> m_pendingSubscriptionAck;
-    QHash<quint16, QMqttSubscription *> m_pendingUnsubscriptions;
+    bool flushBatch();
+    QByteArray m_batchBuffer;
+    QList<quint16> m_batchedPublishes; // Identifiers of QoS 1 and 2 messages in m_batchBuffer
+    int m_batchNesting{0};
+    QMqttStatisticsCounters m_statistics;
+    // Monotonic time in nanoseconds for round trip measurements
+    inline qint64 elapsed() const { return m_clock.nsecsElapsed(); }
+    void recordLatency(QMqttLatencyRecorder &recorder, qint64 sentTime);
+    QElapsedTimer m_clock;
+    qint64 m_pingSentTime{-1};
+
+    QMqttInflightTable m_inflight;
+    void insertSubscription(QMqttSubscription *subscription);
+    void removeSubscription(const QMqttTopicFilter &topic);
+    void clearSubscriptions();
+    void cancelSubscriptionRequests();
+    quint32 allocateSubscriptionIdentifier();
+    void releaseSubscriptionIdentifier(quint32 identifier);
+    bool matchSubscriptionIdentifiers(const QMqttTopicName &topic,
+                                      const QVarLengthArray<quint32, 4> &identifiers,
+                                      QList<QMqttSubscription *> *subscribers) const;
     QHash<QMqttTopicFilter, QMqttSubscription *> m_activeSubscriptions;
-    QHash<quint16, QSharedPointer<QMqttControlPacket>> m_pendingMessages;
-    QHash<quint16, QSharedPointer<QMqttControlPacket>> m_pendingReleaseMessages;
+    QMqttSubscriptionTree m_subscriptionTree;
+    QList<QMqttSubscription *> m_subscriptionsByIdentifier; // Indexed by assigned identifier - 1
+    QList<quint32> m_unusedSubscriptionIdentifiers;
+    int m_explicitSubscriptionIdentifiers{0};
+    void resendPendingMessages();
+    void discardPendingMessages();
+    void persistPendingMessage(quint16 id, const QMqttInflightTable::Entry &pending);
+    quint64 m_publishSequence{0};
+    QMqttSessionStore *m_sessionStore{nullptr};
+    struct QueuedPublish {
+        QSharedPointer<QMqttControlPacket> packet;
+        quint16 identifier; // 0 for QoS 0
+        bool retransmission{false}; // Sent on a previous connection, part of the session
+    };
+    void sendQueuedPublishes();
+    void prepareRetransmission(QMqttInflightTable::Entry *pending);
+#if QT_CONFIG(future)
+    struct PostedPublish {
+        QMqttTopicName topic;
+        QByteArray message;
+        QMqttPublishProperties properties;
+        QFutureInterface<qint32> result;
+        quint8 qos;
+        bool retain;
+    };
+    void sendPostedPublishes();
+    // Wrapped in std::optional as empty slots must not allocate
+    QMqttMpscQueue<std::optional<PostedPublish>> m_postedPublishes{1024};
+    QAtomicInt m_postedPublishesScheduled{0};
+#endif
+    void discardQueuedPublishes();
+    void updatePublishBackpressure();
+    QQueue<QueuedPublish> m_publishQueue;
+    int m_inflightPublishes{0};
+    bool m_publishBackpressure{false};
     InternalConnectionState m_internalState{BrokerDisconnected};
     QBasicTimer m_pingTimer;
     int m_pingTimeout{0};
 
     QList<QMqttTopicName> m_receiveAliases;
-    QList<QMqttTopicName> m_publishAliases;
+    QMqttTopicAliasTable m_publishAliases;
 };
 
 QT_END_NAMESPACE
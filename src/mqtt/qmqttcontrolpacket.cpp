@@ -30,6 +30,7 @@ void QMqttControlPacket::clear()
 {
     m_header = 0;
     m_payload.clear();
+    m_message.clear();
 }
 
 void QMqttControlPacket::setHeader(quint8 h)
@@ -86,22 +87,34 @@ void QMqttControlPacket::appendRawVariableInteger(quint32 value)
     appendRaw(data);
 }
 
-QByteArray QMqttControlPacket::serialize() const
+/*!
+    \internal
+    Sets the application message of a PUBLISH packet to \a message. The
+    message is not copied into the payload, it is kept as a separate segment
+    following the payload, so that it can be handed to the transport as is.
+*/
+void QMqttControlPacket::setApplicationMessage(const QByteArray &message)
 {
-    // Create ByteArray
-    QByteArray data;
-    // Add Header
-    data.append(char(m_header));
-    data.append(serializePayload());
+    m_message = message;
+}
 
-    return data;
+quint32 QMqttControlPacket::remainingLength() const
+{
+    return quint32(m_payload.size() + m_message.size());
 }
 
-QByteArray QMqttControlPacket::serializePayload() const
+/*!
+    \internal
+    Writes the fixed header, consisting of the header byte and the remaining
+    length, to \a buffer and returns the number of bytes written. \a buffer
+    must provide space for at least MaximumFixedHeaderSize bytes.
+*/
+int QMqttControlPacket::serializeFixedHeader(char *buffer) const
 {
-    QByteArray data;
-    // Add length
-    quint32 msgSize = quint32(m_payload.size());
+    int size = 0;
+    buffer[size++] = char(m_header);
+
+    quint32 msgSize = remainingLength();
     if (msgSize > 268435455)
         qCDebug(lcMqttClient) << "Publishing a message bigger than maximum size.";
     do {
@@ -109,10 +122,35 @@ QByteArray QMqttControlPacket::serializePayload() const
         msgSize /= 128;
         if (msgSize > 0)
             b |= 0x80;
-        data.append(char(b));
-    } while (msgSize > 0);
-    // Add payload
+        buffer[size++] = char(b);
+    } while (msgSize > 0 && size < MaximumFixedHeaderSize);
+    return size;
+}
+
+QByteArray QMqttControlPacket::serialize() const
+{
+    char fixedHeader[MaximumFixedHeaderSize];
+    const int fixedHeaderSize = serializeFixedHeader(fixedHeader);
+
+    QByteArray data;
+    data.reserve(fixedHeaderSize + m_payload.size() + m_message.size());
+    data.append(fixedHeader, fixedHeaderSize);
+    data.append(m_payload);
+    data.append(m_message);
+    return data;
+}
+
+QByteArray QMqttControlPacket::serializePayload() const
+{
+    // Same as serialize(), but without the header byte
+    char fixedHeader[MaximumFixedHeaderSize];
+    const int fixedHeaderSize = serializeFixedHeader(fixedHeader);
+
+    QByteArray data;
+    data.reserve(fixedHeaderSize - 1 + m_payload.size() + m_message.size());
+    data.append(fixedHeader + 1, fixedHeaderSize - 1);
     data.append(m_payload);
+    data.append(m_message);
     return data;
 }
 
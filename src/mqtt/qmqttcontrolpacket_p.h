@@ -52,6 +52,7 @@ public:
 
     void setHeader(quint8 h);
     inline quint8 header() const { return m_header; }
+    inline void setDuplicateFlag() { m_header |= 0x08; }
 
     void append(char value);
     void append(quint16 value);
@@ -60,12 +61,20 @@ public:
     void appendRaw(const QByteArray &data);
     void appendRawVariableInteger(quint32 value);
 
+    void setApplicationMessage(const QByteArray &message);
+    inline const QByteArray &applicationMessage() const { return m_message; }
+
+    enum { MaximumFixedHeaderSize = 5 };
+    quint32 remainingLength() const;
+    int serializeFixedHeader(char *buffer) const;
+
     QByteArray serialize() const;
     QByteArray serializePayload() const;
-    inline QByteArray payload() const { return m_payload; }
+    inline const QByteArray &payload() const { return m_payload; }
 private:
     quint8 m_header{UNKNOWN};
     QByteArray m_payload;
+    QByteArray m_message;
 };
 
 QT_END_NAMESPACE
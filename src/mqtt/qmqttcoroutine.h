@@ -0,0 +1,232 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTCOROUTINE_H
+#define QMQTTCOROUTINE_H
+
+#include <QtMqtt/qmqttglobal.h>
+#include <QtMqtt/qmqttclient.h>
+#include <QtMqtt/qmqttmessage.h>
+#include <QtMqtt/qmqttsubscription.h>
+
+#if QT_CONFIG(future)
+#include <QtCore/QFuture>
+#endif
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QQueue>
+
+#include <optional>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#  include <coroutine>
+#  if defined(__cpp_lib_coroutine)
+#    define QT_MQTT_HAS_COROUTINES
+#  endif
+#endif
+
+#ifdef QT_MQTT_HAS_COROUTINES
+
+QT_BEGIN_NAMESPACE
+
+class QMqttConnectAwaitable
+{
+public:
+    explicit QMqttConnectAwaitable(QMqttClient *client) : m_client(client)
+    {
+        if (m_client->state() == QMqttClient::Disconnected)
+            m_client->connectToHost();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return m_client->state() != QMqttClient::Connecting;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_connection = QObject::connect(m_client, &QMqttClient::stateChanged, m_client,
+                                        [this, handle](QMqttClient::ClientState state) {
+            if (state == QMqttClient::Connecting)
+                return;
+            QObject::disconnect(m_connection);
+            handle.resume();
+        });
+    }
+
+    QMqttClient::ClientError await_resume() const noexcept
+    {
+        if (m_client->state() == QMqttClient::Connected)
+            return QMqttClient::NoError;
+        return m_client->error() != QMqttClient::NoError ? m_client->error()
+                                                           : QMqttClient::TransportInvalid;
+    }
+
+private:
+    QMqttClient *m_client;
+    QMetaObject::Connection m_connection;
+};
+
+#if QT_CONFIG(future)
+template<typename T>
+class QMqttFutureAwaitable
+{
+public:
+    explicit QMqttFutureAwaitable(const QFuture<T> &future) : m_future(future) { }
+
+    bool await_ready() const noexcept { return m_future.isFinished(); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // Exactly one of both is called, the continuation is skipped if the
+        // future has been canceled.
+        m_future.then(QtFuture::Launch::Sync, [handle](const QFuture<T> &) { handle.resume(); })
+                .onCanceled([handle]() { handle.resume(); });
+    }
+
+    std::optional<T> await_resume() const
+    {
+        if (m_future.isCanceled() || m_future.resultCount() == 0)
+            return std::nullopt;
+        return m_future.result();
+    }
+
+private:
+    QFuture<T> m_future;
+};
+#endif // QT_CONFIG(future)
+
+class QMqttMessageStream
+{
+public:
+    class NextAwaitable
+    {
+    public:
+        explicit NextAwaitable(QMqttMessageStream *stream) : m_stream(stream) { }
+
+        bool await_ready() const noexcept
+        {
+            return !m_stream->m_pending.isEmpty() || m_stream->m_finished;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            m_stream->m_waiting = handle;
+        }
+
+        std::optional<QMqttMessage> await_resume()
+        {
+            if (m_stream->m_pending.isEmpty())
+                return std::nullopt;
+            return m_stream->m_pending.dequeue();
+        }
+
+    private:
+        QMqttMessageStream *m_stream;
+    };
+
+    explicit QMqttMessageStream(QMqttSubscription *subscription) : m_subscription(subscription)
+    {
+        if (!m_subscription) {
+            m_finished = true;
+            return;
+        }
+        m_previousHandler = m_subscription->messageHandler();
+        m_subscription->setMessageHandler([this](const QMqttMessage &message) {
+            m_pending.enqueue(message);
+            resumeWaiting();
+        });
+        const auto finish = [this]() {
+            m_finished = true;
+            resumeWaiting();
+        };
+        m_stateConnection = QObject::connect(m_subscription, &QMqttSubscription::stateChanged,
+                                             m_subscription,
+                                             [finish](QMqttSubscription::SubscriptionState state) {
+            if (state == QMqttSubscription::Unsubscribed || state == QMqttSubscription::Error)
+                finish();
+        });
+        m_destroyedConnection = QObject::connect(m_subscription, &QObject::destroyed, finish);
+    }
+
+    ~QMqttMessageStream()
+    {
+        QObject::disconnect(m_stateConnection);
+        QObject::disconnect(m_destroyedConnection);
+        // Typically called from within the handler installed above, when the
+        // coroutine it resumed leaves its loop. The client calls a copy of the
+        // handler, which is not touched once the coroutine has been resumed.
+        if (m_subscription)
+            m_subscription->setMessageHandler(std::move(m_previousHandler));
+    }
+
+    inline QMqttSubscription *subscription() const { return m_subscription.data(); }
+    inline bool isFinished() const { return m_finished && m_pending.isEmpty(); }
+
+    NextAwaitable next() { return NextAwaitable(this); }
+
+private:
+    Q_DISABLE_COPY_MOVE(QMqttMessageStream)
+
+    // The stream might be deleted by the resumed coroutine, it must not be
+    // accessed afterwards.
+    void resumeWaiting()
+    {
+        if (!m_waiting)
+            return;
+        std::exchange(m_waiting, nullptr).resume();
+    }
+
+    QPointer<QMqttSubscription> m_subscription;
+    QMqttSubscription::MessageHandler m_previousHandler;
+    QMetaObject::Connection m_stateConnection;
+    QMetaObject::Connection m_destroyedConnection;
+    QQueue<QMqttMessage> m_pending;
+    std::coroutine_handle<> m_waiting;
+    bool m_finished{false};
+};
+
+namespace QMqtt {
+
+inline QMqttConnectAwaitable connectToHost(QMqttClient *client)
+{
+    return QMqttConnectAwaitable(client);
+}
+
+#if QT_CONFIG(future)
+template<typename T>
+inline QMqttFutureAwaitable<T> awaitable(const QFuture<T> &future)
+{
+    return QMqttFutureAwaitable<T>(future);
+}
+
+inline QMqttFutureAwaitable<QMqtt::ReasonCode> publish(QMqttClient *client,
+                                                       const QMqttTopicName &topic,
+                                                       const QByteArray &message = QByteArray(),
+                                                       quint8 qos = 0, bool retain = false)
+{
+    return awaitable(client->publishAsync(topic, message, qos, retain));
+}
+
+inline QMqttFutureAwaitable<QMqttSubscription *> subscribe(QMqttClient *client,
+                                                           const QMqttTopicFilter &topic,
+                                                           quint8 qos = 0)
+{
+    return awaitable(client->subscribeAsync(topic, qos));
+}
+
+inline QMqttFutureAwaitable<QMqtt::ReasonCode> unsubscribe(QMqttClient *client,
+                                                           const QMqttTopicFilter &topic)
+{
+    return awaitable(client->unsubscribeAsync(topic));
+}
+#endif // QT_CONFIG(future)
+
+} // namespace QMqtt
+
+QT_END_NAMESPACE
+
+#endif // QT_MQTT_HAS_COROUTINES
+
+#endif // QMQTTCOROUTINE_H
@@ -0,0 +1,153 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqttinflighttable_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttInflightTable
+    \internal
+
+    \brief The QMqttInflightTable class holds the state of all packets of a
+    connection which are waiting for an acknowledgment.
+
+    Entries are indexed by their packet identifier. The identifier space is
+    split into pages of 256 entries, which are allocated when the first
+    identifier of a page is used and deleted once the page is empty again.
+    As identifiers are handed out in increasing order, the messages in flight
+    usually share a few pages and looking up an acknowledgment is a single
+    array access.
+
+    Each entry is tagged with the state of the packet, an acknowledgment is
+    only matched if the entry is in the expected state.
+*/
+
+QMqttInflightTable::QMqttInflightTable() = default;
+
+QMqttInflightTable::~QMqttInflightTable()
+{
+    clear();
+}
+
+/*!
+    Allocates an unused packet identifier and creates an entry for it in
+    \a state. Returns \c 0 if all identifiers are in use.
+*/
+quint16 QMqttInflightTable::allocate(State state)
+{
+    Q_ASSERT(state != Free && state != StateCount);
+    const quint16 identifier = m_identifiers.allocate();
+    if (identifier != 0)
+        acquire(identifier, state);
+    return identifier;
+}
+
+/*!
+    Creates an entry in \a state for \a identifier, for instance when restoring
+    a session. Returns \c nullptr if \a identifier is invalid or in use.
+*/
+QMqttInflightTable::Entry *QMqttInflightTable::insert(quint16 identifier, State state)
+{
+    Q_ASSERT(state != Free && state != StateCount);
+    if (!m_identifiers.reserve(identifier))
+        return nullptr;
+    return &acquire(identifier, state);
+}
+
+/*!
+    Returns the entry for \a identifier if it is in \a state, otherwise
+    \c nullptr.
+*/
+QMqttInflightTable::Entry *QMqttInflightTable::find(quint16 identifier, State state)
+{
+    Page *page = m_pages[identifier / PageSize];
+    if (!page)
+        return nullptr;
+    Entry &entry = page->entries[identifier % PageSize];
+    return entry.state == state ? &entry : nullptr;
+}
+
+/*!
+    Moves the entry for \a identifier from state \a from to state \a to.
+    Returns the entry, or \c nullptr if there is no entry in state \a from.
+*/
+QMqttInflightTable::Entry *QMqttInflightTable::transition(quint16 identifier, State from, State to)
+{
+    Q_ASSERT(to != Free && to != StateCount);
+    Entry *entry = find(identifier, from);
+    if (!entry)
+        return nullptr;
+    addCount(from, -1);
+    addCount(to, 1);
+    entry->state = to;
+    return entry;
+}
+
+/*!
+    Removes the entry for \a identifier if it is in \a state and returns it.
+    Returns an entry in state Free otherwise. The identifier can be allocated
+    again afterwards.
+*/
+QMqttInflightTable::Entry QMqttInflightTable::take(quint16 identifier, State state)
+{
+    Entry result;
+    Entry *entry = find(identifier, state);
+    if (!entry)
+        return result;
+    result = std::move(*entry);
+    remove(identifier, state);
+    return result;
+}
+
+/*!
+    Removes the entry for \a identifier if it is in \a state. Returns \c true
+    if an entry has been removed.
+*/
+bool QMqttInflightTable::remove(quint16 identifier, State state)
+{
+    if (!find(identifier, state))
+        return false;
+    const int index = identifier / PageSize;
+    Page *page = m_pages[index];
+    release(identifier, page, page->entries[identifier % PageSize]);
+    if (page->used == 0) {
+        delete page;
+        m_pages[index] = nullptr;
+    }
+    return true;
+}
+
+void QMqttInflightTable::clear()
+{
+    for (Page *&page : m_pages) {
+        delete page;
+        page = nullptr;
+    }
+    for (QAtomicInt &counter : m_counts)
+        counter.storeRelaxed(0);
+    m_identifiers.clear();
+}
+
+QMqttInflightTable::Entry &QMqttInflightTable::acquire(quint16 identifier, State state)
+{
+    Page *&page = m_pages[identifier / PageSize];
+    if (!page)
+        page = new Page;
+    Entry &entry = page->entries[identifier % PageSize];
+    Q_ASSERT(entry.state == Free);
+    entry.state = state;
+    ++page->used;
+    addCount(state, 1);
+    return entry;
+}
+
+void QMqttInflightTable::release(quint16 identifier, Page *page, Entry &entry)
+{
+    addCount(entry.state, -1);
+    --page->used;
+    entry = Entry();
+    m_identifiers.release(identifier);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,208 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTINFLIGHTTABLE_P_H
+#define QMQTTINFLIGHTTABLE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttcontrolpacket_p.h"
+#include "qmqttglobal.h"
+#include "qmqttpacketidentifierallocator_p.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QByteArray>
+#if QT_CONFIG(future)
+#include <QtCore/QFutureInterface>
+#endif
+#include <QtCore/QSharedPointer>
+#include <QtCore/private/qglobal_p.h>
+
+#include <array>
+#include <optional>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttSubscription;
+
+#if QT_CONFIG(future)
+// Completion of a request awaited through a QFuture. Like QPromise, a
+// completion which is destroyed before it has been finished cancels the
+// future, so that dropping an inflight entry never leaves it pending.
+class QMqttCompletion
+{
+public:
+    QMqttCompletion() = default;
+    explicit QMqttCompletion(const QFutureInterfaceBase &future) : m_future(future) { }
+    QMqttCompletion(QMqttCompletion &&other) noexcept
+        : m_future(std::exchange(other.m_future, std::nullopt)) { }
+    QMqttCompletion &operator=(QMqttCompletion &&other) noexcept
+    {
+        QMqttCompletion moved(std::move(other));
+        std::swap(m_future, moved.m_future);
+        return *this;
+    }
+    ~QMqttCompletion() { cancel(); }
+
+    inline bool isPending() const { return m_future.has_value(); }
+
+    // T must match the result type of the future passed to the constructor.
+    template<typename T>
+    void finish(const T &result)
+    {
+        if (!m_future)
+            return;
+        QFutureInterface<T> future(*m_future);
+        m_future.reset();
+        future.reportResult(result);
+        future.reportFinished();
+    }
+
+    void cancel()
+    {
+        if (!m_future)
+            return;
+        QFutureInterfaceBase future = std::move(*m_future);
+        m_future.reset();
+        future.reportCanceled();
+        future.reportFinished();
+    }
+
+private:
+    Q_DISABLE_COPY(QMqttCompletion)
+    std::optional<QFutureInterfaceBase> m_future;
+};
+#else
+// Without futures no request can be awaited, completions are never pending.
+class QMqttCompletion
+{
+public:
+    inline bool isPending() const { return false; }
+    template<typename T>
+    void finish(const T &) { }
+    void cancel() { }
+};
+#endif // QT_CONFIG(future)
+
+class Q_AUTOTEST_EXPORT QMqttInflightTable
+{
+public:
+    enum State : quint8 {
+        Free = 0,
+        SubscribeAck,    // SUBSCRIBE sent, waiting for SUBACK
+        UnsubscribeAck,  // UNSUBSCRIBE sent, waiting for UNSUBACK
+        PublishAck,      // PUBLISH sent or queued, waiting for PUBACK or PUBREC
+        PublishComplete, // PUBREL sent, waiting for PUBCOMP
+        StateCount
+    };
+
+    struct Entry
+    {
+        State state{Free};
+        quint64 sequence{0}; // Order in which PUBLISH packets were sent
+        qint64 sentTime{-1}; // When the last PUBLISH or PUBREL was written, see QMqttConnection::elapsed()
+        QMqttSubscription *subscription{nullptr};
+        QSharedPointer<QMqttControlPacket> packet;
+        QByteArray resendHeader; // Variable header without topic alias, if an alias is used
+        QMqttCompletion completion; // Set if the request is awaited through a QFuture
+    };
+
+    QMqttInflightTable();
+    ~QMqttInflightTable();
+
+    quint16 allocate(State state);
+    Entry *insert(quint16 identifier, State state);
+    Entry *find(quint16 identifier, State state);
+    Entry *transition(quint16 identifier, State from, State to);
+    Entry take(quint16 identifier, State state);
+    bool remove(quint16 identifier, State state);
+    void clear();
+
+    inline bool isExhausted() const { return m_identifiers.isExhausted(); }
+    inline bool isEmpty() const { return m_identifiers.count() == 0; }
+    inline int count() const { return m_identifiers.count(); }
+    // Can be called from any thread, see QMqttClient::statistics()
+    inline int count(State state) const { return m_counts[state].loadRelaxed(); }
+
+    // Calls function(quint16 identifier, Entry &entry) for all entries in
+    // state. The table must not be modified by function.
+    template<typename Function>
+    void forEach(State state, Function function)
+    {
+        if (count(state) == 0)
+            return;
+        for (int p = 0; p < PageCount; ++p) {
+            Page *page = m_pages[p];
+            if (!page)
+                continue;
+            for (int i = 0; i < PageSize; ++i) {
+                if (page->entries[i].state == state)
+                    function(quint16(p * PageSize + i), page->entries[i]);
+            }
+        }
+    }
+
+    // Removes all entries in state, calling function(quint16 identifier,
+    // Entry &entry) for each of them before it is removed.
+    template<typename Function>
+    void removeAll(State state, Function function)
+    {
+        for (int p = 0; p < PageCount && count(state) > 0; ++p) {
+            Page *page = m_pages[p];
+            if (!page)
+                continue;
+            for (int i = 0; i < PageSize; ++i) {
+                Entry &entry = page->entries[i];
+                if (entry.state != state)
+                    continue;
+                const quint16 identifier = quint16(p * PageSize + i);
+                function(identifier, entry);
+                release(identifier, page, entry);
+            }
+            if (page->used == 0) {
+                delete page;
+                m_pages[p] = nullptr;
+            }
+        }
+    }
+
+    inline void removeAll(State state) { removeAll(state, [](quint16, Entry &) {}); }
+
+private:
+    Q_DISABLE_COPY(QMqttInflightTable)
+
+    static constexpr int PageSize = 256;
+    static constexpr int PageCount = 65536 / PageSize;
+
+    struct Page
+    {
+        std::array<Entry, PageSize> entries;
+        int used{0};
+    };
+
+    Entry &acquire(quint16 identifier, State state);
+    void release(quint16 identifier, Page *page, Entry &entry);
+    inline void addCount(State state, int delta)
+    {
+        m_counts[state].storeRelaxed(m_counts[state].loadRelaxed() + delta);
+    }
+
+    QMqttPacketIdentifierAllocator m_identifiers;
+    std::array<Page *, PageCount> m_pages{};
+    // Only modified by the owning thread
+    std::array<QAtomicInt, StateCount> m_counts{};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTINFLIGHTTABLE_P_H
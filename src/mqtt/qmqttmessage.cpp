@@ -3,6 +3,7 @@
 
 #include "qmqttmessage.h"
 #include "qmqttmessage_p.h"
+#include "qmqttpublishproperties_p.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -77,6 +78,29 @@ QMqttMessage::QMqttMessage(const QMqttMessage &other)
 {
 }
 
+/*!
+    \fn QMqttMessage::QMqttMessage(QMqttMessage &&other)
+    \since 6.9
+
+    Move-constructs a message from \a other. The moved-from object can only
+    be assigned to or destroyed.
+*/
+
+/*!
+    \fn QMqttMessage &QMqttMessage::operator=(QMqttMessage &&other)
+    \since 6.9
+
+    Move-assigns \a other to this message.
+*/
+
+/*!
+    \fn void QMqttMessage::swap(QMqttMessage &other)
+    \since 6.9
+
+    Swaps this message with \a other. This operation is very fast and never
+    fails.
+*/
+
 QMqttMessage::~QMqttMessage()
 {
 }
@@ -151,7 +175,7 @@ bool QMqttMessage::retain() const
 */
 QMqttPublishProperties QMqttMessage::publishProperties() const
 {
-    return d->m_publishProperties;
+    return d->publishProperties();
 }
 
 /*!
@@ -173,4 +197,18 @@ QMqttMessage::QMqttMessage(const QMqttTopicName &topic, const QByteArray &conten
     d->m_retain = retain;
 }
 
+QMqttPublishProperties QMqttMessagePrivate::publishProperties() const
+{
+    // Copies of a message share this object and might be used from several
+    // threads, so decoding is guarded.
+    if (!m_publishPropertiesDecoded.loadAcquire()) {
+        const QMutexLocker locker(&m_publishPropertiesMutex);
+        if (!m_publishPropertiesDecoded.loadRelaxed()) {
+            m_publishProperties = QMqttPublishPropertyBlock::decode(m_publishPropertyBlock);
+            m_publishPropertiesDecoded.storeRelease(1);
+        }
+    }
+    return *m_publishProperties;
+}
+
 QT_END_NAMESPACE
@@ -28,9 +28,12 @@ class Q_MQTT_EXPORT QMqttMessage
 public:
     QMqttMessage();
     QMqttMessage(const QMqttMessage& other);
+    QMqttMessage(QMqttMessage &&other) noexcept = default;
     ~QMqttMessage();
 
     QMqttMessage& operator=(const QMqttMessage &other);
+    QT_MOVE_ASSIGNMENT_OPERATOR_IMPL_VIA_PURE_SWAP(QMqttMessage)
+    void swap(QMqttMessage &other) noexcept { d.swap(other.d); }
     bool operator==(const QMqttMessage &other) const;
     inline bool operator!=(const QMqttMessage &other) const;
 
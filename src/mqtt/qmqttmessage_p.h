@@ -19,9 +19,12 @@
 #include "qmqtttopicname.h"
 #include "qmqttpublishproperties.h"
 
+#include <QtCore/QMutex>
 #include <QtCore/QSharedData>
 #include <QtCore/private/qglobal_p.h>
 
+#include <optional>
+
 QT_BEGIN_NAMESPACE
 
 class QMqttMessagePrivate : public QSharedData
@@ -41,7 +44,14 @@ public:
     quint8 m_qos{0};
     bool m_duplicate{false};
     bool m_retain{false};
-    QMqttPublishProperties m_publishProperties;
+
+    QMqttPublishProperties publishProperties() const;
+
+    // Property block as received, decoded on first access
+    QByteArray m_publishPropertyBlock;
+    mutable std::optional<QMqttPublishProperties> m_publishProperties;
+    mutable QBasicAtomicInt m_publishPropertiesDecoded = Q_BASIC_ATOMIC_INITIALIZER(0);
+    mutable QBasicMutex m_publishPropertiesMutex;
 };
 
 QT_END_NAMESPACE
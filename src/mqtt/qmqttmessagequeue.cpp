@@ -0,0 +1,161 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqttmessagequeue.h"
+#include "qmqttmessagequeue_p.h"
+
+#include <QtCore/QMetaObject>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttMessageQueue
+
+    \inmodule QtMqtt
+    \since 6.9
+
+    \brief The QMqttMessageQueue class hands received messages over to
+    another thread.
+
+    A QMqttClient handles its transport, parses incoming data and notifies
+    subscriptions in the thread it lives in. To keep slow consumers from
+    stalling the network traffic, the client can be moved to a dedicated
+    thread. QMqttMessageQueue passes the messages of its subscriptions to a
+    consumer living in a different thread.
+
+    The queue lives in the consumer thread. Its handler() is installed as the
+    message handler of one or more subscriptions in the thread of the client.
+    Received messages are stored in a lock-free queue, without posting an event
+    for each of them. The messagesAvailable() signal is emitted in the thread
+    of the queue once messages are waiting, the consumer then fetches all of
+    them with takeMessages().
+
+    \code
+    auto client = new QMqttClient;
+    client->moveToThread(networkThread);
+
+    auto queue = new QMqttMessageQueue(consumer);
+    connect(queue, &QMqttMessageQueue::messagesAvailable, consumer, [queue, consumer]() {
+        for (const QMqttMessage &message : queue->takeMessages())
+            consumer->process(message);
+    });
+
+    // In the network thread, once connected
+    client->subscribe(topic, 1, queue->handler());
+    \endcode
+
+    All subscriptions using the handler of a queue must belong to clients
+    living in the same thread.
+
+    \sa QMqttSubscription::setMessageHandler()
+*/
+
+/*!
+    \fn QMqttMessageQueue::messagesAvailable()
+
+    This signal is emitted when messages have been added to an empty queue.
+    It is not emitted again until takeMessages() has been called.
+*/
+
+void QMqttMessageQueueState::enqueue(const QMqttMessage &message)
+{
+    // Once the ring is full, further messages go to overflow until the
+    // consumer emptied it, to keep their order.
+    QMqttMessage copy(message);
+    if (overflowing.loadAcquire() || !ring.push(std::move(copy))) {
+        const QMutexLocker locker(&mutex);
+        overflow.append(message);
+        overflowing.storeRelease(1);
+    }
+
+    // Sequentially consistent, pairs with the exchange in takeAll(). Either
+    // the consumer sees the message or this thread sees the cleared flag.
+    if (notified.fetchAndStoreOrdered(1) == 0)
+        notify();
+}
+
+QList<QMqttMessage> QMqttMessageQueueState::takeAll()
+{
+    // Messages enqueued from now on trigger a new notification
+    notified.fetchAndStoreOrdered(0);
+
+    QList<QMqttMessage> messages;
+    QMqttMessage message;
+    while (ring.pop(&message))
+        messages.append(std::move(message));
+
+    if (overflowing.loadAcquire()) {
+        const QMutexLocker locker(&mutex);
+        // The producer does not use the ring while overflowing, but it might
+        // have filled it after it has been emptied above.
+        while (ring.pop(&message))
+            messages.append(std::move(message));
+        messages.append(overflow);
+        overflow.clear();
+        overflowing.storeRelease(0);
+    }
+
+    // Do not leave messages behind without a pending notification
+    if ((!ring.isEmpty() || overflowing.loadAcquire()) && notified.testAndSetOrdered(0, 1))
+        notify();
+    return messages;
+}
+
+void QMqttMessageQueueState::notify()
+{
+    const QMutexLocker locker(&mutex);
+    if (receiver) {
+        QMetaObject::invokeMethod(receiver, &QMqttMessageQueue::messagesAvailable,
+                                  Qt::QueuedConnection);
+    }
+}
+
+/*!
+    Creates a new message queue with the specified \a parent.
+*/
+QMqttMessageQueue::QMqttMessageQueue(QObject *parent)
+    : QObject(*(new QMqttMessageQueuePrivate), parent)
+{
+    Q_D(QMqttMessageQueue);
+    d->state.reset(new QMqttMessageQueueState);
+    d->state->receiver = this;
+}
+
+/*!
+    Deletes the queue. Messages passed to its handler afterwards are
+    discarded.
+*/
+QMqttMessageQueue::~QMqttMessageQueue()
+{
+    Q_D(QMqttMessageQueue);
+    const QMutexLocker locker(&d->state->mutex);
+    d->state->receiver = nullptr;
+}
+
+/*!
+    Returns a message handler adding messages to this queue.
+
+    The handler is meant to be passed to QMqttSubscription::setMessageHandler()
+    or QMqttClient::subscribe(). It stays valid after the queue has been
+    deleted.
+*/
+QMqttSubscription::MessageHandler QMqttMessageQueue::handler() const
+{
+    Q_D(const QMqttMessageQueue);
+    QSharedPointer<QMqttMessageQueueState> state = d->state;
+    return [state](const QMqttMessage &message) { state->enqueue(message); };
+}
+
+/*!
+    Removes all messages from the queue and returns them in the order they
+    have been received.
+
+    This function must be called from the thread the queue lives in.
+*/
+QList<QMqttMessage> QMqttMessageQueue::takeMessages()
+{
+    Q_D(QMqttMessageQueue);
+    return d->state->takeAll();
+}
+
+QT_END_NAMESPACE
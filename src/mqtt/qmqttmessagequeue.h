@@ -0,0 +1,38 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTMESSAGEQUEUE_H
+#define QMQTTMESSAGEQUEUE_H
+
+#include <QtMqtt/qmqttglobal.h>
+#include <QtMqtt/qmqttmessage.h>
+#include <QtMqtt/qmqttsubscription.h>
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttMessageQueuePrivate;
+
+class Q_MQTT_EXPORT QMqttMessageQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QMqttMessageQueue(QObject *parent = nullptr);
+    ~QMqttMessageQueue() override;
+
+    QMqttSubscription::MessageHandler handler() const;
+    QList<QMqttMessage> takeMessages();
+
+Q_SIGNALS:
+    void messagesAvailable();
+
+private:
+    Q_DECLARE_PRIVATE(QMqttMessageQueue)
+    Q_DISABLE_COPY(QMqttMessageQueue)
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTMESSAGEQUEUE_H
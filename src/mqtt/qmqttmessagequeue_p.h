@@ -0,0 +1,55 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTMESSAGEQUEUE_P_H
+#define QMQTTMESSAGEQUEUE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttmessagequeue.h"
+#include "qmqttspscqueue_p.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+#include <QtCore/private/qobject_p.h>
+
+QT_BEGIN_NAMESPACE
+
+// State shared between a queue and the handlers it handed out, which might
+// outlive it.
+class QMqttMessageQueueState
+{
+public:
+    static constexpr quint32 Capacity = 1024;
+
+    void enqueue(const QMqttMessage &message); // Producer thread
+    QList<QMqttMessage> takeAll(); // Consumer thread
+    void notify(); // Emits messagesAvailable() in the thread of receiver
+
+    QMqttSpscQueue<QMqttMessage> ring{Capacity};
+    QAtomicInt overflowing{0}; // Set while messages are in overflow
+    QAtomicInt notified{0}; // Set while a notification is pending
+    QMutex mutex; // Guards overflow and receiver
+    QList<QMqttMessage> overflow; // Messages not fitting into ring
+    QMqttMessageQueue *receiver{nullptr};
+};
+
+class QMqttMessageQueuePrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QMqttMessageQueue)
+public:
+    QSharedPointer<QMqttMessageQueueState> state;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTMESSAGEQUEUE_P_H
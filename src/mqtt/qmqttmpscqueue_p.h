@@ -0,0 +1,155 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTMPSCQUEUE_P_H
+#define QMQTTMPSCQUEUE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttglobal.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/private/qglobal_p.h>
+
+#include <memory>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+// Queue for any number of producer threads and exactly one consumer thread.
+// Values are passed through a bounded lock-free ring. Once it is full, push()
+// falls back to a list guarded by a mutex and keeps using it until the
+// consumer emptied it, so that the values of each producer stay in order.
+// push() may be called from any thread, drain() only by the
+// consumer.
+template<typename T>
+class QMqttMpscQueue
+{
+public:
+    explicit QMqttMpscQueue(quint32 capacity)
+    {
+        Q_ASSERT(capacity > 1 && capacity <= (1u << 30));
+        quint32 size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_cells.reset(new Cell[size]);
+        for (quint32 i = 0; i < size; ++i)
+            m_cells[i].sequence.storeRelaxed(i);
+        m_mask = size - 1;
+    }
+
+    inline quint32 capacity() const { return m_mask + 1; }
+
+    // Consumer only. A value being pushed concurrently might not be visible
+    // yet, its producer has to notify the consumer afterwards.
+    bool isEmpty() const
+    {
+        const Cell &cell = m_cells[m_head & m_mask];
+        return qint32(cell.sequence.loadAcquire() - (m_head + 1)) < 0
+                && !m_overflowing.loadAcquire();
+    }
+
+    void push(T &&value)
+    {
+        if (m_overflowing.loadAcquire() || !tryPush(value)) {
+            const QMutexLocker locker(&m_mutex);
+            m_overflow.append(std::move(value));
+            m_overflowing.storeRelease(1);
+        }
+    }
+
+    // Calls function for each queued value, in the order they were pushed
+    // by each producer.
+    template<typename Function>
+    void drain(Function function)
+    {
+        T value;
+        while (pop(&value))
+            function(std::move(value));
+
+        if (!m_overflowing.loadAcquire())
+            return;
+
+        QList<T> overflow;
+        {
+            const QMutexLocker locker(&m_mutex);
+            // Producers skip the ring while overflowing, values found in it
+            // now have been pushed before the overflow started.
+            while (pop(&value))
+                function(std::move(value));
+            overflow.swap(m_overflow);
+            m_overflowing.storeRelease(0);
+        }
+        for (T &v : overflow)
+            function(std::move(v));
+    }
+
+private:
+    Q_DISABLE_COPY(QMqttMpscQueue)
+
+    // Each cell carries a sequence number telling whether it can be written
+    // for a given tail index (sequence == index) or read for a given head
+    // index (sequence == index + 1).
+    struct Cell
+    {
+        QAtomicInteger<quint32> sequence;
+        T value;
+    };
+
+    bool tryPush(T &value)
+    {
+        quint32 tail = m_tail.loadRelaxed();
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[tail & m_mask];
+            const qint32 diff = qint32(cell->sequence.loadAcquire() - tail);
+            if (diff == 0) {
+                if (m_tail.testAndSetRelaxed(tail, tail + 1, tail))
+                    break;
+            } else if (diff < 0) {
+                return false; // Full
+            } else {
+                tail = m_tail.loadRelaxed();
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.storeRelease(tail + 1);
+        return true;
+    }
+
+    bool pop(T *value)
+    {
+        Cell &cell = m_cells[m_head & m_mask];
+        if (qint32(cell.sequence.loadAcquire() - (m_head + 1)) < 0)
+            return false;
+        // Do not keep data referenced by the slot
+        *value = std::exchange(cell.value, T());
+        cell.sequence.storeRelease(m_head + m_mask + 1);
+        ++m_head;
+        return true;
+    }
+
+    std::unique_ptr<Cell[]> m_cells;
+    quint32 m_mask{0};
+    // Only used by the consumer
+    quint32 m_head{0};
+    alignas(64) QAtomicInteger<quint32> m_tail{0};
+    alignas(64) QAtomicInt m_overflowing{0};
+    QMutex m_mutex;
+    QList<T> m_overflow;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTMPSCQUEUE_P_H
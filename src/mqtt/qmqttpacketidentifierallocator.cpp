@@ -0,0 +1,91 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqttpacketidentifierallocator_p.h"
+
+#include <QtCore/qalgorithms.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttPacketIdentifierAllocator
+    \internal
+
+    \brief The QMqttPacketIdentifierAllocator class hands out the packet
+    identifiers of a connection.
+
+    Allocated identifiers are tracked in a bitmap covering the whole 16-bit
+    range. Identifiers are handed out in increasing order, starting after the
+    most recently allocated one. Finding the next free identifier inspects 64
+    identifiers at once, hence it only needs to visit more than one word of
+    the bitmap when almost all identifiers are in use.
+*/
+
+QMqttPacketIdentifierAllocator::QMqttPacketIdentifierAllocator()
+{
+    clear();
+}
+
+/*!
+    Returns an unused packet identifier and marks it as allocated. Returns
+    \c 0 if all identifiers are allocated.
+*/
+quint16 QMqttPacketIdentifierAllocator::allocate()
+{
+    if (isExhausted())
+        return 0;
+
+    int index = m_next >> 6;
+    // Skip the identifiers below m_next in the first word
+    quint64 available = ~m_words[index] & (~Q_UINT64_C(0) << (m_next & 63));
+    for (int i = 0; available == 0 && i < WordCount; ++i) {
+        index = (index + 1) % WordCount;
+        available = ~m_words[index];
+    }
+    Q_ASSERT(available != 0);
+
+    const int bit = qCountTrailingZeroBits(available);
+    m_words[index] |= Q_UINT64_C(1) << bit;
+    ++m_count;
+
+    const quint16 identifier = quint16(index * 64 + bit);
+    m_next = identifier + 1;
+    if (m_next == 0)
+        m_next = 1;
+    return identifier;
+}
+
+/*!
+    Marks \a identifier as allocated, for instance when restoring a session.
+    Returns \c false if \a identifier is invalid or already allocated.
+*/
+bool QMqttPacketIdentifierAllocator::reserve(quint16 identifier)
+{
+    if (identifier == 0 || isAllocated(identifier))
+        return false;
+    m_words[identifier >> 6] |= Q_UINT64_C(1) << (identifier & 63);
+    ++m_count;
+    return true;
+}
+
+/*!
+    Makes \a identifier available for allocation again.
+*/
+void QMqttPacketIdentifierAllocator::release(quint16 identifier)
+{
+    if (!isAllocated(identifier))
+        return;
+    m_words[identifier >> 6] &= ~(Q_UINT64_C(1) << (identifier & 63));
+    --m_count;
+}
+
+void QMqttPacketIdentifierAllocator::clear()
+{
+    m_words.fill(0);
+    // 0 is not a valid identifier, it is never handed out
+    m_words[0] = 1;
+    m_next = 1;
+    m_count = 0;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,55 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTPACKETIDENTIFIERALLOCATOR_P_H
+#define QMQTTPACKETIDENTIFIERALLOCATOR_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttglobal.h"
+
+#include <QtCore/private/qglobal_p.h>
+
+#include <array>
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QMqttPacketIdentifierAllocator
+{
+public:
+    QMqttPacketIdentifierAllocator();
+
+    quint16 allocate();
+    bool reserve(quint16 identifier);
+    void release(quint16 identifier);
+    void clear();
+
+    inline bool isAllocated(quint16 identifier) const
+    {
+        return identifier != 0 && (m_words[identifier >> 6] & (Q_UINT64_C(1) << (identifier & 63)));
+    }
+    inline bool isExhausted() const { return m_count == MaximumCount; }
+    inline int count() const { return m_count; }
+
+private:
+    // MQTT-2.3.1-1 Packet identifiers are non-zero 16-bit values
+    static constexpr int MaximumCount = 65535;
+    static constexpr int WordCount = 65536 / 64;
+
+    std::array<quint64, WordCount> m_words;
+    quint16 m_next{1};
+    int m_count{0};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTPACKETIDENTIFIERALLOCATOR_P_H
@@ -6,6 +6,7 @@
 #include "qmqtttype.h"
 
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QtEndian>
 
 QT_BEGIN_NAMESPACE
 
@@ -205,6 +206,11 @@ void QMqttPublishProperties::setUserProperties(const QMqttUserProperties &proper
 /*!
     Returns the subscription identifiers of subscriptions matching
     the topic filter of the message.
+
+    Since Qt 6.9, this includes the identifiers which QMqttClient assigns to
+    subscriptions created without a subscription identifier.
+
+    \sa QMqttClient::subscribe()
 */
 QList<quint32> QMqttPublishProperties::subscriptionIdentifiers() const
 {
@@ -298,4 +304,192 @@ QMqttUserProperties QMqttMessageStatusProperties::userProperties() const
 QMqttMessageStatusProperties::~QMqttMessageStatusProperties() = default;
 QMqttMessageStatusProperties::QMqttMessageStatusProperties(const QMqttMessageStatusProperties &) = default;
 
+namespace {
+
+class PropertyReader
+{
+public:
+    explicit PropertyReader(QByteArrayView data) : m_data(data) { }
+
+    bool atEnd() const { return m_position == m_data.size(); }
+
+    template<typename T>
+    bool read(T *value)
+    {
+        if (m_data.size() - m_position < qsizetype(sizeof(T)))
+            return false;
+        *value = qFromBigEndian<T>(m_data.data() + m_position);
+        m_position += sizeof(T);
+        return true;
+    }
+
+    bool readVariableByteInteger(quint32 *value)
+    {
+        quint32 result = 0;
+        for (int i = 0; i < 4; ++i) {
+            quint8 b = 0;
+            if (!read(&b))
+                return false;
+            result |= quint32(b & 127) << (7 * i);
+            if ((b & 128) == 0) {
+                *value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readBinary(QByteArrayView *value)
+    {
+        quint16 size = 0;
+        if (!read(&size) || m_data.size() - m_position < size)
+            return false;
+        *value = m_data.sliced(m_position, size);
+        m_position += size;
+        return true;
+    }
+
+private:
+    QByteArrayView m_data;
+    qsizetype m_position{0};
+};
+
+// Walks all properties in block and fills summary. If properties is not null,
+// all values are stored in it as well.
+bool parsePublishProperties(QByteArrayView block, QMqttPublishPropertyBlock::Summary *summary,
+                            QMqttPublishProperties *properties)
+{
+    PropertyReader reader(block);
+    QMqttUserProperties userProperties;
+
+    while (!reader.atEnd()) {
+        quint8 propertyId = 0;
+        reader.read(&propertyId);
+        switch (propertyId) {
+        case 0x01: { // 3.3.2.3.2 Payload Format Indicator
+            quint8 format = 0;
+            if (!reader.read(&format))
+                return false;
+            summary->details |= QMqttPublishProperties::PayloadFormatIndicator;
+            if (properties && format == 1)
+                properties->setPayloadFormatIndicator(QMqtt::PayloadFormatIndicator::UTF8Encoded);
+            break;
+        }
+        case 0x02: { // 3.3.2.3.3 Message Expiry Interval
+            quint32 interval = 0;
+            if (!reader.read(&interval))
+                return false;
+            summary->details |= QMqttPublishProperties::MessageExpiryInterval;
+            if (properties)
+                properties->setMessageExpiryInterval(interval);
+            break;
+        }
+        case 0x23: { // 3.3.2.3.4 Topic alias
+            if (!reader.read(&summary->topicAlias))
+                return false;
+            summary->details |= QMqttPublishProperties::TopicAlias;
+            if (properties)
+                properties->setTopicAlias(summary->topicAlias);
+            break;
+        }
+        case 0x08: { // 3.3.2.3.5 Response Topic
+            QByteArrayView responseTopic;
+            if (!reader.readBinary(&responseTopic))
+                return false;
+            summary->details |= QMqttPublishProperties::ResponseTopic;
+            if (properties)
+                properties->setResponseTopic(QString::fromUtf8(responseTopic));
+            break;
+        }
+        case 0x09: { // 3.3.2.3.6 Correlation Data
+            QByteArrayView data;
+            if (!reader.readBinary(&data))
+                return false;
+            summary->details |= QMqttPublishProperties::CorrelationData;
+            if (properties)
+                properties->setCorrelationData(data.toByteArray());
+            break;
+        }
+        case 0x26: { // 3.3.2.3.7 User property
+            QByteArrayView propertyName;
+            QByteArrayView propertyValue;
+            if (!reader.readBinary(&propertyName) || !reader.readBinary(&propertyValue))
+                return false;
+            summary->details |= QMqttPublishProperties::UserProperty;
+            if (properties) {
+                userProperties.append(QMqttStringPair(QString::fromUtf8(propertyName),
+                                                      QString::fromUtf8(propertyValue)));
+            }
+            break;
+        }
+        case 0x0b: { // 3.3.2.3.8 Subscription Identifier
+            quint32 id = 0;
+            if (!reader.readVariableByteInteger(&id))
+                return false;
+            summary->details |= QMqttPublishProperties::SubscriptionIdentifier;
+            summary->subscriptionIdentifiers.append(id);
+            break;
+        }
+        case 0x03: { // 3.3.2.3.9 Content Type
+            QByteArrayView content;
+            if (!reader.readBinary(&content))
+                return false;
+            summary->details |= QMqttPublishProperties::ContentType;
+            if (properties)
+                properties->setContentType(QString::fromUtf8(content));
+            break;
+        }
+        default:
+            qCDebug(lcMqttClient) << "Unknown publish property received:" << propertyId;
+            return false;
+        }
+    }
+
+    if (properties) {
+        if (!userProperties.isEmpty())
+            properties->setUserProperties(userProperties);
+        if (!summary->subscriptionIdentifiers.isEmpty()) {
+            properties->setSubscriptionIdentifiers(
+                    QList<quint32>(summary->subscriptionIdentifiers.cbegin(),
+                                   summary->subscriptionIdentifiers.cend()));
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+/*!
+    \class QMqttPublishPropertyBlock
+    \internal
+
+    \brief The QMqttPublishPropertyBlock class parses the properties of a
+    received PUBLISH packet.
+
+    Received messages keep the encoded property block and only decode it
+    when the properties are requested via QMqttMessage::publishProperties().
+*/
+
+/*!
+    Checks that \a block is well-formed without decoding it. Stores the
+    properties contained, the topic alias and the subscription identifiers in
+    \a summary. Returns \c false if \a block is malformed.
+*/
+bool QMqttPublishPropertyBlock::validate(QByteArrayView block, Summary *summary)
+{
+    *summary = Summary();
+    return parsePublishProperties(block, summary, nullptr);
+}
+
+/*!
+    Decodes all properties of \a block. \a block must have passed validate().
+*/
+QMqttPublishProperties QMqttPublishPropertyBlock::decode(QByteArrayView block)
+{
+    QMqttPublishProperties properties;
+    Summary summary;
+    parsePublishProperties(block, &summary, &properties);
+    return properties;
+}
+
 QT_END_NAMESPACE
@@ -18,7 +18,9 @@
 #include "qmqttglobal.h"
 #include "qmqttpublishproperties.h"
 
+#include <QtCore/QByteArrayView>
 #include <QtCore/QSharedData>
+#include <QtCore/QVarLengthArray>
 #include <QtCore/private/qglobal_p.h>
 
 QT_BEGIN_NAMESPACE
@@ -45,6 +47,22 @@ public:
     QMqtt::ReasonCode reasonCode{QMqtt::ReasonCode::Success};
 };
 
+// Parses the property block of a received PUBLISH packet
+class Q_AUTOTEST_EXPORT QMqttPublishPropertyBlock
+{
+public:
+    // The properties needed to route a message, available without decoding
+    struct Summary
+    {
+        QMqttPublishProperties::PublishPropertyDetails details;
+        quint16 topicAlias{0};
+        QVarLengthArray<quint32, 4> subscriptionIdentifiers;
+    };
+
+    static bool validate(QByteArrayView block, Summary *summary);
+    static QMqttPublishProperties decode(QByteArrayView block);
+};
+
 QT_END_NAMESPACE
 
 #endif // QMQTTPUBLISHPROPERTIES_P_H
@@ -0,0 +1,469 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqttsessionstore.h"
+#include "qmqttsessionstore_p.h"
+
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtEndian>
+#include <QtCore/private/qabstractfileengine_p.h>
+#include <QtCore/private/qfiledevice_p.h>
+
+#include <algorithm>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttSessionStore
+
+    \inmodule QtMqtt
+    \since 6.9
+
+    \brief The QMqttSessionStore class is the interface for persisting
+    outbound messages of a session.
+
+    Messages published with a QoS level of 1 or 2 need to be resent if the
+    connection is lost before the server acknowledged them. QMqttClient keeps
+    these messages in memory. A session store additionally persists them, so
+    that they survive a restart of the application.
+
+    QMqttClient calls storeMessage() before a message is sent for the first
+    time, and sync() before the message is written to the transport. When
+    the server acknowledges the message, removeMessage() is called. For a
+    message of QoS level 2, releaseMessage() is called when the server
+    confirmed its reception.
+
+    When a session store is set with QMqttClient::setSessionStore(), the
+    client calls load() to restore the messages which have not been
+    acknowledged previously. These messages are resent when the client
+    connects and the server resumes the session.
+
+    \sa QMqttFileSessionStore, QMqttClient::setSessionStore()
+*/
+
+/*!
+    \class QMqttSessionStore::Message
+    \inmodule QtMqtt
+    \since 6.9
+
+    \brief The Message struct describes a message restored from a session
+    store.
+
+    \variable QMqttSessionStore::Message::packetIdentifier
+    \brief The packet identifier of the message.
+
+    \variable QMqttSessionStore::Message::released
+    \brief Whether the server confirmed the reception of a QoS 2 message.
+
+    \variable QMqttSessionStore::Message::packet
+    \brief The serialized PUBLISH packet.
+*/
+
+/*!
+    \fn QList<QMqttSessionStore::Message> QMqttSessionStore::load()
+
+    Returns all messages stored in the session store, in the order in which
+    they have been stored.
+*/
+
+/*!
+    \fn void QMqttSessionStore::storeMessage(quint16 packetIdentifier, const QByteArray &packet)
+
+    Stores the serialized PUBLISH \a packet using \a packetIdentifier. A
+    message previously stored with the same identifier is replaced.
+*/
+
+/*!
+    \fn void QMqttSessionStore::releaseMessage(quint16 packetIdentifier)
+
+    Marks the message with \a packetIdentifier as received by the server.
+*/
+
+/*!
+    \fn void QMqttSessionStore::removeMessage(quint16 packetIdentifier)
+
+    Removes the message with \a packetIdentifier from the session store.
+*/
+
+/*!
+    \fn void QMqttSessionStore::clear()
+
+    Removes all messages from the session store.
+*/
+
+/*!
+    \fn bool QMqttSessionStore::sync()
+
+    Makes all changes durable. Implementations may defer writing changes
+    until this function is called.
+
+    Returns \c true on success.
+*/
+
+/*!
+    Creates a new session store.
+*/
+QMqttSessionStore::QMqttSessionStore()
+{
+}
+
+/*!
+    Destroys the session store.
+*/
+QMqttSessionStore::~QMqttSessionStore()
+{
+}
+
+/*!
+    \class QMqttFileSessionStore
+
+    \inmodule QtMqtt
+    \since 6.9
+
+    \brief The QMqttFileSessionStore class persists outbound messages of a
+    session in a file.
+
+    The file is an append-only log. Changes are appended to the file and are
+    only flushed to the disk by sync(). Hence, storing multiple messages
+    before the client writes to the transport requires a single flush.
+
+    sync() only flushes the file if messages have been stored since the
+    last flush. Removed and released messages are flushed along with the
+    next stored message, or when the session store is destroyed. After a
+    crash, such messages might be resent, which the server needs to handle
+    for any message which has not been acknowledged yet.
+
+    When loading, the file is memory-mapped and replayed. An incomplete
+    record at the end of the file, for instance caused by a crash while
+    writing, is discarded.
+
+    Once the log mainly consists of records of removed messages, it is
+    compacted by atomically replacing it with a file containing only the
+    remaining messages.
+*/
+
+static const char sessionStoreMagic[] = { 'Q', 'M', 'Q', 'T', 'T', 'S', 'S', 0x01 };
+static constexpr qint64 sessionStoreMagicSize = sizeof(sessionStoreMagic);
+// type (1), packet identifier (2), data length (4)
+static constexpr qint64 recordHeaderSize = 7;
+static constexpr qint64 recordChecksumSize = 2;
+static constexpr qsizetype compactionThreshold = 1024;
+
+static QByteArray serializeRecord(QMqttFileSessionStorePrivate::RecordType type,
+                                  quint16 packetIdentifier, const QByteArray &data)
+{
+    QByteArray record;
+    record.resize(recordHeaderSize);
+    record.reserve(recordHeaderSize + data.size() + recordChecksumSize);
+    record[0] = char(type);
+    qToBigEndian<quint16>(packetIdentifier, record.data() + 1);
+    qToBigEndian<quint32>(quint32(data.size()), record.data() + 3);
+    record.append(data);
+
+    char checksum[recordChecksumSize];
+    qToBigEndian<quint16>(qChecksum(record), checksum);
+    record.append(checksum, recordChecksumSize);
+    return record;
+}
+
+bool QMqttFileSessionStorePrivate::ensureOpen()
+{
+    if (file.isOpen())
+        return true;
+
+    if (!file.open(QIODevice::ReadWrite)) {
+        qCWarning(lcMqttClient) << "Could not open session store" << file.fileName()
+                                << ":" << file.errorString();
+        return false;
+    }
+
+    entries.clear();
+    sequence = 0;
+    deadRecords = 0;
+
+    const qint64 size = file.size();
+    qint64 validSize = 0;
+    if (size >= sessionStoreMagicSize) {
+        QByteArray content;
+        const uchar *data = file.map(0, size);
+        if (!data) {
+            content = file.readAll();
+            data = reinterpret_cast<const uchar *>(content.constData());
+        }
+        if (memcmp(data, sessionStoreMagic, sessionStoreMagicSize) == 0)
+            validSize = sessionStoreMagicSize + replay(data + sessionStoreMagicSize,
+                                                       size - sessionStoreMagicSize);
+        else
+            qCWarning(lcMqttClient) << "Ignoring invalid session store" << file.fileName();
+        if (content.isNull())
+            file.unmap(const_cast<uchar *>(data));
+    }
+
+    if (validSize < sessionStoreMagicSize) {
+        file.resize(0);
+        file.write(sessionStoreMagic, sessionStoreMagicSize);
+        dirty = true;
+    } else if (validSize < size) {
+        qCWarning(lcMqttClient) << "Discarding incomplete record at the end of session store"
+                                << file.fileName();
+        file.resize(validSize);
+        dirty = true;
+    }
+    file.seek(file.size());
+    return true;
+}
+
+/*!
+    \internal
+    Applies the records in \a data of \a size bytes and returns the number of
+    bytes which have been applied. Replaying stops at the first incomplete or
+    corrupt record.
+*/
+qint64 QMqttFileSessionStorePrivate::replay(const uchar *data, qint64 size)
+{
+    qint64 offset = 0;
+    while (size - offset >= recordHeaderSize + recordChecksumSize) {
+        const uchar *record = data + offset;
+        const quint16 packetIdentifier = qFromBigEndian<quint16>(record + 1);
+        const quint32 length = qFromBigEndian<quint32>(record + 3);
+        if (size - offset < recordHeaderSize + qint64(length) + recordChecksumSize)
+            break;
+        const quint16 checksum = qFromBigEndian<quint16>(record + recordHeaderSize + length);
+        if (checksum != qChecksum(QByteArrayView(record, recordHeaderSize + length)))
+            break;
+
+        switch (record[0]) {
+        case StoreRecord: {
+            const auto it = entries.constFind(packetIdentifier);
+            if (it != entries.cend())
+                deadRecords += it->released ? 2 : 1;
+            const QByteArray packet(reinterpret_cast<const char *>(record + recordHeaderSize),
+                                    qsizetype(length));
+            entries.insert(packetIdentifier, Entry{++sequence, false, packet});
+            break;
+        }
+        case ReleaseRecord: {
+            const auto it = entries.find(packetIdentifier);
+            if (it != entries.end())
+                it->released = true;
+            break;
+        }
+        case RemoveRecord: {
+            const auto it = entries.constFind(packetIdentifier);
+            if (it != entries.cend()) {
+                deadRecords += it->released ? 3 : 2;
+                entries.erase(it);
+            }
+            break;
+        }
+        default:
+            return offset;
+        }
+        offset += recordHeaderSize + length + recordChecksumSize;
+    }
+    return offset;
+}
+
+void QMqttFileSessionStorePrivate::appendRecord(RecordType type, quint16 packetIdentifier,
+                                                const QByteArray &data)
+{
+    if (!ensureOpen())
+        return;
+    if (file.write(serializeRecord(type, packetIdentifier, data)) == -1)
+        qCWarning(lcMqttClient) << "Could not write to session store" << file.fileName();
+    dirty = true;
+    if (type == StoreRecord)
+        unsyncedStores = true;
+}
+
+bool QMqttFileSessionStorePrivate::syncToDisk()
+{
+    if (!dirty)
+        return true;
+
+    if (!file.flush())
+        return false;
+    // QFile has no public API to sync to the storage device. The file engine
+    // provides it for all platforms (fsync(), FlushFileBuffers()), instead of
+    // duplicating the platform specific calls on handle() here.
+    auto fileDevice = static_cast<QFileDevicePrivate *>(QObjectPrivate::get(&file));
+    QAbstractFileEngine *engine = fileDevice->engine();
+    if (!engine || !engine->syncToDisk()) {
+        qCWarning(lcMqttClient) << "Could not sync session store" << file.fileName();
+        return false;
+    }
+    dirty = false;
+    unsyncedStores = false;
+
+    if (deadRecords > compactionThreshold && deadRecords > 2 * entries.size())
+        compact();
+    return true;
+}
+
+/*!
+    \internal
+    Replaces the log by a log containing only the records of the stored
+    messages.
+*/
+bool QMqttFileSessionStorePrivate::compact()
+{
+    QSaveFile compacted(file.fileName());
+    if (!compacted.open(QIODevice::WriteOnly))
+        return false;
+
+    compacted.write(sessionStoreMagic, sessionStoreMagicSize);
+    const QList<QMqttSessionStore::Message> stored = messages();
+    for (const QMqttSessionStore::Message &message : stored) {
+        compacted.write(serializeRecord(StoreRecord, message.packetIdentifier, message.packet));
+        if (message.released)
+            compacted.write(serializeRecord(ReleaseRecord, message.packetIdentifier, QByteArray()));
+    }
+
+    // The file needs to be closed to be replaced on all platforms.
+    file.close();
+    const bool committed = compacted.commit();
+    if (!committed)
+        qCWarning(lcMqttClient) << "Could not compact session store" << file.fileName();
+    else
+        deadRecords = 0;
+
+    if (!file.open(QIODevice::ReadWrite)) {
+        qCWarning(lcMqttClient) << "Could not reopen session store" << file.fileName();
+        return false;
+    }
+    file.seek(file.size());
+    return committed;
+}
+
+QList<QMqttSessionStore::Message> QMqttFileSessionStorePrivate::messages() const
+{
+    QList<std::pair<quint64, QMqttSessionStore::Message>> ordered;
+    ordered.reserve(entries.size());
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+        ordered.append({it->sequence, QMqttSessionStore::Message{it.key(), it->released, it->packet}});
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    QList<QMqttSessionStore::Message> result;
+    result.reserve(ordered.size());
+    for (const auto &entry : std::as_const(ordered))
+        result.append(entry.second);
+    return result;
+}
+
+/*!
+    Creates a session store using the file \a fileName. The file is created
+    if it does not exist.
+*/
+QMqttFileSessionStore::QMqttFileSessionStore(const QString &fileName)
+    : d_ptr(new QMqttFileSessionStorePrivate)
+{
+    Q_D(QMqttFileSessionStore);
+    d->file.setFileName(fileName);
+}
+
+/*!
+    Destroys the session store after syncing pending changes.
+*/
+QMqttFileSessionStore::~QMqttFileSessionStore()
+{
+    Q_D(QMqttFileSessionStore);
+    if (d->file.isOpen())
+        d->syncToDisk();
+}
+
+/*!
+    Returns the name of the file used by the session store.
+*/
+QString QMqttFileSessionStore::fileName() const
+{
+    Q_D(const QMqttFileSessionStore);
+    return d->file.fileName();
+}
+
+/*!
+    \reimp
+*/
+QList<QMqttSessionStore::Message> QMqttFileSessionStore::load()
+{
+    Q_D(QMqttFileSessionStore);
+    if (!d->ensureOpen())
+        return {};
+    return d->messages();
+}
+
+/*!
+    \reimp
+*/
+void QMqttFileSessionStore::storeMessage(quint16 packetIdentifier, const QByteArray &packet)
+{
+    Q_D(QMqttFileSessionStore);
+    if (!d->ensureOpen())
+        return;
+
+    const auto it = d->entries.constFind(packetIdentifier);
+    if (it != d->entries.cend())
+        d->deadRecords += it->released ? 2 : 1;
+    d->entries.insert(packetIdentifier, QMqttFileSessionStorePrivate::Entry{++d->sequence, false, packet});
+    d->appendRecord(QMqttFileSessionStorePrivate::StoreRecord, packetIdentifier, packet);
+}
+
+/*!
+    \reimp
+*/
+void QMqttFileSessionStore::releaseMessage(quint16 packetIdentifier)
+{
+    Q_D(QMqttFileSessionStore);
+    const auto it = d->entries.find(packetIdentifier);
+    if (it == d->entries.end() || it->released)
+        return;
+    it->released = true;
+    d->appendRecord(QMqttFileSessionStorePrivate::ReleaseRecord, packetIdentifier);
+}
+
+/*!
+    \reimp
+*/
+void QMqttFileSessionStore::removeMessage(quint16 packetIdentifier)
+{
+    Q_D(QMqttFileSessionStore);
+    const auto it = d->entries.constFind(packetIdentifier);
+    if (it == d->entries.cend())
+        return;
+    d->deadRecords += it->released ? 3 : 2;
+    d->entries.erase(it);
+    d->appendRecord(QMqttFileSessionStorePrivate::RemoveRecord, packetIdentifier);
+}
+
+/*!
+    \reimp
+*/
+void QMqttFileSessionStore::clear()
+{
+    Q_D(QMqttFileSessionStore);
+    if (!d->ensureOpen())
+        return;
+    d->entries.clear();
+    d->deadRecords = 0;
+    d->file.resize(sessionStoreMagicSize);
+    d->file.seek(sessionStoreMagicSize);
+    d->dirty = true;
+}
+
+/*!
+    \reimp
+*/
+bool QMqttFileSessionStore::sync()
+{
+    Q_D(QMqttFileSessionStore);
+    // Only stored messages need to be durable before they are sent. Other
+    // changes are synced along with them, or when the store is destroyed.
+    if (!d->file.isOpen() || !d->unsyncedStores)
+        return true;
+    return d->syncToDisk();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,67 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTSESSIONSTORE_H
+#define QMQTTSESSIONSTORE_H
+
+#include <QtMqtt/qmqttglobal.h>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QString>
+
+QT_BEGIN_NAMESPACE
+
+class Q_MQTT_EXPORT QMqttSessionStore
+{
+public:
+    struct Message
+    {
+        quint16 packetIdentifier{0};
+        bool released{false};
+        QByteArray packet;
+    };
+
+    virtual ~QMqttSessionStore();
+
+    virtual QList<Message> load() = 0;
+    virtual void storeMessage(quint16 packetIdentifier, const QByteArray &packet) = 0;
+    virtual void releaseMessage(quint16 packetIdentifier) = 0;
+    virtual void removeMessage(quint16 packetIdentifier) = 0;
+    virtual void clear() = 0;
+    virtual bool sync() = 0;
+
+protected:
+    QMqttSessionStore();
+
+private:
+    Q_DISABLE_COPY(QMqttSessionStore)
+};
+
+class QMqttFileSessionStorePrivate;
+
+class Q_MQTT_EXPORT QMqttFileSessionStore : public QMqttSessionStore
+{
+public:
+    explicit QMqttFileSessionStore(const QString &fileName);
+    ~QMqttFileSessionStore() override;
+
+    QString fileName() const;
+
+    QList<Message> load() override;
+    void storeMessage(quint16 packetIdentifier, const QByteArray &packet) override;
+    void releaseMessage(quint16 packetIdentifier) override;
+    void removeMessage(quint16 packetIdentifier) override;
+    void clear() override;
+    bool sync() override;
+
+private:
+    Q_DISABLE_COPY(QMqttFileSessionStore)
+    Q_DECLARE_PRIVATE(QMqttFileSessionStore)
+    QScopedPointer<QMqttFileSessionStorePrivate> d_ptr;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTSESSIONSTORE_H
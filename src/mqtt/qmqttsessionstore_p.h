@@ -0,0 +1,60 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTSESSIONSTORE_P_H
+#define QMQTTSESSIONSTORE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttsessionstore.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttFileSessionStorePrivate
+{
+public:
+    enum RecordType : quint8 {
+        StoreRecord = 1,
+        ReleaseRecord = 2,
+        RemoveRecord = 3
+    };
+
+    struct Entry
+    {
+        quint64 sequence{0};
+        bool released{false};
+        QByteArray packet;
+    };
+
+    bool ensureOpen();
+    qint64 replay(const uchar *data, qint64 size);
+    void appendRecord(RecordType type, quint16 packetIdentifier,
+                      const QByteArray &data = QByteArray());
+    bool syncToDisk();
+    bool compact();
+    QList<QMqttSessionStore::Message> messages() const;
+
+    QFile file;
+    QHash<quint16, Entry> entries;
+    quint64 sequence{0};
+    qsizetype deadRecords{0};
+    bool dirty{false}; // Any change not synced to disk
+    bool unsyncedStores{false}; // Store records not synced to disk
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTSESSIONSTORE_P_H
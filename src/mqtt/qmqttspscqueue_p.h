@@ -0,0 +1,86 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTSPSCQUEUE_P_H
+#define QMQTTSPSCQUEUE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttglobal.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/private/qglobal_p.h>
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. push() must only be called by the producer, pop() only by the
+// consumer.
+template<typename T>
+class QMqttSpscQueue
+{
+public:
+    explicit QMqttSpscQueue(quint32 capacity)
+    {
+        Q_ASSERT(capacity > 0 && capacity <= (1u << 31));
+        quint32 size = 1;
+        while (size < capacity)
+            size <<= 1;
+        m_slots.reset(new T[size]);
+        m_mask = size - 1;
+    }
+
+    inline quint32 capacity() const { return m_mask + 1; }
+
+    // Returns false if the queue is full, value is left untouched then.
+    bool push(T &&value)
+    {
+        const quint32 tail = m_tail.loadRelaxed();
+        if (tail - m_head.loadAcquire() > m_mask)
+            return false;
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.storeRelease(tail + 1);
+        return true;
+    }
+
+    // The slot is moved from, pass a moved-from value to not keep data
+    // referenced by the slot.
+    bool pop(T *value)
+    {
+        const quint32 head = m_head.loadRelaxed();
+        if (head == m_tail.loadAcquire())
+            return false;
+        *value = std::move(m_slots[head & m_mask]);
+        m_head.storeRelease(head + 1);
+        return true;
+    }
+
+    // Only exact if called by the producer or consumer while the other side
+    // is idle.
+    inline bool isEmpty() const { return m_head.loadAcquire() == m_tail.loadAcquire(); }
+
+private:
+    Q_DISABLE_COPY(QMqttSpscQueue)
+
+    std::unique_ptr<T[]> m_slots;
+    quint32 m_mask{0};
+    // Indices grow monotonically and wrap around, the slot is index & m_mask.
+    // Producer and consumer each write one of them, keep them apart.
+    alignas(64) QAtomicInteger<quint32> m_head{0};
+    alignas(64) QAtomicInteger<quint32> m_tail{0};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTSPSCQUEUE_P_H
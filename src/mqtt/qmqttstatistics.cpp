@@ -0,0 +1,511 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqttstatistics.h"
+#include "qmqttstatistics_p.h"
+#include "qmqttinflighttable_p.h"
+
+#include <QtCore/qalgorithms.h>
+
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttStatistics
+
+    \inmodule QtMqtt
+    \since 6.9
+
+    \brief The QMqttStatistics class is a snapshot of the counters of a
+    client.
+
+    QMqttClient counts the packets and bytes it sends and receives, and keeps
+    track of pending acknowledgments, its read buffer, the use of topic
+    aliases and the connections to the server. The counters are updated
+    with relaxed atomic operations, QMqttClient::statistics() can be called
+    from any thread to read them.
+
+    The counters are not read atomically as a whole. Values of one snapshot
+    might therefore be slightly out of sync with each other while the
+    client is active.
+
+    Counters accumulate over the lifetime of the client and are not reset
+    when connecting again. Gauges like readBufferSize() describe the state at
+    the time of the snapshot.
+
+    \sa QMqttClient::statistics(), QMqttClient::latencyHistogram(),
+        QMqttSubscription::receivedMessageCount()
+*/
+
+/*!
+    \enum QMqttStatistics::PacketType
+
+    This enum type specifies the MQTT control packet types. The values match
+    the packet type in the fixed header of a packet.
+
+    \value Connect CONNECT
+    \value ConnectAcknowledge CONNACK
+    \value Publish PUBLISH
+    \value PublishAcknowledge PUBACK
+    \value PublishReceived PUBREC
+    \value PublishRelease PUBREL
+    \value PublishComplete PUBCOMP
+    \value Subscribe SUBSCRIBE
+    \value SubscribeAcknowledge SUBACK
+    \value Unsubscribe UNSUBSCRIBE
+    \value UnsubscribeAcknowledge UNSUBACK
+    \value PingRequest PINGREQ
+    \value PingResponse PINGRESP
+    \value Disconnect DISCONNECT
+    \value Authenticate AUTH
+*/
+
+/*!
+    Creates a snapshot with all counters set to zero.
+*/
+QMqttStatistics::QMqttStatistics() : data(new QMqttStatisticsData)
+{
+}
+
+/*!
+    \internal
+*/
+QMqttStatistics::QMqttStatistics(const QMqttStatistics &) = default;
+
+/*!
+    \internal
+*/
+QMqttStatistics &QMqttStatistics::operator=(const QMqttStatistics &rhs)
+{
+    if (this != &rhs)
+        data.operator=(rhs.data);
+    return *this;
+}
+
+QMqttStatistics::~QMqttStatistics() = default;
+
+static bool isValidPacketType(QMqttStatistics::PacketType type)
+{
+    return type > 0 && type < QMqttStatisticsData::PacketTypeCount;
+}
+
+/*!
+    Returns the number of packets of \a type written to the transport.
+
+    A packet counts as sent once it has been passed to the transport, or
+    added to a batch.
+
+    \sa QMqttClient::beginBatch()
+*/
+quint64 QMqttStatistics::sentPackets(PacketType type) const
+{
+    return isValidPacketType(type) ? data->sent[type].packets : 0;
+}
+
+/*!
+    Returns the number of bytes of the packets of \a type written to the
+    transport, including their fixed header.
+*/
+quint64 QMqttStatistics::sentBytes(PacketType type) const
+{
+    return isValidPacketType(type) ? data->sent[type].bytes : 0;
+}
+
+/*!
+    Returns the number of packets of \a type received from the server.
+*/
+quint64 QMqttStatistics::receivedPackets(PacketType type) const
+{
+    return isValidPacketType(type) ? data->received[type].packets : 0;
+}
+
+/*!
+    Returns the number of bytes of the packets of \a type received from the
+    server, including their fixed header.
+*/
+quint64 QMqttStatistics::receivedBytes(PacketType type) const
+{
+    return isValidPacketType(type) ? data->received[type].bytes : 0;
+}
+
+template<typename Member>
+static quint64 total(const std::array<QMqttStatisticsData::Traffic,
+                                      QMqttStatisticsData::PacketTypeCount> &traffic,
+                     Member member)
+{
+    quint64 result = 0;
+    for (const QMqttStatisticsData::Traffic &t : traffic)
+        result += t.*member;
+    return result;
+}
+
+/*!
+    Returns the number of packets of all types written to the transport.
+*/
+quint64 QMqttStatistics::totalSentPackets() const
+{
+    return total(data->sent, &QMqttStatisticsData::Traffic::packets);
+}
+
+/*!
+    Returns the number of bytes of all packets written to the transport.
+*/
+quint64 QMqttStatistics::totalSentBytes() const
+{
+    return total(data->sent, &QMqttStatisticsData::Traffic::bytes);
+}
+
+/*!
+    Returns the number of packets of all types received from the server.
+*/
+quint64 QMqttStatistics::totalReceivedPackets() const
+{
+    return total(data->received, &QMqttStatisticsData::Traffic::packets);
+}
+
+/*!
+    Returns the number of bytes of all packets received from the server.
+*/
+quint64 QMqttStatistics::totalReceivedBytes() const
+{
+    return total(data->received, &QMqttStatisticsData::Traffic::bytes);
+}
+
+/*!
+    Returns the number of writes to the transport.
+
+    With batching, one write can contain many packets.
+
+    \sa QMqttClient::beginBatch()
+*/
+quint64 QMqttStatistics::transportWrites() const
+{
+    return data->transportWrites;
+}
+
+/*!
+    Returns the number of QoS 1 and QoS 2 messages waiting for a PUBACK or
+    PUBREC, including queued messages.
+*/
+int QMqttStatistics::pendingPublishAcknowledgments() const
+{
+    return data->pendingPublishAcknowledgments;
+}
+
+/*!
+    Returns the number of QoS 2 messages waiting for a PUBCOMP.
+*/
+int QMqttStatistics::pendingPublishCompletions() const
+{
+    return data->pendingPublishCompletions;
+}
+
+/*!
+    Returns the number of subscriptions waiting for a SUBACK.
+*/
+int QMqttStatistics::pendingSubscribeAcknowledgments() const
+{
+    return data->pendingSubscribeAcknowledgments;
+}
+
+/*!
+    Returns the number of subscriptions waiting for an UNSUBACK.
+*/
+int QMqttStatistics::pendingUnsubscribeAcknowledgments() const
+{
+    return data->pendingUnsubscribeAcknowledgments;
+}
+
+/*!
+    Returns the number of messages queued locally.
+
+    \sa QMqttClient::publishQueueSize()
+*/
+qsizetype QMqttStatistics::queuedPublishes() const
+{
+    return data->queuedPublishes;
+}
+
+/*!
+    Returns the number of received bytes which are not processed yet, as they
+    do not form a complete packet.
+*/
+qsizetype QMqttStatistics::readBufferSize() const
+{
+    return data->readBufferSize;
+}
+
+/*!
+    Returns the largest size of the read buffer so far.
+*/
+qsizetype QMqttStatistics::readBufferPeak() const
+{
+    return data->readBufferPeak;
+}
+
+/*!
+    Returns the number of messages published using an existing topic alias
+    instead of the topic.
+*/
+quint64 QMqttStatistics::topicAliasHits() const
+{
+    return data->topicAliasHits;
+}
+
+/*!
+    Returns the number of messages published with the topic while assigning
+    a topic alias.
+
+    Messages are only counted if topic aliases are used.
+*/
+quint64 QMqttStatistics::topicAliasMisses() const
+{
+    return data->topicAliasMisses;
+}
+
+/*!
+    Returns the fraction of messages published using an existing topic
+    alias, or \c 0 if no topic aliases have been used.
+*/
+double QMqttStatistics::topicAliasHitRate() const
+{
+    const quint64 uses = data->topicAliasHits + data->topicAliasMisses;
+    return uses > 0 ? double(data->topicAliasHits) / double(uses) : 0.;
+}
+
+/*!
+    Returns the number of connections established with the server.
+*/
+quint32 QMqttStatistics::connections() const
+{
+    return data->connections;
+}
+
+/*!
+    Returns the number of connections established after the first one.
+*/
+quint32 QMqttStatistics::reconnections() const
+{
+    return data->reconnections;
+}
+
+/*!
+    Returns the number of established connections which have been closed
+    without a call to QMqttClient::disconnectFromHost().
+*/
+quint32 QMqttStatistics::connectionLosses() const
+{
+    return data->connectionLosses;
+}
+
+/*!
+    Returns the number of connections closed due to a protocol violation.
+*/
+quint32 QMqttStatistics::protocolErrors() const
+{
+    return data->protocolErrors;
+}
+
+/*!
+    \class QMqttLatencyHistogram
+
+    \inmodule QtMqtt
+    \since 6.9
+
+    \brief The QMqttLatencyHistogram class is a snapshot of the round trip
+    times of one kind of acknowledgment.
+
+    QMqttClient measures the time from writing a PUBLISH, PUBREL or PINGREQ
+    packet until the server acknowledges it, and counts it in a histogram of
+    fixed size. Values are in microseconds.
+
+    The buckets are log-linear: small values have a bucket each, and every
+    power of two above is split into buckets of equal width. The relative
+    error of a value derived from the buckets is at most 12.5%. Very long
+    round trips are counted in the last bucket.
+
+    \sa QMqttClient::latencyHistogram()
+*/
+
+/*!
+    Creates an empty histogram.
+*/
+QMqttLatencyHistogram::QMqttLatencyHistogram() : data(new QMqttLatencyHistogramData)
+{
+}
+
+/*!
+    \internal
+*/
+QMqttLatencyHistogram::QMqttLatencyHistogram(const QMqttLatencyHistogram &) = default;
+
+/*!
+    \internal
+*/
+QMqttLatencyHistogram &QMqttLatencyHistogram::operator=(const QMqttLatencyHistogram &rhs)
+{
+    if (this != &rhs)
+        data.operator=(rhs.data);
+    return *this;
+}
+
+QMqttLatencyHistogram::~QMqttLatencyHistogram() = default;
+
+/*!
+    Returns the number of round trips.
+*/
+quint64 QMqttLatencyHistogram::count() const
+{
+    return data->count;
+}
+
+/*!
+    Returns the sum of all round trips in microseconds.
+*/
+quint64 QMqttLatencyHistogram::sum() const
+{
+    return data->sum;
+}
+
+/*!
+    Returns the longest round trip in microseconds.
+*/
+quint64 QMqttLatencyHistogram::maximum() const
+{
+    return data->maximum;
+}
+
+/*!
+    Returns the average round trip in microseconds, or \c 0 if nothing has
+    been recorded.
+*/
+double QMqttLatencyHistogram::mean() const
+{
+    return data->count > 0 ? double(data->sum) / double(data->count) : 0.;
+}
+
+/*!
+    Returns the round trip in microseconds which \a fraction of all round
+    trips did not exceed, for instance \c 0.99 for the 99th percentile.
+
+    The value is the upper bound of the bucket containing the percentile,
+    limited to maximum(). Returns \c 0 if nothing has been recorded.
+*/
+quint64 QMqttLatencyHistogram::percentile(double fraction) const
+{
+    if (data->count == 0)
+        return 0;
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(qBound(0., fraction, 1.)
+                                                            * double(data->count))));
+    quint64 seen = 0;
+    for (int i = 0; i < QMqttLatencyBuckets::Count - 1; ++i) {
+        seen += data->buckets[i];
+        if (seen >= rank)
+            return qMin(QMqttLatencyBuckets::lowerBound(i + 1) - 1, data->maximum);
+    }
+    return data->maximum;
+}
+
+/*!
+    Returns the number of buckets.
+*/
+int QMqttLatencyHistogram::bucketCount() const
+{
+    return QMqttLatencyBuckets::Count;
+}
+
+/*!
+    Returns the number of round trips counted in the bucket at \a index.
+
+    \sa bucketLowerBound()
+*/
+quint64 QMqttLatencyHistogram::bucketValue(int index) const
+{
+    return index >= 0 && index < QMqttLatencyBuckets::Count ? data->buckets[index] : 0;
+}
+
+/*!
+    Returns the index of the bucket counting a round trip of \a microseconds.
+*/
+int QMqttLatencyHistogram::bucketIndex(quint64 microseconds) const
+{
+    return QMqttLatencyBuckets::index(microseconds);
+}
+
+/*!
+    Returns the smallest round trip in microseconds counted in the bucket at
+    \a index.
+*/
+quint64 QMqttLatencyHistogram::bucketLowerBound(int index) const
+{
+    return QMqttLatencyBuckets::lowerBound(qBound(0, index, QMqttLatencyBuckets::Count - 1));
+}
+
+int QMqttLatencyBuckets::index(quint64 microseconds)
+{
+    if (microseconds < 2 * SubBucketCount)
+        return int(microseconds);
+    const int exponent = 63 - qCountLeadingZeroBits(microseconds);
+    if (exponent > MaximumExponent)
+        return Count - 1;
+    const int subBucket = int(microseconds >> (exponent - SubBucketBits)) & (SubBucketCount - 1);
+    return (exponent - SubBucketBits + 1) * SubBucketCount + subBucket;
+}
+
+quint64 QMqttLatencyBuckets::lowerBound(int index)
+{
+    if (index < 2 * SubBucketCount)
+        return quint64(index);
+    const int exponent = index / SubBucketCount + SubBucketBits - 1;
+    const int subBucket = index % SubBucketCount;
+    return quint64(SubBucketCount + subBucket) << (exponent - SubBucketBits);
+}
+
+void QMqttLatencyRecorder::record(qint64 microseconds)
+{
+    const quint64 value = quint64(qMax<qint64>(0, microseconds));
+    m_buckets[QMqttLatencyBuckets::index(value)].add();
+    m_count.add();
+    m_sum.add(value);
+    m_maximum.raise(value);
+}
+
+QMqttLatencyHistogram QMqttLatencyRecorder::snapshot() const
+{
+    QMqttLatencyHistogram histogram;
+    QMqttLatencyHistogramData *d = histogram.data.data();
+    for (int i = 0; i < QMqttLatencyBuckets::Count; ++i)
+        d->buckets[i] = m_buckets[i].load();
+    d->count = m_count.load();
+    d->sum = m_sum.load();
+    d->maximum = m_maximum.load();
+    return histogram;
+}
+
+QMqttStatistics QMqttStatisticsCounters::snapshot(const QMqttInflightTable &inflight) const
+{
+    QMqttStatistics statistics;
+    QMqttStatisticsData *d = statistics.data.data();
+    for (int i = 0; i < PacketTypeCount; ++i) {
+        d->sent[i] = {sent[i].packets.load(), sent[i].bytes.load()};
+        d->received[i] = {received[i].packets.load(), received[i].bytes.load()};
+    }
+    d->transportWrites = transportWrites.load();
+    d->pendingPublishAcknowledgments = inflight.count(QMqttInflightTable::PublishAck);
+    d->pendingPublishCompletions = inflight.count(QMqttInflightTable::PublishComplete);
+    d->pendingSubscribeAcknowledgments = inflight.count(QMqttInflightTable::SubscribeAck);
+    d->pendingUnsubscribeAcknowledgments = inflight.count(QMqttInflightTable::UnsubscribeAck);
+    d->queuedPublishes = queuedPublishes.load();
+    d->readBufferSize = readBufferSize.load();
+    d->readBufferPeak = readBufferPeak.load();
+    d->topicAliasHits = topicAliasHits.load();
+    d->topicAliasMisses = topicAliasMisses.load();
+    d->connections = connections.load();
+    d->reconnections = reconnections.load();
+    d->connectionLosses = connectionLosses.load();
+    d->protocolErrors = protocolErrors.load();
+    return statistics;
+}
+
+QT_END_NAMESPACE
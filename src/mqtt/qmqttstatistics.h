@@ -0,0 +1,104 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTSTATISTICS_H
+#define QMQTTSTATISTICS_H
+
+#include <QtMqtt/qmqttglobal.h>
+
+#include <QtCore/QSharedDataPointer>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttStatisticsData;
+class QMqttLatencyHistogramData;
+
+class Q_MQTT_EXPORT QMqttStatistics
+{
+public:
+    // Values of the control packet type in the fixed header
+    enum PacketType : quint8 {
+        Connect = 1,
+        ConnectAcknowledge,
+        Publish,
+        PublishAcknowledge,
+        PublishReceived,
+        PublishRelease,
+        PublishComplete,
+        Subscribe,
+        SubscribeAcknowledge,
+        Unsubscribe,
+        UnsubscribeAcknowledge,
+        PingRequest,
+        PingResponse,
+        Disconnect,
+        Authenticate
+    };
+
+    QMqttStatistics();
+    QMqttStatistics(const QMqttStatistics &);
+    QMqttStatistics &operator=(const QMqttStatistics &);
+    ~QMqttStatistics();
+
+    quint64 sentPackets(PacketType type) const;
+    quint64 sentBytes(PacketType type) const;
+    quint64 receivedPackets(PacketType type) const;
+    quint64 receivedBytes(PacketType type) const;
+
+    quint64 totalSentPackets() const;
+    quint64 totalSentBytes() const;
+    quint64 totalReceivedPackets() const;
+    quint64 totalReceivedBytes() const;
+
+    quint64 transportWrites() const;
+
+    int pendingPublishAcknowledgments() const;
+    int pendingPublishCompletions() const;
+    int pendingSubscribeAcknowledgments() const;
+    int pendingUnsubscribeAcknowledgments() const;
+    qsizetype queuedPublishes() const;
+
+    qsizetype readBufferSize() const;
+    qsizetype readBufferPeak() const;
+
+    quint64 topicAliasHits() const;
+    quint64 topicAliasMisses() const;
+    double topicAliasHitRate() const;
+
+    quint32 connections() const;
+    quint32 reconnections() const;
+    quint32 connectionLosses() const;
+    quint32 protocolErrors() const;
+
+private:
+    friend struct QMqttStatisticsCounters;
+    QSharedDataPointer<QMqttStatisticsData> data;
+};
+
+class Q_MQTT_EXPORT QMqttLatencyHistogram
+{
+public:
+    QMqttLatencyHistogram();
+    QMqttLatencyHistogram(const QMqttLatencyHistogram &);
+    QMqttLatencyHistogram &operator=(const QMqttLatencyHistogram &);
+    ~QMqttLatencyHistogram();
+
+    quint64 count() const;
+    quint64 sum() const;
+    quint64 maximum() const;
+    double mean() const;
+    quint64 percentile(double fraction) const;
+
+    int bucketCount() const;
+    quint64 bucketValue(int index) const;
+    int bucketIndex(quint64 microseconds) const;
+    quint64 bucketLowerBound(int index) const;
+
+private:
+    friend class QMqttLatencyRecorder;
+    QSharedDataPointer<QMqttLatencyHistogramData> data;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTSTATISTICS_H
@@ -0,0 +1,170 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTSTATISTICS_P_H
+#define QMQTTSTATISTICS_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttstatistics.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QSharedData>
+#include <QtCore/private/qglobal_p.h>
+
+#include <array>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttInflightTable;
+
+// Log-linear bucket layout of QMqttLatencyHistogram. Values below
+// 2 * SubBucketCount have a bucket each, every power of two above is split
+// into SubBucketCount buckets. Values of 2^(MaximumExponent + 1) and more are
+// counted in the last bucket.
+struct QMqttLatencyBuckets
+{
+    static constexpr int SubBucketBits = 3;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    static constexpr int MaximumExponent = 27;
+    static constexpr int Count = 2 * SubBucketCount + (MaximumExponent - SubBucketBits) * SubBucketCount;
+
+    static int index(quint64 microseconds);
+    static quint64 lowerBound(int index);
+};
+
+class QMqttStatisticsData : public QSharedData
+{
+public:
+    // Indexed by the packet type, index 0 is unused
+    static constexpr int PacketTypeCount = QMqttStatistics::Authenticate + 1;
+
+    struct Traffic
+    {
+        quint64 packets{0};
+        quint64 bytes{0};
+    };
+
+    std::array<Traffic, PacketTypeCount> sent{};
+    std::array<Traffic, PacketTypeCount> received{};
+    quint64 transportWrites{0};
+    int pendingPublishAcknowledgments{0};
+    int pendingPublishCompletions{0};
+    int pendingSubscribeAcknowledgments{0};
+    int pendingUnsubscribeAcknowledgments{0};
+    qsizetype queuedPublishes{0};
+    qsizetype readBufferSize{0};
+    qsizetype readBufferPeak{0};
+    quint64 topicAliasHits{0};
+    quint64 topicAliasMisses{0};
+    quint32 connections{0};
+    quint32 reconnections{0};
+    quint32 connectionLosses{0};
+    quint32 protocolErrors{0};
+};
+
+class QMqttLatencyHistogramData : public QSharedData
+{
+public:
+    std::array<quint64, QMqttLatencyBuckets::Count> buckets{};
+    quint64 count{0};
+    quint64 sum{0};
+    quint64 maximum{0};
+};
+
+// Counter written by a single thread and read by any thread. Updates are a
+// relaxed load and store instead of a read-modify-write, so that counting
+// costs no more than incrementing a plain integer.
+template<typename T>
+class QMqttStatisticsCounter
+{
+public:
+    inline void add(T value = 1) { m_value.storeRelaxed(m_value.loadRelaxed() + value); }
+    inline void set(T value) { m_value.storeRelaxed(value); }
+    inline void raise(T value)
+    {
+        if (value > m_value.loadRelaxed())
+            m_value.storeRelaxed(value);
+    }
+    inline T load() const { return m_value.loadRelaxed(); }
+
+private:
+    QAtomicInteger<T> m_value{0};
+};
+
+// Fixed size histogram of round trip times in microseconds, updated like
+// QMqttStatisticsCounter
+class Q_AUTOTEST_EXPORT QMqttLatencyRecorder
+{
+public:
+    void record(qint64 microseconds);
+    QMqttLatencyHistogram snapshot() const;
+
+private:
+    std::array<QMqttStatisticsCounter<quint64>, QMqttLatencyBuckets::Count> m_buckets;
+    QMqttStatisticsCounter<quint64> m_count;
+    QMqttStatisticsCounter<quint64> m_sum;
+    QMqttStatisticsCounter<quint64> m_maximum;
+};
+
+// Counters of a connection, updated from the thread the client lives in
+struct QMqttStatisticsCounters
+{
+    struct Traffic
+    {
+        QMqttStatisticsCounter<quint64> packets;
+        QMqttStatisticsCounter<quint64> bytes;
+    };
+
+    // Traffic counters per packet type, index 0 is unused
+    static constexpr int PacketTypeCount = QMqttStatisticsData::PacketTypeCount;
+
+    inline void countSent(quint8 header, qsizetype size)
+    {
+        Traffic &traffic = sent[header >> 4];
+        traffic.packets.add();
+        traffic.bytes.add(quint64(size));
+    }
+
+    inline void countReceived(quint8 header, qsizetype size)
+    {
+        Traffic &traffic = received[header >> 4];
+        traffic.packets.add();
+        traffic.bytes.add(quint64(size));
+    }
+
+    QMqttStatistics snapshot(const QMqttInflightTable &inflight) const;
+
+    std::array<Traffic, PacketTypeCount> sent;
+    std::array<Traffic, PacketTypeCount> received;
+    QMqttStatisticsCounter<quint64> transportWrites;
+    QMqttStatisticsCounter<qsizetype> queuedPublishes;
+    QMqttStatisticsCounter<qsizetype> readBufferSize;
+    QMqttStatisticsCounter<qsizetype> readBufferPeak;
+    QMqttStatisticsCounter<quint64> topicAliasHits;
+    QMqttStatisticsCounter<quint64> topicAliasMisses;
+    QMqttStatisticsCounter<quint32> connections;
+    QMqttStatisticsCounter<quint32> reconnections;
+    QMqttStatisticsCounter<quint32> connectionLosses;
+    QMqttStatisticsCounter<quint32> protocolErrors;
+
+    // PUBLISH to PUBACK, PUBLISH to PUBREC, PUBREL to PUBCOMP and PINGREQ to
+    // PINGRESP
+    QMqttLatencyRecorder publishAcknowledgeLatency;
+    QMqttLatencyRecorder publishReceivedLatency;
+    QMqttLatencyRecorder publishCompleteLatency;
+    QMqttLatencyRecorder pingResponseLatency;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTSTATISTICS_P_H
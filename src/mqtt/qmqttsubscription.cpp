@@ -58,6 +58,18 @@ QT_BEGIN_NAMESPACE
     \fn QMqttSubscription::messageReceived(QMqttMessage msg)
 
     This signal is emitted when the new message \a msg has been received.
+
+    \sa setMessageHandler()
+*/
+
+/*!
+    \typedef QMqttSubscription::MessageHandler
+    \since 6.9
+
+    Synonym for \c{std::function<void(const QMqttMessage &)>}, the type of a
+    function handling the messages received by a subscription.
+
+    \sa setMessageHandler()
 */
 
 /*!
@@ -163,6 +175,77 @@ QString QMqttSubscription::sharedSubscriptionName() const
     return d->m_sharedSubscriptionName;
 }
 
+/*!
+    \since 6.9
+
+    Returns the function called for each message received by this
+    subscription, or an empty handler if none is set.
+
+    \sa setMessageHandler()
+*/
+QMqttSubscription::MessageHandler QMqttSubscription::messageHandler() const
+{
+    Q_D(const QMqttSubscription);
+    return d->m_messageHandler;
+}
+
+/*!
+    \since 6.9
+
+    Sets the function called for each message received by this subscription to
+    \a handler. Passing an empty handler removes a previously set handler.
+
+    The handler is called directly by the client, before messageReceived() is
+    emitted. In contrast to a connection to messageReceived(), it does not go
+    through the meta-object system and the message is passed without copying
+    it. This makes handlers preferable for subscriptions receiving high message
+    rates.
+
+    The handler is called in the thread of the client. It may call
+    setMessageHandler() for the subscription it is handling a message of, the
+    new handler is used from the next message on.
+
+    \sa messageHandler(), messageReceived(), QMqttClient::subscribe()
+*/
+void QMqttSubscription::setMessageHandler(const MessageHandler &handler)
+{
+    Q_D(QMqttSubscription);
+    d->m_messageHandler = handler;
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Returns the number of messages received by this subscription.
+
+    The counter is updated in the thread of the client with relaxed atomic
+    operations and can be read from any thread while the subscription
+    exists.
+
+    \sa receivedByteCount(), QMqttClient::statistics()
+*/
+quint64 QMqttSubscription::receivedMessageCount() const
+{
+    Q_D(const QMqttSubscription);
+    return d->m_receivedMessages.load();
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Returns the number of payload bytes of the messages received by this
+    subscription.
+
+    \sa receivedMessageCount()
+*/
+quint64 QMqttSubscription::receivedByteCount() const
+{
+    Q_D(const QMqttSubscription);
+    return d->m_receivedBytes.load();
+}
+
 void QMqttSubscription::setState(QMqttSubscription::SubscriptionState state)
 {
     Q_D(QMqttSubscription);
@@ -10,6 +10,8 @@
 
 #include <QtCore/QObject>
 
+#include <functional>
+
 QT_BEGIN_NAMESPACE
 
 class QMqttClient;
@@ -28,6 +30,7 @@ class Q_MQTT_EXPORT QMqttSubscription : public QObject
     Q_PROPERTY(QString sharedSubscriptionName READ sharedSubscriptionName)
 public:
     ~QMqttSubscription() override;
+    using MessageHandler = std::function<void(const QMqttMessage &)>;
     enum SubscriptionState {
         Unsubscribed = 0,
         SubscriptionPending,
@@ -46,6 +49,12 @@ public:
     bool isSharedSubscription() const;
     QString sharedSubscriptionName() const;
 
+    MessageHandler messageHandler() const;
+    void setMessageHandler(const MessageHandler &handler);
+
+    quint64 receivedMessageCount() const;
+    quint64 receivedByteCount() const;
+
 Q_SIGNALS:
     void stateChanged(SubscriptionState state);
     void qosChanged(quint8); // only emitted when broker provides different QoS than requested
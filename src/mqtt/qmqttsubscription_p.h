@@ -16,6 +16,7 @@
 //
 
 #include "qmqttsubscription.h"
+#include "qmqttstatistics_p.h"
 #include <QtCore/private/qobject_p.h>
 
 QT_BEGIN_NAMESPACE
@@ -31,10 +32,15 @@ public:
     QString m_reasonString;
     QMqttUserProperties m_userProperties;
     QString m_sharedSubscriptionName;
+    QMqttSubscription::MessageHandler m_messageHandler;
+    QMqttStatisticsCounter<quint64> m_receivedMessages;
+    QMqttStatisticsCounter<quint64> m_receivedBytes; // Payload only
     QMqttSubscription::SubscriptionState m_state{QMqttSubscription::Unsubscribed};
     QMqtt::ReasonCode m_reasonCode{QMqtt::ReasonCode::Success};
+    quint32 m_subscriptionIdentifier{0};
     quint8 m_qos{0};
     bool m_shared{false};
+    bool m_assignedSubscriptionIdentifier{false}; // Chosen by the connection, not the user
 };
 
 QT_END_NAMESPACE
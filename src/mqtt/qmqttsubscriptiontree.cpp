@@ -0,0 +1,202 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqttsubscriptiontree_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttSubscriptionTree
+    \internal
+
+    \brief The QMqttSubscriptionTree class stores active subscriptions in a
+    tree of topic levels.
+
+    Each node of the tree represents one topic level of a topic filter. The
+    wildcards \c + and \c # are stored in dedicated child nodes. Looking up the
+    subscriptions for an incoming topic name only visits the nodes on the path
+    of the topic and the wildcard branches along this path. Hence, the costs
+    of a lookup depend on the number of levels of the topic name, not on the
+    number of subscriptions.
+
+    Topic names starting with \c $ are not matched by a wildcard on the first
+    level, see MQTT-4.7.2-1.
+*/
+
+QMqttSubscriptionTree::Node::~Node()
+{
+    qDeleteAll(children);
+    delete singleLevelWildcard;
+    delete multiLevelWildcard;
+}
+
+bool QMqttSubscriptionTree::Node::isEmpty() const
+{
+    return subscription == nullptr
+           && children.isEmpty()
+           && singleLevelWildcard == nullptr
+           && multiLevelWildcard == nullptr;
+}
+
+QMqttSubscriptionTree::QMqttSubscriptionTree()
+{
+}
+
+QMqttSubscriptionTree::~QMqttSubscriptionTree()
+{
+}
+
+void QMqttSubscriptionTree::split(QByteArrayView topic, Levels &levels)
+{
+    // Topic levels are separated by '/'. Empty levels are valid and need to
+    // be kept, so "/a" results in the levels "" and "a".
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < topic.size(); ++i) {
+        if (topic.at(i) == '/') {
+            levels.append(topic.sliced(start, i - start));
+            start = i + 1;
+        }
+    }
+    levels.append(topic.sliced(start));
+}
+
+/*!
+    Adds \a subscription for \a filter. An existing subscription for the same
+    filter is replaced.
+*/
+void QMqttSubscriptionTree::insert(const QMqttTopicFilter &filter, QMqttSubscription *subscription)
+{
+    const QByteArray filterUtf8 = filter.toUtf8();
+    Levels levels;
+    split(filterUtf8, levels);
+
+    Node *node = &m_root;
+    for (const QByteArrayView level : std::as_const(levels)) {
+        Node **next = nullptr;
+        if (level == "+") {
+            next = &node->singleLevelWildcard;
+        } else if (level == "#") {
+            next = &node->multiLevelWildcard;
+        } else {
+            const QByteArray key = level.toByteArray();
+            auto it = node->children.find(key);
+            if (it == node->children.end())
+                it = node->children.insert(key, nullptr);
+            next = &it.value();
+        }
+        if (*next == nullptr)
+            *next = new Node;
+        node = *next;
+    }
+
+    if (node->subscription == nullptr)
+        ++m_size;
+    node->subscription = subscription;
+}
+
+bool QMqttSubscriptionTree::removeHelper(Node *node, const Levels &levels, qsizetype index,
+                                         bool *removed)
+{
+    if (index == levels.size()) {
+        *removed = node->subscription != nullptr;
+        node->subscription = nullptr;
+        return node->isEmpty();
+    }
+
+    const QByteArrayView level = levels.at(index);
+    if (level == "+") {
+        if (node->singleLevelWildcard
+                && removeHelper(node->singleLevelWildcard, levels, index + 1, removed)) {
+            delete node->singleLevelWildcard;
+            node->singleLevelWildcard = nullptr;
+        }
+    } else if (level == "#") {
+        if (node->multiLevelWildcard
+                && removeHelper(node->multiLevelWildcard, levels, index + 1, removed)) {
+            delete node->multiLevelWildcard;
+            node->multiLevelWildcard = nullptr;
+        }
+    } else {
+        const QByteArray key = QByteArray::fromRawData(level.data(), level.size());
+        auto it = node->children.find(key);
+        if (it != node->children.end() && removeHelper(it.value(), levels, index + 1, removed)) {
+            delete it.value();
+            node->children.erase(it);
+        }
+    }
+    return node->isEmpty();
+}
+
+/*!
+    Removes the subscription for \a filter. Nodes which are not needed anymore
+    are pruned from the tree.
+
+    Returns \c true if a subscription has been removed.
+*/
+bool QMqttSubscriptionTree::remove(const QMqttTopicFilter &filter)
+{
+    const QByteArray filterUtf8 = filter.toUtf8();
+    Levels levels;
+    split(filterUtf8, levels);
+
+    bool removed = false;
+    removeHelper(&m_root, levels, 0, &removed);
+    if (removed)
+        --m_size;
+    return removed;
+}
+
+void QMqttSubscriptionTree::clear()
+{
+    qDeleteAll(m_root.children);
+    m_root.children.clear();
+    delete m_root.singleLevelWildcard;
+    m_root.singleLevelWildcard = nullptr;
+    delete m_root.multiLevelWildcard;
+    m_root.multiLevelWildcard = nullptr;
+    m_root.subscription = nullptr;
+    m_size = 0;
+}
+
+void QMqttSubscriptionTree::collect(const Node *node, const Levels &levels, qsizetype index,
+                                    bool matchWildcards, QList<QMqttSubscription *> &subscribers)
+{
+    // '#' also represents the parent level, hence it matches before
+    // checking whether all levels have been consumed.
+    if (matchWildcards && node->multiLevelWildcard && node->multiLevelWildcard->subscription)
+        subscribers.append(node->multiLevelWildcard->subscription);
+
+    if (index == levels.size()) {
+        if (node->subscription)
+            subscribers.append(node->subscription);
+        return;
+    }
+
+    const QByteArrayView level = levels.at(index);
+    if (!node->children.isEmpty()) {
+        const auto it = node->children.constFind(QByteArray::fromRawData(level.data(), level.size()));
+        if (it != node->children.cend())
+            collect(it.value(), levels, index + 1, true, subscribers);
+    }
+
+    if (matchWildcards && node->singleLevelWildcard)
+        collect(node->singleLevelWildcard, levels, index + 1, true, subscribers);
+}
+
+/*!
+    Appends all subscriptions matching the UTF-8 encoded \a topic to
+    \a subscribers.
+*/
+void QMqttSubscriptionTree::match(QByteArrayView topic, QList<QMqttSubscription *> &subscribers) const
+{
+    if (m_size == 0 || topic.isEmpty())
+        return;
+
+    Levels levels;
+    split(topic, levels);
+
+    // MQTT-4.7.2-1 Wildcards at the first level must not match topics starting with '$'
+    collect(&m_root, levels, 0, topic.front() != '$', subscribers);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,75 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTSUBSCRIPTIONTREE_P_H
+#define QMQTTSUBSCRIPTIONTREE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttglobal.h"
+#include "qmqtttopicfilter.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QByteArrayView>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttSubscription;
+
+class Q_AUTOTEST_EXPORT QMqttSubscriptionTree
+{
+public:
+    QMqttSubscriptionTree();
+    ~QMqttSubscriptionTree();
+
+    void insert(const QMqttTopicFilter &filter, QMqttSubscription *subscription);
+    bool remove(const QMqttTopicFilter &filter);
+    void clear();
+
+    inline bool isEmpty() const { return m_size == 0; }
+    inline qsizetype size() const { return m_size; }
+
+    void match(QByteArrayView topic, QList<QMqttSubscription *> &subscribers) const;
+
+private:
+    Q_DISABLE_COPY(QMqttSubscriptionTree)
+
+    using Levels = QVarLengthArray<QByteArrayView, 16>;
+    static void split(QByteArrayView topic, Levels &levels);
+
+    struct Node
+    {
+        ~Node();
+        bool isEmpty() const;
+
+        QHash<QByteArray, Node *> children;
+        Node *singleLevelWildcard{nullptr}; // '+'
+        Node *multiLevelWildcard{nullptr};  // '#', always a leaf
+        QMqttSubscription *subscription{nullptr};
+    };
+
+    static void collect(const Node *node, const Levels &levels, qsizetype index,
+                        bool matchWildcards, QList<QMqttSubscription *> &subscribers);
+    static bool removeHelper(Node *node, const Levels &levels, qsizetype index,
+                             bool *removed);
+
+    Node m_root;
+    qsizetype m_size{0};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTSUBSCRIPTIONTREE_P_H
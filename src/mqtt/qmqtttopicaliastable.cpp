@@ -0,0 +1,172 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qmqtttopicaliastable_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMqttTopicAliasTable
+    \internal
+
+    \brief The QMqttTopicAliasTable class maps topics to the topic aliases
+    used when publishing.
+
+    Aliases are looked up by topic via a hash. All assigned aliases are kept
+    in a list ordered by their last use. Once all aliases up to the maximum
+    granted by the server are assigned, assigning an alias to a new topic
+    reuses the alias of the least recently used topic.
+*/
+
+/*!
+    Removes all aliases and sets the number of available aliases to
+    \a maximum.
+*/
+void QMqttTopicAliasTable::reset(quint16 maximum)
+{
+    m_slots.clear();
+    m_index.clear();
+    m_unused.clear();
+    m_nextUnused = 1;
+    m_maximum = maximum;
+    m_mostRecent = 0;
+    m_leastRecent = 0;
+}
+
+/*!
+    Returns the alias assigned to \a topic and marks it as most recently used.
+    Returns \c 0 if \a topic has no alias.
+*/
+quint16 QMqttTopicAliasTable::find(const QMqttTopicName &topic)
+{
+    const auto it = m_index.constFind(topic);
+    if (it == m_index.cend())
+        return 0;
+    touch(*it);
+    return *it;
+}
+
+/*!
+    Assigns an alias to \a topic, which must not have an alias yet. Unused
+    aliases are assigned first, afterwards the alias of the least recently
+    used topic is reassigned. Returns \c 0 if no aliases are available.
+*/
+quint16 QMqttTopicAliasTable::assign(const QMqttTopicName &topic)
+{
+    Q_ASSERT(!m_index.contains(topic));
+    if (m_maximum == 0)
+        return 0;
+
+    quint16 alias = 0;
+    while (alias == 0 && !m_unused.isEmpty()) {
+        const quint16 candidate = m_unused.takeLast();
+        if (slot(candidate).topic.toUtf8().isEmpty())
+            alias = candidate;
+    }
+    while (alias == 0 && m_nextUnused <= m_maximum) {
+        const quint16 candidate = quint16(m_nextUnused++);
+        ensureSlot(candidate);
+        // Aliases might have been set explicitly beyond m_nextUnused
+        if (slot(candidate).topic.toUtf8().isEmpty())
+            alias = candidate;
+    }
+    if (alias == 0) {
+        alias = m_leastRecent;
+        Q_ASSERT(alias != 0);
+        unlink(alias);
+        m_index.remove(slot(alias).topic);
+    }
+
+    slot(alias).topic = topic;
+    m_index.insert(topic, alias);
+    prepend(alias);
+    return alias;
+}
+
+/*!
+    Assigns \a alias to \a topic, as requested explicitly by the user. Returns
+    \c false if \a alias is already assigned to \a topic.
+*/
+bool QMqttTopicAliasTable::set(quint16 alias, const QMqttTopicName &topic)
+{
+    Q_ASSERT(alias > 0 && alias <= m_maximum);
+    ensureSlot(alias);
+
+    const QMqttTopicName previousTopic = slot(alias).topic;
+    if (!previousTopic.toUtf8().isEmpty()) {
+        if (previousTopic == topic) {
+            touch(alias);
+            return false;
+        }
+        m_index.remove(previousTopic);
+        unlink(alias);
+    }
+
+    // Only the latest alias of a topic is kept, the previous one becomes unused.
+    const auto it = m_index.constFind(topic);
+    if (it != m_index.cend()) {
+        const quint16 previousAlias = *it;
+        unlink(previousAlias);
+        slot(previousAlias).topic = QMqttTopicName();
+        m_unused.append(previousAlias);
+    }
+
+    slot(alias).topic = topic;
+    m_index.insert(topic, alias);
+    prepend(alias);
+    return true;
+}
+
+/*!
+    Returns the topic assigned to \a alias, or an empty topic if \a alias is
+    not assigned.
+*/
+QMqttTopicName QMqttTopicAliasTable::topic(quint16 alias) const
+{
+    if (alias == 0 || alias > m_slots.size())
+        return QMqttTopicName();
+    return m_slots.at(alias - 1).topic;
+}
+
+void QMqttTopicAliasTable::ensureSlot(quint16 alias)
+{
+    if (alias > m_slots.size())
+        m_slots.resize(alias);
+}
+
+void QMqttTopicAliasTable::unlink(quint16 alias)
+{
+    Slot &s = slot(alias);
+    if (s.previous)
+        slot(s.previous).next = s.next;
+    else
+        m_mostRecent = s.next;
+    if (s.next)
+        slot(s.next).previous = s.previous;
+    else
+        m_leastRecent = s.previous;
+    s.previous = 0;
+    s.next = 0;
+}
+
+void QMqttTopicAliasTable::prepend(quint16 alias)
+{
+    Slot &s = slot(alias);
+    s.previous = 0;
+    s.next = m_mostRecent;
+    if (m_mostRecent)
+        slot(m_mostRecent).previous = alias;
+    else
+        m_leastRecent = alias;
+    m_mostRecent = alias;
+}
+
+void QMqttTopicAliasTable::touch(quint16 alias)
+{
+    if (m_mostRecent == alias)
+        return;
+    unlink(alias);
+    prepend(alias);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,67 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTTOPICALIASTABLE_P_H
+#define QMQTTTOPICALIASTABLE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqttglobal.h"
+#include "qmqtttopicname.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QMqttTopicAliasTable
+{
+public:
+    void reset(quint16 maximum);
+    inline void clear() { reset(0); }
+
+    inline quint16 maximum() const { return m_maximum; }
+    inline qsizetype size() const { return m_index.size(); }
+
+    quint16 find(const QMqttTopicName &topic);
+    quint16 assign(const QMqttTopicName &topic);
+    bool set(quint16 alias, const QMqttTopicName &topic);
+    QMqttTopicName topic(quint16 alias) const;
+
+private:
+    struct Slot
+    {
+        QMqttTopicName topic;
+        // Neighbors in the usage list, 0 if none
+        quint16 previous{0};
+        quint16 next{0};
+    };
+
+    inline Slot &slot(quint16 alias) { return m_slots[alias - 1]; }
+    void ensureSlot(quint16 alias);
+    void unlink(quint16 alias);
+    void prepend(quint16 alias);
+    void touch(quint16 alias);
+
+    QList<Slot> m_slots; // Indexed by alias - 1, grows on demand
+    QHash<QMqttTopicName, quint16> m_index;
+    QList<quint16> m_unused; // Aliases released by set()
+    int m_nextUnused{1};
+    quint16 m_maximum{0};
+    quint16 m_mostRecent{0};
+    quint16 m_leastRecent{0};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTTOPICALIASTABLE_P_H
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
 #include "qmqtttopicfilter.h"
+#include "qmqtttopicfilter_p.h"
+#include "qmqtttopicname_p.h"
 
 #include <QtCore/QDebug>
 #include <QtCore/QList>
@@ -16,7 +18,7 @@ QT_BEGIN_NAMESPACE
 
     \brief The QMqttTopicFilter class represents a MQTT topic filter.
 
-    QMqttTopicFilter is a thin wrapper around a QString providing an expressive
+    QMqttTopicFilter is a thin wrapper around a string providing an expressive
     data type for MQTT topic filters. Beside the benefits of having a strong
     type preventing unintended misuse, QMqttTopicFilter provides convenient
     functions related to topic filters like isValid() or match().
@@ -64,18 +66,57 @@ QT_BEGIN_NAMESPACE
         starts with the dollar sign ($).
  */
 
-class QMqttTopicFilterPrivate : public QSharedData
+static bool isValidFilter(QByteArrayView filter)
 {
-public:
-    QString filter;
-};
+    // MQTT-4.7.3-1, MQTT-4.7.3-3, and MQTT-4.7.3-2
+    const qsizetype size = filter.size();
+    if (size == 0 || size > 65535 || filter.contains('\0'))
+        return false;
+
+    if (size == 1)
+        return true;
+
+    // '#' MUST be last and its own level. It MUST NOT appear more than at most once.
+    const qsizetype multiLevelPosition = filter.indexOf('#');
+    if (multiLevelPosition != -1
+        && (multiLevelPosition != size - 1 || filter.at(size - 2) != '/')) {
+        return false;
+    }
+
+    // '+' MAY occur multiple times but MUST be its own level.
+    qsizetype singleLevelPosition = filter.indexOf('+');
+    while (singleLevelPosition != -1) {
+        if ((singleLevelPosition != 0 && filter.at(singleLevelPosition - 1) != '/')
+            || (singleLevelPosition < size - 1 && filter.at(singleLevelPosition + 1) != '/')) {
+            return false;
+        }
+        singleLevelPosition = filter.indexOf('+', singleLevelPosition + 1);
+    }
+
+    // Shared Subscription syntax
+    // $share/shareName/TopicFilter -- must have at least 2 '/'
+    if (filter.startsWith("$share/")) {
+        const qsizetype index = filter.indexOf('/', 7);
+        if (index == -1 || index == 7)
+            return false;
+    }
+    return true;
+}
+
+void QMqttTopicFilterPrivate::setUtf8(const QByteArray &filter)
+{
+    utf8 = filter;
+    // UTF-8 multi-byte sequences never contain ASCII bytes, hence the
+    // encoded filter can be checked bytewise.
+    valid = isValidFilter(utf8);
+}
 
 /*!
     Creates a new MQTT topic filter with the specified \a filter.
  */
 QMqttTopicFilter::QMqttTopicFilter(const QString &filter) : d(new QMqttTopicFilterPrivate)
 {
-    d->filter = filter;
+    d->setUtf8(filter.toUtf8());
 }
 
 /*!
@@ -83,7 +124,7 @@ QMqttTopicFilter::QMqttTopicFilter(const QString &filter) : d(new QMqttTopicFilt
  */
 QMqttTopicFilter::QMqttTopicFilter(const QLatin1String &filter) : d(new QMqttTopicFilterPrivate)
 {
-    d->filter = filter;
+    d->setUtf8(QString(filter).toUtf8());
 }
 
 /*!
@@ -115,7 +156,7 @@ QMqttTopicFilter &QMqttTopicFilter::operator=(const QMqttTopicFilter &filter)
  */
 QString QMqttTopicFilter::filter() const
 {
-    return d->filter;
+    return QString::fromUtf8(d->utf8);
 }
 
 /*!
@@ -124,7 +165,34 @@ QString QMqttTopicFilter::filter() const
 void QMqttTopicFilter::setFilter(const QString &filter)
 {
     d.detach();
-    d->filter = filter;
+    d->setUtf8(filter.toUtf8());
+}
+
+/*!
+    \since 6.9
+
+    Returns the topic filter encoded in UTF-8. This does not involve a
+    conversion, as topic filters are stored in UTF-8.
+
+    \sa fromUtf8(), filter()
+*/
+QByteArray QMqttTopicFilter::toUtf8() const
+{
+    return d->utf8;
+}
+
+/*!
+    \since 6.9
+
+    Creates a topic filter from the UTF-8 encoded \a filter.
+
+    \sa toUtf8()
+*/
+QMqttTopicFilter QMqttTopicFilter::fromUtf8(const QByteArray &filter)
+{
+    QMqttTopicFilter result;
+    result.d->setUtf8(filter);
+    return result;
 }
 
 /*!
@@ -137,10 +205,10 @@ void QMqttTopicFilter::setFilter(const QString &filter)
 QString QMqttTopicFilter::sharedSubscriptionName() const
 {
     QString result;
-    if (d->filter.startsWith(QLatin1String("$share/"))) {
+    if (d->utf8.startsWith("$share/")) {
         // Has to have at least two /
         // $share/<sharename>/topicfilter
-        result = d->filter.section(QLatin1Char('/'), 1, 1);
+        result = filter().section(QLatin1Char('/'), 1, 1);
     }
     return result;
 }
@@ -151,39 +219,7 @@ QString QMqttTopicFilter::sharedSubscriptionName() const
  */
 bool QMqttTopicFilter::isValid() const
 {
-    // MQTT-4.7.3-1, MQTT-4.7.3-3, and MQTT-4.7.3-2
-    const int size = d->filter.size();
-    if (size == 0 || size > 65535 || d->filter.contains(QChar(QChar::Null)))
-        return false;
-
-    if (size == 1)
-        return true;
-
-    // '#' MUST be last and its own level. It MUST NOT appear more than at most once.
-    const int multiLevelPosition = d->filter.indexOf(QLatin1Char('#'));
-    if (multiLevelPosition != -1
-        && (multiLevelPosition != size - 1 || d->filter.at(size-2) != QLatin1Char('/'))) {
-        return false;
-    }
-
-    // '+' MAY occur multiple times but MUST be its own level.
-    int singleLevelPosition = d->filter.indexOf(QLatin1Char('+'));
-    while (singleLevelPosition != -1) {
-        if ((singleLevelPosition != 0 && d->filter.at(singleLevelPosition - 1) != QLatin1Char('/'))
-            || (singleLevelPosition < size - 1 && d->filter.at(singleLevelPosition + 1) != QLatin1Char('/'))) {
-            return false;
-        }
-        singleLevelPosition = d->filter.indexOf(QLatin1Char('+'), singleLevelPosition + 1);
-    }
-
-    // Shared Subscription syntax
-    // $share/shareName/TopicFilter -- must have at least 2 '/'
-    if (d->filter.startsWith(QLatin1String("$share/"))) {
-        const int index = d->filter.indexOf(QLatin1Char('/'), 7);
-        if (index == -1 || index == 7)
-            return false;
-    }
-    return true;
+    return d->valid;
 }
 
 /*!
@@ -195,54 +231,45 @@ bool QMqttTopicFilter::match(const QMqttTopicName &name, MatchOptions matchOptio
     if (!name.isValid() || !isValid())
         return false;
 
-    const QString topic = name.name();
-    if (topic == d->filter)
+    const QByteArrayView topic = QMqttTopicNamePrivate::get(name)->utf8;
+    const QByteArrayView filter = d->utf8;
+    if (topic == filter)
         return true;
 
     if (matchOptions.testFlag(WildcardsDontMatchDollarTopicMatchOption)
-        && topic.startsWith(QLatin1Char('$'))
-        && (d->filter.startsWith(QLatin1Char('+'))
-            || d->filter == QLatin1Char('#')
-            || d->filter == QLatin1String("/#"))) {
+        && topic.startsWith('$')
+        && (filter.startsWith('+') || filter == "#" || filter == "/#")) {
         return false;
     }
 
-    if (d->filter.endsWith(QLatin1Char('#'))) {
-        QStringView root = QStringView{d->filter}.left(d->filter.size() - 1);
-
-        if (root.isEmpty()) // Filter: #
+    // Compare level by level. A position past the end marks that all levels
+    // have been consumed.
+    qsizetype filterPosition = 0;
+    qsizetype topicPosition = 0;
+    while (true) {
+        qsizetype filterEnd = filter.indexOf('/', filterPosition);
+        if (filterEnd == -1)
+            filterEnd = filter.size();
+        const QByteArrayView filterLevel = filter.sliced(filterPosition, filterEnd - filterPosition);
+
+        // '#' also represents the parent level!
+        if (filterLevel == "#")
             return true;
-
-        if (root.endsWith(QLatin1Char('/'))) // '#' also represents the parent level!
-            root = root.left(root.size() - 1);
-
-        const auto filterLevels = root.split(QLatin1Char('/'));
-        const auto topicLevels = QStringView{topic}.split(QLatin1Char('/'));
-
-        if (topicLevels.size() < filterLevels.size())
+        if (topicPosition > topic.size())
             return false;
 
-        for (int i = 0; i < filterLevels.size(); ++i) {
-            if (filterLevels.at(i) != topicLevels.at(i) && filterLevels.at(i) != QLatin1Char('+'))
-                return false;
-        }
-        return true;
-    }
-
-    if (d->filter.contains(QLatin1Char('+'))) {
-        const auto filterLevels = QStringView{d->filter}.split(QLatin1Char('/'));
-        const auto topicLevels = QStringView{topic}.split(QLatin1Char('/'));
-        if (filterLevels.size() != topicLevels.size())
+        qsizetype topicEnd = topic.indexOf('/', topicPosition);
+        if (topicEnd == -1)
+            topicEnd = topic.size();
+        const QByteArrayView topicLevel = topic.sliced(topicPosition, topicEnd - topicPosition);
+        if (filterLevel != "+" && filterLevel != topicLevel)
             return false;
-        for (int i = 0; i < filterLevels.size(); ++i) {
-            const auto &level = filterLevels.at(i);
-            if (level != QLatin1Char('+') && level != topicLevels.at(i))
-                return false;
-        }
-        return true;
-    }
 
-    return false;
+        filterPosition = filterEnd + 1;
+        topicPosition = topicEnd + 1;
+        if (filterPosition > filter.size())
+            return topicPosition > topic.size();
+    }
 }
 
 /*!
@@ -254,7 +281,7 @@ bool QMqttTopicFilter::match(const QMqttTopicName &name, MatchOptions matchOptio
  */
 bool operator==(const QMqttTopicFilter &lhs, const QMqttTopicFilter &rhs) Q_DECL_NOTHROW
 {
-    return (lhs.d == rhs.d) || (lhs.d->filter == rhs.d->filter);
+    return (lhs.d == rhs.d) || (lhs.d->utf8 == rhs.d->utf8);
 }
 
 /*!
@@ -270,11 +297,12 @@ bool operator==(const QMqttTopicFilter &lhs, const QMqttTopicFilter &rhs) Q_DECL
     \fn bool QMqttTopicFilter::operator<(const QMqttTopicFilter &lhs, const QMqttTopicFilter &rhs)
 
     Returns \c true if the topic filter \a lhs is lexically less than the topic
-    filter \a rhs; otherwise returns \c false.
+    filter \a rhs; otherwise returns \c false. Topic filters are compared by
+    their Unicode code points.
  */
 bool operator<(const QMqttTopicFilter &lhs, const QMqttTopicFilter &rhs) Q_DECL_NOTHROW
 {
-    return lhs.d->filter < rhs.d->filter;
+    return lhs.d->utf8 < rhs.d->utf8;
 }
 
 /*!
@@ -285,7 +313,7 @@ bool operator<(const QMqttTopicFilter &lhs, const QMqttTopicFilter &rhs) Q_DECL_
 */
 size_t qHash(const QMqttTopicFilter &filter, size_t seed) Q_DECL_NOTHROW
 {
-    return qHash(filter.d->filter, seed);
+    return qHash(filter.d->utf8, seed);
 }
 
 #ifndef QT_NO_DATASTREAM
@@ -7,6 +7,7 @@
 #include <QtMqtt/qmqttglobal.h>
 #include <QtMqtt/qmqtttopicname.h>
 
+#include <QtCore/QByteArray>
 #include <QtCore/QExplicitlySharedDataPointer>
 #include <QtCore/QMetaType>
 #include <QtCore/QString>
@@ -43,6 +44,9 @@ public:
     QString filter() const;
     void setFilter(const QString &filter);
 
+    QByteArray toUtf8() const;
+    static QMqttTopicFilter fromUtf8(const QByteArray &filter);
+
     QString sharedSubscriptionName() const;
 
     Q_REQUIRED_RESULT bool isValid() const;
@@ -54,6 +58,7 @@ public:
     friend Q_MQTT_EXPORT size_t qHash(const QMqttTopicFilter &filter, size_t seed) Q_DECL_NOTHROW;
 
 private:
+    friend class QMqttTopicFilterPrivate;
     QExplicitlySharedDataPointer<QMqttTopicFilterPrivate> d;
 };
 
@@ -0,0 +1,43 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTTOPICFILTER_P_H
+#define QMQTTTOPICFILTER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqtttopicfilter.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedData>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttTopicFilterPrivate : public QSharedData
+{
+public:
+    void setUtf8(const QByteArray &filter);
+
+    static inline const QMqttTopicFilterPrivate *get(const QMqttTopicFilter &filter)
+    {
+        return filter.d.constData();
+    }
+
+    // The filter is stored as sent on the wire and validated once per filter.
+    QByteArray utf8;
+    bool valid{false};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTTOPICFILTER_P_H
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
 #include "qmqtttopicname.h"
+#include "qmqtttopicname_p.h"
 
 #include <QtCore/QDebug>
 
@@ -15,11 +16,18 @@ QT_BEGIN_NAMESPACE
 
     \brief The QMqttTopicName class represents a MQTT topic name.
 
-    QMqttTopicName is a thin wrapper around a QString providing an expressive
+    QMqttTopicName is a thin wrapper around a string providing an expressive
     data type for MQTT topic names. Beside the benefits of having a strong type
     preventing unintended misuse, QMqttTopicName provides convenient functions
     related to topic names like isValid() or levels().
 
+    A topic name is stored in UTF-8, the encoding used by MQTT, and validated
+    once when its name is set. Publishing many messages to the same topic is
+    cheapest when the QMqttTopicName object is created once and reused for
+    every call to QMqttClient::publish(). Topic names of received messages are
+    only converted to a QString when name() is called, use toUtf8() to access
+    the topic without conversion.
+
     \sa QMqttTopicFilter
  */
 
@@ -29,18 +37,28 @@ QT_BEGIN_NAMESPACE
     operation is very fast and never fails.
  */
 
-class QMqttTopicNamePrivate : public QSharedData
+void QMqttTopicNamePrivate::setUtf8(const QByteArray &name)
 {
-public:
-    QString name;
-};
+    utf8 = name;
+
+    // UTF-8 multi-byte sequences never contain ASCII bytes, hence the
+    // encoded topic can be checked bytewise.
+    const qsizetype bytes = utf8.size();
+    valid = bytes > 0                                   // [MQTT-4.7.3-1]
+            && bytes < 65536;                           // [MQTT-4.7.3-3]
+    for (qsizetype i = 0; valid && i < bytes; ++i) {
+        const char c = utf8.at(i);
+        valid = c != '#' && c != '+'                    // [MQTT-4.7.1-1]
+                && c != '\0';                           // [MQTT-4.7.3-2]
+    }
+}
 
 /*!
     Creates a new MQTT topic name with the specified \a name.
  */
 QMqttTopicName::QMqttTopicName(const QString &name) : d(new QMqttTopicNamePrivate)
 {
-    d->name = name;
+    d->setUtf8(name.toUtf8());
 }
 
 /*!
@@ -48,7 +66,7 @@ QMqttTopicName::QMqttTopicName(const QString &name) : d(new QMqttTopicNamePrivat
  */
 QMqttTopicName::QMqttTopicName(const QLatin1String &name) : d(new QMqttTopicNamePrivate)
 {
-    d->name = name;
+    d->setUtf8(QString(name).toUtf8());
 }
 
 /*!
@@ -80,7 +98,7 @@ QMqttTopicName &QMqttTopicName::operator=(const QMqttTopicName &name)
  */
 QString QMqttTopicName::name() const
 {
-    return d->name;
+    return QString::fromUtf8(d->utf8);
 }
 
 /*!
@@ -89,7 +107,34 @@ QString QMqttTopicName::name() const
 void QMqttTopicName::setName(const QString &name)
 {
     d.detach();
-    d->name = name;
+    d->setUtf8(name.toUtf8());
+}
+
+/*!
+    \since 6.9
+
+    Returns the topic name encoded in UTF-8. This does not involve a
+    conversion, as topic names are stored in UTF-8.
+
+    \sa fromUtf8(), name()
+*/
+QByteArray QMqttTopicName::toUtf8() const
+{
+    return d->utf8;
+}
+
+/*!
+    \since 6.9
+
+    Creates a topic name from the UTF-8 encoded \a name.
+
+    \sa toUtf8()
+*/
+QMqttTopicName QMqttTopicName::fromUtf8(const QByteArray &name)
+{
+    QMqttTopicName result;
+    result.d->setUtf8(name);
+    return result;
 }
 
 /*!
@@ -98,12 +143,7 @@ void QMqttTopicName::setName(const QString &name)
  */
 bool QMqttTopicName::isValid() const
 {
-    const int bytes = d->name.size();
-    return bytes > 0                                    // [MQTT-4.7.3-1]
-           && bytes < 65536                             // [MQTT-4.7.3-3]
-           && !d->name.contains(QLatin1Char('#'))       // [MQTT-4.7.1-1]
-           && !d->name.contains(QLatin1Char('+'))       // [MQTT-4.7.1-1]
-           && !d->name.contains(QChar(QChar::Null));    // [MQTT-4.7.3-2]
+    return d->valid;
 }
 
 /*!
@@ -111,7 +151,7 @@ bool QMqttTopicName::isValid() const
  */
 int QMqttTopicName::levelCount() const
 {
-    return d->name.isEmpty() ? 0 : d->name.count(QLatin1Char('/')) + 1;
+    return d->utf8.isEmpty() ? 0 : int(d->utf8.count('/')) + 1;
 }
 
 /*!
@@ -119,7 +159,7 @@ int QMqttTopicName::levelCount() const
  */
 QStringList QMqttTopicName::levels() const
 {
-    return d->name.split(QLatin1Char('/'), Qt::KeepEmptyParts);
+    return name().split(QLatin1Char('/'), Qt::KeepEmptyParts);
 }
 
 /*!
@@ -131,7 +171,7 @@ QStringList QMqttTopicName::levels() const
  */
 bool operator==(const QMqttTopicName &lhs, const QMqttTopicName &rhs) Q_DECL_NOTHROW
 {
-    return (lhs.d == rhs.d) || (lhs.d->name == rhs.d->name);
+    return (lhs.d == rhs.d) || (lhs.d->utf8 == rhs.d->utf8);
 }
 
 /*!
@@ -147,11 +187,12 @@ bool operator==(const QMqttTopicName &lhs, const QMqttTopicName &rhs) Q_DECL_NOT
     \fn bool QMqttTopicName::operator<(const QMqttTopicName &lhs, const QMqttTopicName &rhs)
 
     Returns \c true if the topic name \a lhs is lexically less than the topic
-    name \a rhs; otherwise returns \c false.
+    name \a rhs; otherwise returns \c false. Topic names are compared by their
+    Unicode code points.
  */
 bool operator<(const QMqttTopicName &lhs, const QMqttTopicName &rhs) Q_DECL_NOTHROW
 {
-    return lhs.d->name < rhs.d->name;
+    return lhs.d->utf8 < rhs.d->utf8;
 }
 
 /*!
@@ -162,7 +203,7 @@ bool operator<(const QMqttTopicName &lhs, const QMqttTopicName &rhs) Q_DECL_NOTH
 */
 size_t qHash(const QMqttTopicName &name, size_t seed) Q_DECL_NOTHROW
 {
-    return qHash(name.d->name, seed);
+    return qHash(name.d->utf8, seed);
 }
 
 #ifndef QT_NO_DATASTREAM
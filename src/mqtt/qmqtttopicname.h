@@ -6,6 +6,7 @@
 
 #include <QtMqtt/qmqttglobal.h>
 
+#include <QtCore/QByteArray>
 #include <QtCore/QExplicitlySharedDataPointer>
 #include <QtCore/QMetaType>
 #include <QtCore/QString>
@@ -37,6 +38,9 @@ public:
     QString name() const;
     void setName(const QString &name);
 
+    QByteArray toUtf8() const;
+    static QMqttTopicName fromUtf8(const QByteArray &name);
+
     Q_REQUIRED_RESULT bool isValid() const;
     Q_REQUIRED_RESULT int levelCount() const;
     Q_REQUIRED_RESULT QStringList levels() const;
@@ -47,6 +51,7 @@ public:
     friend Q_MQTT_EXPORT size_t qHash(const QMqttTopicName &name, size_t seed) Q_DECL_NOTHROW;
 
 private:
+    friend class QMqttTopicNamePrivate;
     QExplicitlySharedDataPointer<QMqttTopicNamePrivate> d;
 };
 
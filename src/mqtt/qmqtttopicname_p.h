@@ -0,0 +1,44 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QMQTTTOPICNAME_P_H
+#define QMQTTTOPICNAME_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qmqtttopicname.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedData>
+#include <QtCore/QString>
+#include <QtCore/private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMqttTopicNamePrivate : public QSharedData
+{
+public:
+    void setUtf8(const QByteArray &name);
+
+    static inline const QMqttTopicNamePrivate *get(const QMqttTopicName &topic)
+    {
+        return topic.d.constData();
+    }
+
+    // The topic is stored as sent on the wire and validated once per name.
+    QByteArray utf8;
+    bool valid{false};
+};
+
+QT_END_NAMESPACE
+
+#endif // QMQTTTOPICNAME_P_H
@@ -4,10 +4,13 @@
 #include "broker_connection.h"
 
 #include <QtCore/QString>
+#include <QtCore/QTemporaryDir>
 #include <QtNetwork/QTcpServer>
 #include <QtTest/QtTest>
 #include <QtTest/QSignalSpy>
 #include <QtMqtt/QMqttClient>
+#include <QtMqtt/QMqttSessionStore>
+#include <QtMqtt/private/qmqttstatistics_p.h>
 
 #include <limits>
 
@@ -51,6 +54,18 @@ private Q_SLOTS:
     void subscriptionIdsOverlap();
     void keepAlive_data();
     void keepAlive();
+    void publishReceiveMaximum();
+    void resendOnSessionResume();
+    void resendReceiveMaximum();
+    void sessionStoreRestore();
+    void batch();
+    void subscriptionIdentifierDispatch();
+    void payloadSharing();
+    void messageHandler();
+    void postPublish();
+    void asyncCompletion();
+    void statistics();
+    void latencyHistogram();
 private:
     QProcess m_brokerProcess;
     QString m_testBroker;
@@ -127,6 +142,29 @@ void Tst_QMqttClient::getSetCheck()
     QCOMPARE(client.autoKeepAlive(), true);
     client.setAutoKeepAlive(false);
     QCOMPARE(client.autoKeepAlive(), false);
+
+    QSignalSpy messageReceivedSignalSpy(&client, &QMqttClient::messageReceivedSignalEnabledChanged);
+    QCOMPARE(client.isMessageReceivedSignalEnabled(), true);
+    client.setMessageReceivedSignalEnabled(false);
+    QCOMPARE(client.isMessageReceivedSignalEnabled(), false);
+    client.setMessageReceivedSignalEnabled(false);
+    QCOMPARE(messageReceivedSignalSpy.size(), 1);
+
+    QSignalSpy payloadSharingSpy(&client, &QMqttClient::payloadSharingEnabledChanged);
+    QCOMPARE(client.isPayloadSharingEnabled(), false);
+    client.setPayloadSharingEnabled(true);
+    QCOMPARE(client.isPayloadSharingEnabled(), true);
+    client.setPayloadSharingEnabled(true);
+    QCOMPARE(payloadSharingSpy.size(), 1);
+
+    QSignalSpy publishQueueLimitSpy(&client, &QMqttClient::publishQueueLimitChanged);
+    QCOMPARE(client.publishQueueLimit(), 0);
+    client.setPublishQueueLimit(10);
+    QCOMPARE(client.publishQueueLimit(), 10);
+    client.setPublishQueueLimit(-1);
+    QCOMPARE(client.publishQueueLimit(), 0);
+    client.setPublishQueueLimit(0);
+    QCOMPARE(publishQueueLimitSpy.size(), 2);
 }
 
 void Tst_QMqttClient::sendReceive_data()
@@ -886,6 +924,849 @@ void Tst_QMqttClient::keepAlive()
     QTRY_COMPARE(client.state(), QMqttClient::Disconnected);
 }
 
+// Transport replacing a broker. CONNECT is answered with the given CONNACK,
+// other incoming data is injected via feed().
+class ScriptedTransport : public QIODevice
+{
+public:
+    explicit ScriptedTransport(const QByteArray &connackPacket)
+        : connack(connackPacket)
+    {
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+    bool isSequential() const override
+    {
+        return true;
+    }
+    void feed(const QByteArray &data)
+    {
+        m_data.append(data);
+        emit readyRead();
+    }
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        const qint64 size = qMin<qint64>(maxlen, m_data.size());
+        memcpy(data, m_data.constData(), size_t(size));
+        m_data.remove(0, size);
+        return size;
+    }
+    qint64 writeData(const char *data, qint64 len) override
+    {
+        written.append(data, len);
+        ++writeCount;
+        const quint8 type = quint8(data[0]) & 0xF0;
+        if (type == 0x10)
+            feed(connack);
+        else if (type == 0x30)
+            ++publishCount;
+        return len;
+    }
+    QByteArray connack;
+    QByteArray written;
+    int publishCount{0};
+    int writeCount{0};
+private:
+    QByteArray m_data;
+};
+
+static QList<QByteArray> splitPackets(const QByteArray &stream)
+{
+    QList<QByteArray> packets;
+    qsizetype offset = 0;
+    while (offset < stream.size()) {
+        qsizetype length = 0;
+        qsizetype position = offset + 1;
+        int shift = 0;
+        quint8 byte = 0;
+        do {
+            byte = quint8(stream.at(position++));
+            length += qsizetype(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        packets.append(stream.mid(offset, position - offset + length));
+        offset = position + length;
+    }
+    return packets;
+}
+
+// Acknowledgment packet of the given type, followed by the given payload
+static QByteArray ackPacket(quint8 type, quint16 id, const QByteArray &payload = QByteArray())
+{
+    QByteArray packet;
+    packet.append(char(type));
+    packet.append(char(2 + payload.size()));
+    packet.append(char(id >> 8));
+    packet.append(char(id & 0xFF));
+    packet.append(payload);
+    return packet;
+}
+
+void Tst_QMqttClient::publishReceiveMaximum()
+{
+    // CONNACK announcing a Receive Maximum of 2
+    ScriptedTransport transport(QByteArray::fromHex("20060000032100" "02"));
+
+    QMqttClient client;
+    client.setProtocolVersion(QMqttClient::MQTT_5_0);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+    QCOMPARE(client.serverConnectionProperties().maximumReceive(), quint16(2));
+
+    QSignalSpy backpressureSpy(&client, &QMqttClient::publishBackpressureChanged);
+    client.setPublishQueueLimit(3);
+
+    const QMqttTopicName topic(QLatin1String("Qt/client/receiveMaximum"));
+    QList<qint32> ids;
+    for (int i = 0; i < 5; ++i)
+        ids.append(client.publish(topic, QByteArray("content"), 1));
+    QVERIFY(!ids.contains(-1));
+
+    // Only two messages are inflight, all others are queued
+    QCOMPARE(transport.publishCount, 2);
+    QCOMPARE(client.publishQueueSize(), 3);
+    QCOMPARE(backpressureSpy.size(), 1);
+    QCOMPARE(backpressureSpy.at(0).at(0).toBool(), true);
+
+    // The queue is full, QoS 0 messages are queued as well to keep the order
+    QCOMPARE(client.publish(topic, QByteArray("content"), 0), -1);
+
+    transport.feed(ackPacket(0x40, ids.at(0)));
+    QCOMPARE(transport.publishCount, 3);
+    QCOMPARE(client.publishQueueSize(), 2);
+
+    transport.feed(ackPacket(0x40, ids.at(1)) + ackPacket(0x40, ids.at(2)));
+    QCOMPARE(transport.publishCount, 5);
+    QCOMPARE(client.publishQueueSize(), 0);
+    QCOMPARE(backpressureSpy.size(), 2);
+    QCOMPARE(backpressureSpy.at(1).at(0).toBool(), false);
+    transport.feed(ackPacket(0x40, ids.at(3)) + ackPacket(0x40, ids.at(4)));
+
+    // A PUBREC with a failure reason code ends the QoS 2 exchange and
+    // releases its slot, no PUBREL is sent
+    const qint32 rejected = client.publish(topic, QByteArray("content"), 2);
+    const qint32 accepted = client.publish(topic, QByteArray("content"), 2);
+    const qint32 queued = client.publish(topic, QByteArray("content"), 1);
+    QVERIFY(rejected > 0 && accepted > 0 && queued > 0);
+    QCOMPARE(transport.publishCount, 7);
+    QCOMPARE(client.publishQueueSize(), 1);
+
+    transport.written.clear();
+    transport.feed(ackPacket(0x50, rejected, QByteArray::fromHex("80")));
+    QCOMPARE(transport.publishCount, 8);
+    QCOMPARE(client.publishQueueSize(), 0);
+    const QList<QByteArray> packets = splitPackets(transport.written);
+    QCOMPARE(packets.size(), 1);
+    QCOMPARE(quint8(packets.at(0).at(0)) & 0xF0, 0x30);
+
+    // A successful PUBREC keeps the slot until PUBCOMP
+    transport.written.clear();
+    transport.feed(ackPacket(0x50, accepted));
+    QCOMPARE(transport.written, ackPacket(0x62, accepted));
+    QVERIFY(client.publish(topic, QByteArray("content"), 1) > 0);
+    QCOMPARE(client.publishQueueSize(), 1);
+}
+
+void Tst_QMqttClient::resendOnSessionResume()
+{
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    client.setCleanSession(false);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    const QMqttTopicName topic(QLatin1String("Qt/client/resume"));
+    const qint32 unacknowledged = client.publish(topic, QByteArray("first"), 1);
+    const qint32 received = client.publish(topic, QByteArray("second"), 2);
+    const qint32 acknowledged = client.publish(topic, QByteArray("third"), 1);
+    transport.feed(ackPacket(0x50, received));
+    transport.feed(ackPacket(0x40, acknowledged));
+
+    // Connection loss, reconnect with the session present on the broker
+    transport.close();
+    QCOMPARE(client.state(), QMqttClient::Disconnected);
+    transport.written.clear();
+    transport.connack = QByteArray::fromHex("20020100");
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // CONNECT followed by the retransmissions in their original order
+    const QList<QByteArray> packets = splitPackets(transport.written);
+    QCOMPARE(packets.size(), 3);
+    QCOMPARE(quint8(packets.at(0).at(0)), quint8(0x10));
+    // PUBLISH, QoS 1, DUP set
+    QCOMPARE(quint8(packets.at(1).at(0)), quint8(0x3A));
+    QVERIFY(packets.at(1).endsWith("first"));
+    QCOMPARE(packets.at(2), ackPacket(0x62, received));
+}
+
+void Tst_QMqttClient::resendReceiveMaximum()
+{
+    // CONNACK announcing a Receive Maximum of 5
+    ScriptedTransport transport(QByteArray::fromHex("20060000032100" "05"));
+
+    QMqttClient client;
+    client.setProtocolVersion(QMqttClient::MQTT_5_0);
+    client.setCleanSession(false);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    const QMqttTopicName topic(QLatin1String("Qt/client/resendReceiveMaximum"));
+    QList<qint32> ids;
+    for (int i = 0; i < 4; ++i)
+        ids.append(client.publish(topic, QByteArray::number(i), 1));
+    QVERIFY(!ids.contains(-1));
+    QCOMPARE(transport.publishCount, 4);
+
+    // Reconnect with the session present and a Receive Maximum of 2
+    transport.close();
+    QCOMPARE(client.state(), QMqttClient::Disconnected);
+    transport.written.clear();
+    transport.publishCount = 0;
+    transport.connack = QByteArray::fromHex("20060100032100" "02");
+    QSignalSpy backpressureSpy(&client, &QMqttClient::publishBackpressureChanged);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // MQTT-3.3.4-9 Only the window is resent, the rest is queued
+    QCOMPARE(transport.publishCount, 2);
+    QCOMPARE(client.publishQueueSize(), 2);
+    QCOMPARE(backpressureSpy.size(), 1);
+
+    transport.feed(ackPacket(0x40, ids.at(0)));
+    QCOMPARE(transport.publishCount, 3);
+    transport.feed(ackPacket(0x40, ids.at(1)));
+    QCOMPARE(transport.publishCount, 4);
+    QCOMPARE(client.publishQueueSize(), 0);
+    QCOMPARE(backpressureSpy.size(), 2);
+
+    // All retransmissions keep their order and have the DUP flag set
+    const QList<QByteArray> packets = splitPackets(transport.written);
+    QList<QByteArray> publishes;
+    for (const QByteArray &packet : packets) {
+        if ((quint8(packet.at(0)) & 0xF0) == 0x30)
+            publishes.append(packet);
+    }
+    QCOMPARE(publishes.size(), 4);
+    for (int i = 0; i < 4; ++i) {
+        QCOMPARE(quint8(publishes.at(i).at(0)), quint8(0x3A));
+        QVERIFY(publishes.at(i).endsWith(QByteArray::number(i)));
+    }
+}
+
+void Tst_QMqttClient::sessionStoreRestore()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QLatin1String("session.log"));
+    const QMqttTopicName topic(QLatin1String("Qt/client/sessionStore"));
+
+    qint32 unacknowledged = -1;
+    qint32 received = -1;
+    {
+        QMqttFileSessionStore store(fileName);
+        ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+        QMqttClient client;
+        client.setCleanSession(false);
+        client.setSessionStore(&store);
+        client.setTransport(&transport, QMqttClient::IODevice);
+        client.connectToHost();
+        QCOMPARE(client.state(), QMqttClient::Connected);
+
+        unacknowledged = client.publish(topic, QByteArray("first"), 1);
+        received = client.publish(topic, QByteArray("second"), 2);
+        QVERIFY(unacknowledged > 0);
+        QVERIFY(received > 0);
+        transport.feed(ackPacket(0x50, received));
+    }
+
+    // Restart of the application, the broker resumes the session
+    QMqttFileSessionStore store(fileName);
+    ScriptedTransport transport(QByteArray::fromHex("20020100"));
+
+    QMqttClient client;
+    client.setCleanSession(false);
+    client.setSessionStore(&store);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // CONNECT followed by the restored messages in their original order
+    const QList<QByteArray> packets = splitPackets(transport.written);
+    QCOMPARE(packets.size(), 3);
+    QCOMPARE(quint8(packets.at(0).at(0)), quint8(0x10));
+    // PUBLISH, QoS 1, DUP set, same packet identifier
+    QCOMPARE(quint8(packets.at(1).at(0)), quint8(0x3A));
+    const qsizetype topicEnd = 4 + topic.name().size();
+    QCOMPARE(packets.at(1).mid(topicEnd, 2), ackPacket(0x40, unacknowledged).mid(2));
+    QVERIFY(packets.at(1).endsWith("first"));
+    QCOMPARE(packets.at(2), ackPacket(0x62, received));
+
+    // Restored packet identifiers are reserved
+    const qint32 next = client.publish(topic, QByteArray("third"), 1);
+    QVERIFY(next > 0);
+    QVERIFY(next != unacknowledged);
+    QVERIFY(next != received);
+
+    transport.feed(ackPacket(0x40, unacknowledged));
+    transport.feed(ackPacket(0x70, received));
+    QVERIFY(!store.load().isEmpty());
+    transport.feed(ackPacket(0x40, next));
+    QVERIFY(store.load().isEmpty());
+}
+
+void Tst_QMqttClient::batch()
+{
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    const QMqttTopicName topic(QLatin1String("Qt/client/batch"));
+    const auto packetTypes = [&transport]() {
+        QList<quint8> types;
+        for (const QByteArray &packet : splitPackets(transport.written))
+            types.append(quint8(packet.at(0)) & 0xF0);
+        return types;
+    };
+
+    // All messages of a batch are written at once
+    transport.written.clear();
+    transport.writeCount = 0;
+    client.beginBatch();
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(client.publish(topic, QByteArray("content"), 1) > 0);
+    QCOMPARE(transport.writeCount, 0);
+    QVERIFY(client.endBatch());
+    QCOMPARE(transport.writeCount, 1);
+    QCOMPARE(splitPackets(transport.written).size(), 10);
+
+    // Nested batches are written when the outermost one ends
+    transport.written.clear();
+    transport.writeCount = 0;
+    client.beginBatch();
+    client.beginBatch();
+    for (int i = 0; i < 3; ++i)
+        QVERIFY(client.publish(topic, QByteArray("content"), 0) == 0);
+    QVERIFY(client.endBatch());
+    QCOMPARE(transport.writeCount, 0);
+    QVERIFY(client.endBatch());
+    QCOMPARE(transport.writeCount, 1);
+    QCOMPARE(splitPackets(transport.written).size(), 3);
+    QVERIFY(!client.endBatch());
+
+    // Large batches are written once they exceed 64 KiB
+    transport.written.clear();
+    transport.writeCount = 0;
+    const QByteArray message(1000, 'x');
+    client.beginBatch();
+    for (int i = 0; i < 70; ++i)
+        QVERIFY(client.publish(topic, message, 0) == 0);
+    QCOMPARE(transport.writeCount, 1);
+    QVERIFY(transport.written.size() >= 64 * 1024);
+    QVERIFY(client.endBatch());
+    QCOMPARE(transport.writeCount, 2);
+    QCOMPARE(splitPackets(transport.written).size(), 70);
+
+    // Other control packets are not deferred, the batch is written first
+    transport.written.clear();
+    transport.writeCount = 0;
+    client.beginBatch();
+    QVERIFY(client.publish(topic, QByteArray("content"), 0) == 0);
+    QVERIFY(client.subscribe(QMqttTopicFilter(QLatin1String("Qt/client/#"))));
+    QCOMPARE(transport.writeCount, 2);
+    QCOMPARE(packetTypes(), QList<quint8>({0x30, 0x80}));
+    QVERIFY(client.endBatch());
+    QCOMPARE(transport.writeCount, 2);
+
+    // DISCONNECT follows the pending batch
+    transport.written.clear();
+    client.beginBatch();
+    QVERIFY(client.publish(topic, QByteArray("first"), 0) == 0);
+    QVERIFY(client.publish(topic, QByteArray("second"), 0) == 0);
+    client.disconnectFromHost();
+    QCOMPARE(packetTypes(), QList<quint8>({0x30, 0x30, 0xE0}));
+    QVERIFY(client.endBatch());
+}
+
+void Tst_QMqttClient::subscriptionIdentifierDispatch()
+{
+    ScriptedTransport transport(QByteArray::fromHex("2003000000"));
+
+    QMqttClient client;
+    client.setProtocolVersion(QMqttClient::MQTT_5_0);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // Subscriptions without a user chosen identifier get one assigned
+    transport.written.clear();
+    auto subA = client.subscribe(QMqttTopicFilter(QLatin1String("Qt/a/+")), 0);
+    auto subB = client.subscribe(QMqttTopicFilter(QLatin1String("Qt/b")), 0);
+    QVERIFY(subA && subB);
+    const QList<QByteArray> packets = splitPackets(transport.written);
+    QCOMPARE(packets.size(), 2);
+    // SUBSCRIBE, packet identifier, property length 2, subscription identifier
+    QCOMPARE(packets.at(0).mid(4, 3), QByteArray::fromHex("020b01"));
+    QCOMPARE(packets.at(1).mid(4, 3), QByteArray::fromHex("020b02"));
+
+    int receivedA = 0;
+    int receivedB = 0;
+    connect(subA, &QMqttSubscription::messageReceived, this, [&receivedA]() { ++receivedA; });
+    connect(subB, &QMqttSubscription::messageReceived, this, [&receivedB]() { ++receivedB; });
+
+    const auto publish = [](const QByteArray &topic, const QByteArray &properties) {
+        QByteArray body;
+        body.append(char(0)).append(char(topic.size())).append(topic);
+        body.append(char(properties.size())).append(properties);
+        body.append("content");
+        return QByteArray(1, char(0x30)) + char(body.size()) + body;
+    };
+
+    transport.feed(publish("Qt/a/x", QByteArray::fromHex("0b01")));
+    QCOMPARE(receivedA, 1);
+    QCOMPARE(receivedB, 0);
+
+    transport.feed(publish("Qt/b", QByteArray::fromHex("0b02")));
+    QCOMPARE(receivedA, 1);
+    QCOMPARE(receivedB, 1);
+
+    // Identifiers not matching the topic fall back to topic matching
+    transport.feed(publish("Qt/a/y", QByteArray::fromHex("0b02")));
+    QCOMPARE(receivedA, 2);
+    QCOMPARE(receivedB, 1);
+
+    // As do messages without identifiers
+    transport.feed(publish("Qt/b", QByteArray()));
+    QCOMPARE(receivedA, 2);
+    QCOMPARE(receivedB, 2);
+
+    // Identifiers are reused after unsubscribing
+    transport.written.clear();
+    client.unsubscribe(QMqttTopicFilter(QLatin1String("Qt/a/+")));
+    QByteArray unsuback = QByteArray::fromHex("b004");
+    unsuback.append(transport.written.mid(2, 2)).append(QByteArray::fromHex("0000"));
+    transport.feed(unsuback);
+    QCOMPARE(subA->state(), QMqttSubscription::Unsubscribed);
+
+    transport.written.clear();
+    QVERIFY(client.subscribe(QMqttTopicFilter(QLatin1String("Qt/c")), 0));
+    QCOMPARE(transport.written.mid(4, 3), QByteArray::fromHex("020b01"));
+}
+
+void Tst_QMqttClient::payloadSharing()
+{
+    ScriptedTransport transport(QByteArray::fromHex("2003000000"));
+
+    QMqttClient client;
+    client.setProtocolVersion(QMqttClient::MQTT_5_0);
+    client.setPayloadSharingEnabled(true);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    auto subscription = client.subscribe(QMqttTopicFilter(QLatin1String("Qt/#")), 0);
+    QVERIFY(subscription);
+    QList<QMqttMessage> messages;
+    connect(subscription, &QMqttSubscription::messageReceived, this,
+            [&messages](const QMqttMessage &message) { messages.append(message); });
+
+    // PUBLISH, QoS 0, topic "Qt/a", content type property
+    const auto publish = [](int index) {
+        const QByteArray contentType = "type/" + QByteArray::number(index);
+        QByteArray body = QByteArray::fromHex("00045174") + "/a";
+        body.append(char(3 + contentType.size())).append(char(0x03));
+        body.append(char(0)).append(char(contentType.size())).append(contentType);
+        body.append("payload " + QByteArray::number(index));
+        return QByteArray(1, char(0x30)) + char(body.size()) + body;
+    };
+
+    // Two messages and the beginning of a third one
+    const QByteArray third = publish(3);
+    transport.feed(publish(1) + publish(2) + third.first(10));
+    QCOMPARE(messages.size(), 2);
+
+    // The read buffer is compacted and appended to, the messages are not affected
+    transport.feed(third.sliced(10) + publish(4));
+    QCOMPARE(messages.size(), 4);
+    for (int i = 0; i < 4; ++i) {
+        const QMqttMessage &message = messages.at(i);
+        QCOMPARE(message.topic().name(), QLatin1String("Qt/a"));
+        QCOMPARE(message.payload(), "payload " + QByteArray::number(i + 1));
+        QCOMPARE(message.publishProperties().contentType(),
+                 QLatin1String("type/") + QString::number(i + 1));
+    }
+
+    // Received data overwriting the read buffer does not alter them either
+    transport.feed(publish(5) + publish(6));
+    QCOMPARE(messages.size(), 6);
+    QCOMPARE(messages.at(0).payload(), QByteArray("payload 1"));
+    QCOMPARE(messages.at(3).publishProperties().contentType(), QLatin1String("type/4"));
+}
+
+void Tst_QMqttClient::messageHandler()
+{
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    QList<QMqttMessage> handled;
+    auto sub = client.subscribe(QMqttTopicFilter(QLatin1String("Qt/handler/#")), 0,
+                                [&handled](const QMqttMessage &msg) { handled.append(msg); });
+    QVERIFY(sub);
+    QSignalSpy subscriptionSpy(sub, &QMqttSubscription::messageReceived);
+    QSignalSpy clientSpy(&client, &QMqttClient::messageReceived);
+
+    // PUBLISH, QoS 0, topic "Qt/handler/a", payload "content"
+    const QByteArray publish = QByteArray::fromHex("3015000c") + "Qt/handler/a" + "content";
+    transport.feed(publish);
+    QCOMPARE(handled.size(), 1);
+    QCOMPARE(handled.at(0).topic().name(), QLatin1String("Qt/handler/a"));
+    QCOMPARE(handled.at(0).payload(), QByteArray("content"));
+    QCOMPARE(subscriptionSpy.size(), 1);
+    QCOMPARE(clientSpy.size(), 1);
+
+    QVERIFY(client.isMessageReceivedSignalEnabled());
+    client.setMessageReceivedSignalEnabled(false);
+    transport.feed(publish);
+    QCOMPARE(handled.size(), 2);
+    QCOMPARE(subscriptionSpy.size(), 2);
+    QCOMPARE(clientSpy.size(), 1);
+
+    sub->setMessageHandler(QMqttSubscription::MessageHandler());
+    transport.feed(publish);
+    QCOMPARE(handled.size(), 2);
+    QCOMPARE(subscriptionSpy.size(), 3);
+
+    // A handler may replace itself, its captures stay valid until it returns
+    const QString expected = QLatin1String("Qt/handler/a");
+    sub->setMessageHandler([sub, expected, &handled](const QMqttMessage &msg) {
+        sub->setMessageHandler(QMqttSubscription::MessageHandler());
+        QCOMPARE(msg.topic().name(), expected);
+        handled.append(msg);
+    });
+    transport.feed(publish);
+    transport.feed(publish);
+    QCOMPARE(handled.size(), 3);
+    QCOMPARE(subscriptionSpy.size(), 5);
+}
+
+void Tst_QMqttClient::postPublish()
+{
+#if QT_CONFIG(future)
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    const QMqttTopicName topic(QLatin1String("Qt/client/post"));
+
+    // Not connected, the message is dropped in the thread of the client
+    QFuture<qint32> rejected = client.postPublish(topic, QByteArray("content"), 1);
+    QTRY_VERIFY(rejected.isFinished());
+    QCOMPARE(rejected.result(), -1);
+
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+    transport.written.clear();
+
+    const int threadCount = 4;
+    const int messageCount = 500;
+    QList<QList<QFuture<qint32>>> futures(threadCount);
+    QList<QThread *> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        // Short bursts while the client is sending, so that posting regularly
+        // races with draining. A lost wakeup leaves messages unsent.
+        threads.append(QThread::create([&client, &topic, &futures, t]() {
+            for (int i = 0; i < messageCount; ++i) {
+                const QByteArray payload = QByteArray::number(t) + '-' + QByteArray::number(i);
+                futures[t].append(client.postPublish(topic, payload, 1));
+                if (i % 5 == 4)
+                    QThread::usleep(10);
+            }
+        }));
+        threads.last()->start();
+    }
+
+    QTRY_COMPARE(transport.publishCount, threadCount * messageCount);
+    for (QThread *thread : std::as_const(threads)) {
+        QVERIFY(thread->wait());
+        delete thread;
+    }
+
+    QSet<qint32> ids;
+    for (const QList<QFuture<qint32>> &threadFutures : std::as_const(futures)) {
+        for (const QFuture<qint32> &future : threadFutures) {
+            QVERIFY(future.isFinished());
+            QVERIFY(future.result() > 0);
+            ids.insert(future.result());
+        }
+    }
+    QCOMPARE(ids.size(), threadCount * messageCount);
+
+    // Messages of each thread are sent in the order they have been posted
+    QList<int> next(threadCount, 0);
+    for (const QByteArray &packet : splitPackets(transport.written)) {
+        QCOMPARE(quint8(packet.at(0)), quint8(0x32));
+        // Fixed header, topic and packet identifier precede the payload
+        const QByteArray payload = packet.sliced(packet.indexOf("post") + 4 + 2);
+        const QList<QByteArray> parts = payload.split('-');
+        QCOMPARE(parts.size(), 2);
+        const int t = parts.at(0).toInt();
+        QCOMPARE(parts.at(1).toInt(), next[t]++);
+    }
+    QCOMPARE(next, QList<int>(threadCount, messageCount));
+#else
+    QSKIP("This test requires QFuture.");
+#endif
+}
+
+void Tst_QMqttClient::asyncCompletion()
+{
+#if QT_CONFIG(future)
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    const QMqttTopicName topic(QLatin1String("Qt/client/async"));
+
+    // Nothing can be sent while disconnected
+    QVERIFY(client.publishAsync(topic, QByteArray("content"), 1).isCanceled());
+    QVERIFY(client.subscribeAsync(QMqttTopicFilter(QLatin1String("Qt/client/#"))).isCanceled());
+
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // Packet identifier of the last packet written, which follows the topic for PUBLISH
+    const auto lastIdentifier = [&transport]() {
+        const QByteArray packet = splitPackets(transport.written).constLast();
+        qsizetype offset = 2;
+        if ((quint8(packet.at(0)) & 0xF0) == 0x30)
+            offset += 2 + (quint8(packet.at(2)) << 8 | quint8(packet.at(3)));
+        return quint16(quint8(packet.at(offset)) << 8 | quint8(packet.at(offset + 1)));
+    };
+
+    // SUBSCRIBE, resolved by SUBACK granting QoS 1
+    QFuture<QMqttSubscription *> subscribed =
+            client.subscribeAsync(QMqttTopicFilter(QLatin1String("Qt/client/#")), 1);
+    QVERIFY(!subscribed.isFinished());
+    const quint16 subscribeId = lastIdentifier();
+    // Subscribing again while the SUBACK is pending awaits the same SUBACK
+    QFuture<QMqttSubscription *> pending =
+            client.subscribeAsync(QMqttTopicFilter(QLatin1String("Qt/client/#")), 1);
+    QVERIFY(!pending.isFinished());
+    transport.feed(ackPacket(0x90, subscribeId, QByteArray::fromHex("01")));
+    QVERIFY(subscribed.isFinished());
+    QVERIFY(pending.isFinished());
+    QCOMPARE(pending.result(), subscribed.result());
+    QMqttSubscription *subscription = subscribed.result();
+    QVERIFY(subscription);
+    QCOMPARE(subscription->state(), QMqttSubscription::Subscribed);
+
+    // Subscribing again provides the existing subscription right away
+    QFuture<QMqttSubscription *> again =
+            client.subscribeAsync(QMqttTopicFilter(QLatin1String("Qt/client/#")), 1);
+    QVERIFY(again.isFinished());
+    QCOMPARE(again.result(), subscription);
+
+    // QoS 0 is not acknowledged
+    QFuture<QMqtt::ReasonCode> qos0 = client.publishAsync(topic, QByteArray("content"), 0);
+    QVERIFY(qos0.isFinished());
+    QCOMPARE(qos0.result(), QMqtt::ReasonCode::Success);
+
+    QFuture<QMqtt::ReasonCode> qos1 = client.publishAsync(topic, QByteArray("content"), 1);
+    const quint16 qos1Id = lastIdentifier();
+    QFuture<QMqtt::ReasonCode> qos2 = client.publishAsync(topic, QByteArray("content"), 2);
+    const quint16 qos2Id = lastIdentifier();
+    QVERIFY(!qos1.isFinished());
+    QVERIFY(!qos2.isFinished());
+
+    transport.feed(ackPacket(0x40, qos1Id));
+    QVERIFY(qos1.isFinished());
+    QCOMPARE(qos1.result(), QMqtt::ReasonCode::Success);
+
+    transport.feed(ackPacket(0x50, qos2Id));
+    QVERIFY(!qos2.isFinished());
+    transport.feed(ackPacket(0x70, qos2Id));
+    QVERIFY(qos2.isFinished());
+    QCOMPARE(qos2.result(), QMqtt::ReasonCode::Success);
+
+    // UNSUBSCRIBE, resolved by UNSUBACK
+    QFuture<QMqtt::ReasonCode> unsubscribed =
+            client.unsubscribeAsync(QMqttTopicFilter(QLatin1String("Qt/client/#")));
+    QVERIFY(!unsubscribed.isFinished());
+    transport.feed(ackPacket(0xb0, lastIdentifier()));
+    QVERIFY(unsubscribed.isFinished());
+    QCOMPARE(unsubscribed.result(), QMqtt::ReasonCode::Success);
+    QVERIFY(client.unsubscribeAsync(QMqttTopicFilter(QLatin1String("Qt/client/#"))).isCanceled());
+
+    // Requests awaiting an acknowledgment are canceled when the connection is lost
+    QFuture<QMqttSubscription *> lost =
+            client.subscribeAsync(QMqttTopicFilter(QLatin1String("Qt/lost")));
+    QVERIFY(!lost.isFinished());
+    QFuture<QMqttSubscription *> lostAgain =
+            client.subscribeAsync(QMqttTopicFilter(QLatin1String("Qt/lost")));
+    QVERIFY(!lostAgain.isFinished());
+    transport.close();
+    QCOMPARE(client.state(), QMqttClient::Disconnected);
+    QVERIFY(lost.isCanceled());
+    QVERIFY(lostAgain.isCanceled());
+#else
+    QSKIP("This test requires QFuture.");
+#endif
+}
+
+void Tst_QMqttClient::statistics()
+{
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    QCOMPARE(client.statistics().connections(), quint32(0));
+
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    QMqttStatistics stats = client.statistics();
+    QCOMPARE(stats.connections(), quint32(1));
+    QCOMPARE(stats.reconnections(), quint32(0));
+    QCOMPARE(stats.sentPackets(QMqttStatistics::Connect), quint64(1));
+    QCOMPARE(stats.sentBytes(QMqttStatistics::Connect), quint64(transport.written.size()));
+    QCOMPARE(stats.receivedPackets(QMqttStatistics::ConnectAcknowledge), quint64(1));
+    QCOMPARE(stats.receivedBytes(QMqttStatistics::ConnectAcknowledge), quint64(4));
+    QCOMPARE(stats.transportWrites(), quint64(1));
+
+    const auto identifier = [&transport]() {
+        return transport.written.mid(2, 2);
+    };
+
+    transport.written.clear();
+    auto subscription = client.subscribe(QMqttTopicFilter(QLatin1String("Qt/client/#")), 1);
+    QVERIFY(subscription);
+    QCOMPARE(client.statistics().pendingSubscribeAcknowledgments(), 1);
+    transport.feed(QByteArray::fromHex("9003") + identifier() + QByteArray::fromHex("01"));
+    QCOMPARE(subscription->state(), QMqttSubscription::Subscribed);
+    stats = client.statistics();
+    QCOMPARE(stats.pendingSubscribeAcknowledgments(), 0);
+    QCOMPARE(stats.receivedPackets(QMqttStatistics::SubscribeAcknowledge), quint64(1));
+    QCOMPARE(stats.receivedBytes(QMqttStatistics::SubscribeAcknowledge), quint64(5));
+
+    // PUBLISH, QoS 1, topic "Qt/client/statistics", payload "content"
+    transport.written.clear();
+    const qint32 id = client.publish(QMqttTopicName(QLatin1String("Qt/client/statistics")),
+                                     QByteArray("content"), 1);
+    QVERIFY(id > 0);
+    stats = client.statistics();
+    QCOMPARE(stats.pendingPublishAcknowledgments(), 1);
+    QCOMPARE(stats.sentPackets(QMqttStatistics::Publish), quint64(1));
+    QCOMPARE(stats.sentBytes(QMqttStatistics::Publish), quint64(33));
+
+    // PUBLISH, QoS 0, topic "Qt/client/a", payload "content"
+    transport.feed(QByteArray::fromHex("3014000b") + "Qt/client/a" + "content");
+    stats = client.statistics();
+    QCOMPARE(stats.receivedPackets(QMqttStatistics::Publish), quint64(1));
+    QCOMPARE(stats.receivedBytes(QMqttStatistics::Publish), quint64(22));
+    QCOMPARE(subscription->receivedMessageCount(), quint64(1));
+    QCOMPARE(subscription->receivedByteCount(), quint64(7));
+
+    // A packet split across reads is buffered until it is complete, the fixed
+    // header is consumed already
+    transport.feed(QByteArray::fromHex("3014000b") + "Qt/cl");
+    QCOMPARE(client.statistics().readBufferSize(), 7);
+    transport.feed(QByteArray("ient/a") + "content");
+    stats = client.statistics();
+    QCOMPARE(stats.readBufferSize(), 0);
+    QVERIFY(stats.readBufferPeak() >= 9);
+    QCOMPARE(stats.receivedPackets(QMqttStatistics::Publish), quint64(2));
+    QCOMPARE(subscription->receivedMessageCount(), quint64(2));
+
+    transport.feed(ackPacket(0x40, id));
+    stats = client.statistics();
+    QCOMPARE(stats.pendingPublishAcknowledgments(), 0);
+    QCOMPARE(stats.receivedPackets(QMqttStatistics::PublishAcknowledge), quint64(1));
+    QCOMPARE(stats.totalReceivedPackets(), quint64(5));
+
+    // Losing the connection is counted, it is not reset when connecting again
+    transport.close();
+    QCOMPARE(client.state(), QMqttClient::Disconnected);
+    stats = client.statistics();
+    QCOMPARE(stats.connectionLosses(), quint32(1));
+    QCOMPARE(stats.connections(), quint32(1));
+}
+
+void Tst_QMqttClient::latencyHistogram()
+{
+    // Every value is counted in a bucket whose width is at most 1/8 of it
+    const QMqttLatencyHistogram empty;
+    QCOMPARE(empty.count(), quint64(0));
+    QCOMPARE(empty.percentile(0.5), quint64(0));
+    for (quint64 value = 0; value < (quint64(1) << 20); value = value * 5 / 4 + 1) {
+        const int index = empty.bucketIndex(value);
+        QVERIFY(empty.bucketLowerBound(index) <= value);
+        QVERIFY(empty.bucketLowerBound(index + 1) > value);
+        QVERIFY((empty.bucketLowerBound(index + 1) - empty.bucketLowerBound(index)) * 8
+                <= qMax<quint64>(value, 16));
+    }
+    QCOMPARE(empty.bucketIndex(std::numeric_limits<quint64>::max()), empty.bucketCount() - 1);
+
+#ifdef QT_BUILD_INTERNAL
+    QMqttLatencyRecorder recorder;
+    for (qint64 value : {5, 5, 5, 1000})
+        recorder.record(value);
+    const QMqttLatencyHistogram histogram = recorder.snapshot();
+    QCOMPARE(histogram.count(), quint64(4));
+    QCOMPARE(histogram.maximum(), quint64(1000));
+    QCOMPARE(histogram.bucketValue(histogram.bucketIndex(5)), quint64(3));
+    QCOMPARE(histogram.percentile(0.5), quint64(5));
+    QCOMPARE(histogram.percentile(0.75), quint64(5));
+    QCOMPARE(histogram.percentile(1.), quint64(1000));
+    QCOMPARE(histogram.mean(), 253.75);
+#endif
+
+    // Round trips measured by the client
+    ScriptedTransport transport(QByteArray::fromHex("20020000"));
+
+    QMqttClient client;
+    client.setAutoKeepAlive(false);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    const QMqttTopicName topic(QLatin1String("Qt/client/latency"));
+
+    const qint32 qos1 = client.publish(topic, QByteArray("content"), 1);
+    QVERIFY(qos1 > 0);
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::PublishAcknowledge).count(), quint64(0));
+    transport.feed(ackPacket(0x40, qos1));
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::PublishAcknowledge).count(), quint64(1));
+
+    const qint32 qos2 = client.publish(topic, QByteArray("content"), 2);
+    QVERIFY(qos2 > 0);
+    transport.feed(ackPacket(0x50, qos2));
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::PublishReceived).count(), quint64(1));
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::PublishComplete).count(), quint64(0));
+    transport.feed(ackPacket(0x70, qos2));
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::PublishComplete).count(), quint64(1));
+
+    QVERIFY(client.requestPing());
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::PingResponse).count(), quint64(0));
+    transport.feed(QByteArray::fromHex("d000"));
+    const QMqttLatencyHistogram ping = client.latencyHistogram(QMqttStatistics::PingResponse);
+    QCOMPARE(ping.count(), quint64(1));
+    QCOMPARE(ping.bucketValue(ping.bucketIndex(ping.maximum())), quint64(1));
+
+    // Other packets are not acknowledged
+    QCOMPARE(client.latencyHistogram(QMqttStatistics::Subscribe).count(), quint64(0));
+}
+
 QTEST_MAIN(Tst_QMqttClient)
 
 #include "tst_qmqttclient.moc"
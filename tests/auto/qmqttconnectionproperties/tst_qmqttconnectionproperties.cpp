@@ -252,24 +252,35 @@ void tst_QMqttConnectionProperties::maximumTopicAlias()
         transportSpy.clear();
     }
 
-    // Verify non auto assignable defaults to old behavior
+    // Verify a new topic gets the alias of the least recently used topic
     QSignalSpy fullSpy(&client, SIGNAL(messageSent(qint32)));
     transportSpy.clear();
-    client.publish(QLatin1String("Qt/connprop/alias/full/with/long/topic/to/verify/bigger/size"), msgContent, 1);
+    const QLatin1String longTopic("Qt/connprop/alias/full/with/long/topic/to/verify/bigger/size");
+    client.publish(longTopic, msgContent, 1);
     QTRY_VERIFY(fullSpy.size() == 1);
     QVERIFY(transportSpy.size() == 1);
-    QVERIFY(transportSpy.at(0).at(0).toInt() > publishTransportSize);
+    const int longTopicSize = transportSpy.at(0).at(0).toInt();
+    QVERIFY(longTopicSize > publishTransportSize);
 
     // Verify alias is used at sending second time
     transportSpy.clear();
     fullSpy.clear();
 
-    client.publish(topicBase + QLatin1String("0"), msgContent, 1);
+    client.publish(longTopic, msgContent, 1);
     QTRY_VERIFY(fullSpy.size() == 1);
     QVERIFY(transportSpy.size() == 1);
     int usageSize = transportSpy.at(0).at(0).toInt();
     QVERIFY(usageSize < publishTransportSize);
 
+    // The least recently used topic has lost its alias
+    transportSpy.clear();
+    fullSpy.clear();
+
+    client.publish(topicBase + QLatin1String("0"), msgContent, 1);
+    QTRY_VERIFY(fullSpy.size() == 1);
+    QVERIFY(transportSpy.size() == 1);
+    QCOMPARE(transportSpy.at(0).at(0).toInt(), publishTransportSize);
+
     // Manually overwrite topic alias 1
     const QMqttTopicName overwrite(QLatin1String("Qt/connprop/alias/overwrite/with/long/topic/to/verify/reset"));
     QMqttPublishProperties overProp;
@@ -17,6 +17,8 @@ private Q_SLOTS:
     void cleanupTestCase();
     void header();
     void append();
+    void serialize_data();
+    void serialize();
     void simple_data();
     void simple();
 };
@@ -116,6 +118,51 @@ void Tst_QMqttControlPacket::append()
 #endif
 }
 
+void Tst_QMqttControlPacket::serialize_data()
+{
+    QTest::addColumn<int>("messageSize");
+    QTest::addColumn<QByteArray>("remainingLength");
+
+    // The topic "a/b" including its length prefix adds 5 bytes
+    QTest::newRow("empty") << 0 << QByteArray("\x05", 1);
+    QTest::newRow("1 byte length") << 122 << QByteArray("\x7F", 1);
+    QTest::newRow("2 byte length") << 123 << QByteArray("\x80\x01", 2);
+    QTest::newRow("3 byte length") << 16384 << QByteArray("\x85\x80\x01", 3);
+}
+
+void Tst_QMqttControlPacket::serialize()
+{
+#ifdef QT_BUILD_INTERNAL
+    QFETCH(int, messageSize);
+    QFETCH(QByteArray, remainingLength);
+
+    const QByteArray message(messageSize, 'm');
+    QMqttControlPacket packet(QMqttControlPacket::PUBLISH);
+    packet.append(QByteArray("a/b"));
+    packet.setApplicationMessage(message);
+
+    // The application message is not part of the payload
+    QCOMPARE(packet.payload().size(), 5);
+    QCOMPARE(packet.remainingLength(), quint32(5 + messageSize));
+
+    char fixedHeader[QMqttControlPacket::MaximumFixedHeaderSize];
+    const int fixedHeaderSize = packet.serializeFixedHeader(fixedHeader);
+    QByteArray expected(1, char(QMqttControlPacket::PUBLISH));
+    expected.append(remainingLength);
+    QCOMPARE(QByteArray(fixedHeader, fixedHeaderSize), expected);
+
+    expected.append(QByteArray("\x00\x03" "a/b", 5));
+    expected.append(message);
+    QCOMPARE(packet.serialize(), expected);
+    QCOMPARE(packet.serializePayload(), expected.mid(1));
+
+    packet.clear();
+    QVERIFY(packet.applicationMessage().isEmpty());
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
 void Tst_QMqttControlPacket::simple_data()
 {
     QTest::addColumn<QString>("data");
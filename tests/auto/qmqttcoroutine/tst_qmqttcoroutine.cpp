@@ -0,0 +1,241 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QIODevice>
+#include <QtMqtt/QMqttClient>
+#include <QtMqtt/qmqttcoroutine.h>
+#include <QtTest/QtTest>
+
+#include <exception>
+
+// Transport replacing a broker. CONNECT is answered with a CONNACK, all other
+// answers are injected via feed().
+class ScriptedTransport : public QIODevice
+{
+public:
+    ScriptedTransport() { open(QIODevice::ReadWrite | QIODevice::Unbuffered); }
+    bool isSequential() const override { return true; }
+    void feed(const QByteArray &data)
+    {
+        m_data.append(data);
+        emit readyRead();
+    }
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        const qint64 size = qMin<qint64>(maxlen, m_data.size());
+        memcpy(data, m_data.constData(), size_t(size));
+        m_data.remove(0, size);
+        return size;
+    }
+    qint64 writeData(const char *data, qint64 len) override
+    {
+        lastPacket = QByteArray(data, len);
+        if ((quint8(data[0]) & 0xF0) == 0x10)
+            feed(QByteArray::fromHex("20020000"));
+        return len;
+    }
+    // Packet identifier of the last SUBSCRIBE, UNSUBSCRIBE or PUBLISH written
+    quint16 lastIdentifier() const
+    {
+        qsizetype offset = 2;
+        if ((quint8(lastPacket.at(0)) & 0xF0) == 0x30)
+            offset += 2 + (quint8(lastPacket.at(2)) << 8 | quint8(lastPacket.at(3)));
+        return quint16(quint8(lastPacket.at(offset)) << 8 | quint8(lastPacket.at(offset + 1)));
+    }
+    QByteArray lastPacket;
+private:
+    QByteArray m_data;
+};
+
+static QByteArray ack(const char *type, quint16 id)
+{
+    QByteArray packet = QByteArray::fromHex(type);
+    packet.append(char(id >> 8));
+    packet.append(char(id & 0xFF));
+    return packet;
+}
+
+class Tst_QMqttCoroutine : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void connectSubscribePublish();
+    void streamEnds();
+    void previousHandlerRestored();
+};
+
+#ifdef QT_MQTT_HAS_COROUTINES
+// Minimal coroutine type, started eagerly and not awaitable itself
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+#if QT_CONFIG(future)
+struct Progress
+{
+    QMqttClient::ClientError connectResult{QMqttClient::UnknownError};
+    QMqttSubscription *subscription{nullptr};
+    QList<QByteArray> payloads;
+    std::optional<QMqtt::ReasonCode> published;
+    bool done{false};
+};
+
+static Task echo(QMqttClient *client, Progress *progress)
+{
+    progress->connectResult = co_await QMqtt::connectToHost(client);
+    if (progress->connectResult != QMqttClient::NoError)
+        co_return;
+
+    const std::optional<QMqttSubscription *> subscription =
+            co_await QMqtt::subscribe(client, QMqttTopicFilter(QLatin1String("Qt/in/#")), 1);
+    if (!subscription)
+        co_return;
+    progress->subscription = *subscription;
+
+    QMqttMessageStream stream(*subscription);
+    while (std::optional<QMqttMessage> message = co_await stream.next()) {
+        progress->payloads.append(message->payload());
+        if (progress->payloads.size() == 2)
+            break;
+    }
+
+    progress->published = co_await QMqtt::publish(client, QMqttTopicName(QLatin1String("Qt/out")),
+                                                  progress->payloads.join(), 1);
+    progress->done = true;
+}
+#endif // QT_CONFIG(future)
+
+static Task drain(QMqttSubscription *subscription, int *received, bool *ended)
+{
+    QMqttMessageStream stream(subscription);
+    while (co_await stream.next())
+        ++*received;
+    *ended = true;
+}
+
+static Task takeOne(QMqttSubscription *subscription, QByteArray *payload)
+{
+    QMqttMessageStream stream(subscription);
+    if (std::optional<QMqttMessage> message = co_await stream.next())
+        *payload = message->payload();
+}
+#endif
+
+void Tst_QMqttCoroutine::connectSubscribePublish()
+{
+#if defined(QT_MQTT_HAS_COROUTINES) && QT_CONFIG(future)
+    ScriptedTransport transport;
+    QMqttClient client;
+    client.setTransport(&transport, QMqttClient::IODevice);
+
+    Progress progress;
+    echo(&client, &progress);
+    QCOMPARE(progress.connectResult, QMqttClient::NoError);
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // Suspended until the SUBACK is received
+    QVERIFY(!progress.subscription);
+    transport.feed(ack("9003", transport.lastIdentifier()) + QByteArray::fromHex("01"));
+    QVERIFY(progress.subscription);
+    QCOMPARE(progress.subscription->state(), QMqttSubscription::Subscribed);
+
+    // PUBLISH, QoS 0, topic "Qt/in/a"
+    const QByteArray header = QByteArray::fromHex("300e0007") + "Qt/in/a";
+    transport.feed(header + "first");
+    QCOMPARE(progress.payloads, QList<QByteArray>{ "first" });
+    // The coroutine stops reading after the second message and deletes the
+    // stream from within its handler. The third message only reaches the
+    // signal.
+    QSignalSpy extraSpy(progress.subscription, &QMqttSubscription::messageReceived);
+    transport.feed(header + "other" + header + "extra");
+    QCOMPARE(progress.payloads, (QList<QByteArray>{ "first", "other" }));
+    QCOMPARE(extraSpy.size(), 2);
+
+    // Suspended until the PUBACK is received
+    QVERIFY(!progress.done);
+    QVERIFY(transport.lastPacket.endsWith("firstother"));
+    transport.feed(ack("4002", transport.lastIdentifier()));
+    QVERIFY(progress.done);
+    QVERIFY(progress.published);
+    QCOMPARE(*progress.published, QMqtt::ReasonCode::Success);
+
+    // The stream has been deleted and removed its handler
+    QSignalSpy spy(progress.subscription, &QMqttSubscription::messageReceived);
+    transport.feed(header + "after");
+    QCOMPARE(spy.size(), 1);
+    QCOMPARE(progress.payloads.size(), 2);
+#else
+    QSKIP("This test requires C++20 coroutine support and QFuture.");
+#endif
+}
+
+void Tst_QMqttCoroutine::streamEnds()
+{
+#ifdef QT_MQTT_HAS_COROUTINES
+    ScriptedTransport transport;
+    QMqttClient client;
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    QMqttSubscription *subscription = client.subscribe(QMqttTopicFilter(QLatin1String("Qt/in/#")));
+    QVERIFY(subscription);
+    transport.feed(ack("9003", transport.lastIdentifier()) + QByteArray::fromHex("00"));
+
+    int received = 0;
+    bool ended = false;
+    drain(subscription, &received, &ended);
+
+    const QByteArray header = QByteArray::fromHex("300e0007") + "Qt/in/a";
+    transport.feed(header + "first" + header + "other");
+    QCOMPARE(received, 2);
+    QVERIFY(!ended);
+
+    subscription->unsubscribe();
+    transport.feed(ack("b002", transport.lastIdentifier()));
+    QVERIFY(ended);
+#else
+    QSKIP("This test requires C++20 coroutine support.");
+#endif
+}
+
+void Tst_QMqttCoroutine::previousHandlerRestored()
+{
+#ifdef QT_MQTT_HAS_COROUTINES
+    ScriptedTransport transport;
+    QMqttClient client;
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    QList<QByteArray> handled;
+    QMqttSubscription *subscription =
+            client.subscribe(QMqttTopicFilter(QLatin1String("Qt/in/#")), 0,
+                             [&handled](const QMqttMessage &msg) { handled.append(msg.payload()); });
+    QVERIFY(subscription);
+    transport.feed(ack("9003", transport.lastIdentifier()) + QByteArray::fromHex("00"));
+
+    // The stream takes over the handler while it exists
+    QByteArray taken;
+    takeOne(subscription, &taken);
+    const QByteArray header = QByteArray::fromHex("300e0007") + "Qt/in/a";
+    transport.feed(header + "first" + header + "other");
+    QCOMPARE(taken, QByteArray("first"));
+    QCOMPARE(handled, QList<QByteArray>{ "other" });
+#else
+    QSKIP("This test requires C++20 coroutine support.");
+#endif
+}
+
+QTEST_MAIN(Tst_QMqttCoroutine)
+
+#include "tst_qmqttcoroutine.moc"
@@ -0,0 +1,169 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QList>
+#include <QtMqtt/private/qmqttinflighttable_p.h>
+#include <QtTest/QtTest>
+
+class Tst_QMqttInflightTable : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void allocateTake();
+    void transition();
+    void insert();
+    void removeAll();
+    void completion();
+};
+
+void Tst_QMqttInflightTable::allocateTake()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttInflightTable table;
+    QVERIFY(table.isEmpty());
+
+    const quint16 subscribe = table.allocate(QMqttInflightTable::SubscribeAck);
+    const quint16 publish = table.allocate(QMqttInflightTable::PublishAck);
+    QVERIFY(subscribe != 0);
+    QVERIFY(publish != 0);
+    QVERIFY(subscribe != publish);
+    QCOMPARE(table.count(), 2);
+    QCOMPARE(table.count(QMqttInflightTable::SubscribeAck), 1);
+    QCOMPARE(table.count(QMqttInflightTable::PublishAck), 1);
+
+    // Entries are only found in their own state
+    QVERIFY(table.find(publish, QMqttInflightTable::PublishAck));
+    QVERIFY(!table.find(publish, QMqttInflightTable::SubscribeAck));
+    QVERIFY(!table.find(4711, QMqttInflightTable::PublishAck));
+
+    table.find(publish, QMqttInflightTable::PublishAck)->sequence = 42;
+    QCOMPARE(table.take(publish, QMqttInflightTable::UnsubscribeAck).state, QMqttInflightTable::Free);
+    const QMqttInflightTable::Entry entry = table.take(publish, QMqttInflightTable::PublishAck);
+    QCOMPARE(entry.state, QMqttInflightTable::PublishAck);
+    QCOMPARE(entry.sequence, quint64(42));
+    QVERIFY(!table.find(publish, QMqttInflightTable::PublishAck));
+    QCOMPARE(table.count(QMqttInflightTable::PublishAck), 0);
+
+    QVERIFY(table.remove(subscribe, QMqttInflightTable::SubscribeAck));
+    QVERIFY(!table.remove(subscribe, QMqttInflightTable::SubscribeAck));
+    QVERIFY(table.isEmpty());
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttInflightTable::transition()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttInflightTable table;
+    const quint16 id = table.allocate(QMqttInflightTable::PublishAck);
+    table.find(id, QMqttInflightTable::PublishAck)->sequence = 7;
+
+    QVERIFY(!table.transition(id, QMqttInflightTable::SubscribeAck, QMqttInflightTable::PublishComplete));
+    QMqttInflightTable::Entry *entry =
+            table.transition(id, QMqttInflightTable::PublishAck, QMqttInflightTable::PublishComplete);
+    QVERIFY(entry);
+    QCOMPARE(entry->sequence, quint64(7));
+    QCOMPARE(table.count(QMqttInflightTable::PublishAck), 0);
+    QCOMPARE(table.count(QMqttInflightTable::PublishComplete), 1);
+    QVERIFY(table.find(id, QMqttInflightTable::PublishComplete));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttInflightTable::insert()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttInflightTable table;
+    QVERIFY(!table.insert(0, QMqttInflightTable::PublishAck));
+    QVERIFY(table.insert(2, QMqttInflightTable::PublishAck));
+    QVERIFY(table.insert(60000, QMqttInflightTable::PublishComplete));
+    QVERIFY(!table.insert(2, QMqttInflightTable::PublishComplete));
+    QCOMPARE(table.count(), 2);
+
+    // Allocation skips identifiers which are in use
+    QCOMPARE(table.allocate(QMqttInflightTable::SubscribeAck), quint16(1));
+    QCOMPARE(table.allocate(QMqttInflightTable::SubscribeAck), quint16(3));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttInflightTable::removeAll()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttInflightTable table;
+    for (int i = 0; i < 1000; ++i) {
+        table.allocate(i % 2 ? QMqttInflightTable::PublishAck
+                             : QMqttInflightTable::SubscribeAck);
+    }
+
+    int visited = 0;
+    table.forEach(QMqttInflightTable::PublishAck, [&visited](quint16 id, QMqttInflightTable::Entry &) {
+        QCOMPARE(id % 2, 0);
+        ++visited;
+    });
+    QCOMPARE(visited, 500);
+
+    QList<quint16> removed;
+    table.removeAll(QMqttInflightTable::SubscribeAck, [&removed](quint16 id, QMqttInflightTable::Entry &) {
+        removed.append(id);
+    });
+    QCOMPARE(removed.size(), 500);
+    QCOMPARE(table.count(), 500);
+    QCOMPARE(table.count(QMqttInflightTable::SubscribeAck), 0);
+    for (quint16 id : std::as_const(removed))
+        QVERIFY(!table.find(id, QMqttInflightTable::SubscribeAck));
+
+    table.clear();
+    QVERIFY(table.isEmpty());
+    QCOMPARE(table.allocate(QMqttInflightTable::PublishAck), quint16(1));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttInflightTable::completion()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttInflightTable table;
+
+    // Taking an entry hands over the completion, finishing it reports the result
+    QFutureInterface<int> acknowledged(QFutureInterfaceBase::Started);
+    const QFuture<int> acknowledgedFuture = acknowledged.future();
+    const quint16 first = table.allocate(QMqttInflightTable::PublishAck);
+    table.find(first, QMqttInflightTable::PublishAck)->completion = QMqttCompletion(acknowledged);
+    QMqttInflightTable::Entry entry = table.take(first, QMqttInflightTable::PublishAck);
+    QVERIFY(!acknowledgedFuture.isFinished());
+    QVERIFY(entry.completion.isPending());
+    entry.completion.finish(42);
+    QVERIFY(!entry.completion.isPending());
+    QVERIFY(acknowledgedFuture.isFinished());
+    QVERIFY(!acknowledgedFuture.isCanceled());
+    QCOMPARE(acknowledgedFuture.result(), 42);
+
+    // Entries dropped without an acknowledgment cancel their future
+    QFutureInterface<int> removed(QFutureInterfaceBase::Started);
+    const QFuture<int> removedFuture = removed.future();
+    const quint16 second = table.allocate(QMqttInflightTable::SubscribeAck);
+    table.find(second, QMqttInflightTable::SubscribeAck)->completion = QMqttCompletion(removed);
+    QVERIFY(table.remove(second, QMqttInflightTable::SubscribeAck));
+    QVERIFY(removedFuture.isFinished());
+    QVERIFY(removedFuture.isCanceled());
+
+    QFutureInterface<int> cleared(QFutureInterfaceBase::Started);
+    const QFuture<int> clearedFuture = cleared.future();
+    const quint16 third = table.allocate(QMqttInflightTable::PublishComplete);
+    table.find(third, QMqttInflightTable::PublishComplete)->completion = QMqttCompletion(cleared);
+    table.clear();
+    QVERIFY(clearedFuture.isCanceled());
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(Tst_QMqttInflightTable)
+
+#include "tst_qmqttinflighttable.moc"
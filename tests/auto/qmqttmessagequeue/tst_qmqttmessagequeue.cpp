@@ -0,0 +1,192 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QList>
+#include <QtCore/QThread>
+#include <QtMqtt/QMqttMessageQueue>
+#include <QtMqtt/private/qmqttmpscqueue_p.h>
+#include <QtMqtt/private/qmqttspscqueue_p.h>
+#include <QtTest/QtTest>
+
+class Tst_QMqttMessageQueue : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void spscQueue();
+    void spscQueueThreaded();
+    void mpscQueueThreaded();
+    void overflow();
+    void crossThread();
+    void handlerOutlivesQueue();
+};
+
+void Tst_QMqttMessageQueue::spscQueue()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttSpscQueue<int> queue(3);
+    QCOMPARE(queue.capacity(), quint32(4));
+    QVERIFY(queue.isEmpty());
+
+    // Wrap around the ring a few times
+    int next = 0;
+    int expected = 0;
+    for (int round = 0; round < 5; ++round) {
+        while (queue.push(int(next)))
+            ++next;
+        QCOMPARE(next - expected, 4);
+        int value = -1;
+        while (queue.pop(&value))
+            QCOMPARE(value, expected++);
+        QVERIFY(queue.isEmpty());
+    }
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttMessageQueue::spscQueueThreaded()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttSpscQueue<int> queue(64);
+    const int count = 200000;
+
+    QScopedPointer<QThread> producer(QThread::create([&queue]() {
+        for (int i = 0; i < count; ++i) {
+            while (!queue.push(int(i)))
+                QThread::yieldCurrentThread();
+        }
+    }));
+    producer->start();
+
+    int expected = 0;
+    while (expected < count) {
+        int value = -1;
+        if (queue.pop(&value))
+            QCOMPARE(value, expected++);
+        else
+            QThread::yieldCurrentThread();
+    }
+    QVERIFY(producer->wait());
+    QVERIFY(queue.isEmpty());
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttMessageQueue::mpscQueueThreaded()
+{
+#ifdef QT_BUILD_INTERNAL
+    // Small ring, producers regularly fall back to the overflow list
+    QMqttMpscQueue<int> queue(16);
+    const int producerCount = 4;
+    const int count = 100000;
+
+    QList<QThread *> producers;
+    for (int p = 0; p < producerCount; ++p) {
+        producers.append(QThread::create([&queue, p]() {
+            for (int i = 0; i < count; ++i)
+                queue.push(p * count + i);
+        }));
+        producers.last()->start();
+    }
+
+    QList<int> next(producerCount, 0);
+    int received = 0;
+    bool ordered = true;
+    const auto consume = [&next, &received, &ordered](int value) {
+        const int p = value / count;
+        ordered = ordered && value % count == next[p];
+        ++next[p];
+        ++received;
+    };
+    while (received < producerCount * count) {
+        queue.drain(consume);
+        QThread::yieldCurrentThread();
+    }
+    for (QThread *producer : std::as_const(producers)) {
+        QVERIFY(producer->wait());
+        delete producer;
+    }
+    queue.drain(consume);
+    QVERIFY(queue.isEmpty());
+    QVERIFY(ordered);
+    QCOMPARE(received, producerCount * count);
+    QCOMPARE(next, QList<int>(producerCount, count));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttMessageQueue::overflow()
+{
+    QMqttMessageQueue queue;
+    QSignalSpy spy(&queue, &QMqttMessageQueue::messagesAvailable);
+    const QMqttSubscription::MessageHandler handler = queue.handler();
+
+    // More messages than fit into the lock-free part of the queue. Messages
+    // compare equal only to their copies, which allows checking the order.
+    QList<QMqttMessage> sent;
+    for (int i = 0; i < 3000; ++i) {
+        sent.append(QMqttMessage());
+        handler(sent.last());
+    }
+    QTRY_COMPARE(spy.size(), 1);
+    QCOMPARE(queue.takeMessages(), sent);
+    QVERIFY(queue.takeMessages().isEmpty());
+
+    // A new notification is sent after the queue has been emptied
+    handler(QMqttMessage());
+    QTRY_COMPARE(spy.size(), 2);
+    QCOMPARE(queue.takeMessages().size(), 1);
+}
+
+void Tst_QMqttMessageQueue::crossThread()
+{
+    QMqttMessageQueue queue;
+    const QMqttSubscription::MessageHandler handler = queue.handler();
+
+    QList<QMqttMessage> sent;
+    for (int i = 0; i < 20000; ++i)
+        sent.append(QMqttMessage());
+
+    QList<QMqttMessage> received;
+    connect(&queue, &QMqttMessageQueue::messagesAvailable, this, [&queue, &received]() {
+        received.append(queue.takeMessages());
+    });
+
+    // Short bursts while the consumer is draining, so that the last message
+    // of a burst regularly races with takeMessages(). A lost notification
+    // leaves it in the queue until the test times out.
+    QScopedPointer<QThread> producer(QThread::create([&handler, &sent]() {
+        int burst = 0;
+        for (const QMqttMessage &message : std::as_const(sent)) {
+            handler(message);
+            if (++burst == 7) {
+                burst = 0;
+                QThread::usleep(10);
+            }
+        }
+    }));
+    producer->start();
+
+    QTRY_COMPARE(received.size(), sent.size());
+    QVERIFY(producer->wait());
+    QCOMPARE(received, sent);
+}
+
+void Tst_QMqttMessageQueue::handlerOutlivesQueue()
+{
+    QMqttSubscription::MessageHandler handler;
+    {
+        QMqttMessageQueue queue;
+        handler = queue.handler();
+    }
+    // The handler keeps the message, no notification is sent
+    handler(QMqttMessage());
+    QCoreApplication::processEvents();
+}
+
+QTEST_MAIN(Tst_QMqttMessageQueue)
+
+#include "tst_qmqttmessagequeue.moc"
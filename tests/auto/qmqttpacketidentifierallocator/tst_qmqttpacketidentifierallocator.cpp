@@ -0,0 +1,108 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtMqtt/private/qmqttpacketidentifierallocator_p.h>
+#include <QtTest/QtTest>
+
+class Tst_QMqttPacketIdentifierAllocator : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void allocateRelease();
+    void wrapAround();
+    void exhaustion();
+    void reserve();
+};
+
+void Tst_QMqttPacketIdentifierAllocator::allocateRelease()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttPacketIdentifierAllocator allocator;
+    QCOMPARE(allocator.count(), 0);
+    QVERIFY(!allocator.isAllocated(0));
+
+    QCOMPARE(allocator.allocate(), quint16(1));
+    QCOMPARE(allocator.allocate(), quint16(2));
+    QCOMPARE(allocator.allocate(), quint16(3));
+    QCOMPARE(allocator.count(), 3);
+    QVERIFY(allocator.isAllocated(2));
+
+    // Released identifiers are not reused before the range wraps
+    allocator.release(2);
+    QVERIFY(!allocator.isAllocated(2));
+    QCOMPARE(allocator.count(), 2);
+    QCOMPARE(allocator.allocate(), quint16(4));
+
+    // Releasing twice or releasing 0 has no effect
+    allocator.release(2);
+    allocator.release(0);
+    QCOMPARE(allocator.count(), 3);
+
+    allocator.clear();
+    QCOMPARE(allocator.count(), 0);
+    QCOMPARE(allocator.allocate(), quint16(1));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttPacketIdentifierAllocator::wrapAround()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttPacketIdentifierAllocator allocator;
+    for (int i = 1; i <= 65535; ++i) {
+        const quint16 id = allocator.allocate();
+        QCOMPARE(id, quint16(i));
+        if (i != 100)
+            allocator.release(id);
+    }
+    QCOMPARE(allocator.count(), 1);
+
+    // After 65535 the search starts over at 1, skipping the identifier in use
+    for (int i = 1; i < 100; ++i)
+        QCOMPARE(allocator.allocate(), quint16(i));
+    QCOMPARE(allocator.allocate(), quint16(101));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttPacketIdentifierAllocator::exhaustion()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttPacketIdentifierAllocator allocator;
+    for (int i = 1; i <= 65535; ++i)
+        QCOMPARE(allocator.allocate(), quint16(i));
+    QVERIFY(allocator.isExhausted());
+    QCOMPARE(allocator.allocate(), quint16(0));
+
+    allocator.release(4711);
+    QVERIFY(!allocator.isExhausted());
+    QCOMPARE(allocator.allocate(), quint16(4711));
+    QCOMPARE(allocator.allocate(), quint16(0));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttPacketIdentifierAllocator::reserve()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttPacketIdentifierAllocator allocator;
+    QVERIFY(!allocator.reserve(0));
+    QVERIFY(allocator.reserve(1));
+    QVERIFY(allocator.reserve(3));
+    QVERIFY(!allocator.reserve(3));
+    QCOMPARE(allocator.count(), 2);
+
+    QCOMPARE(allocator.allocate(), quint16(2));
+    QCOMPARE(allocator.allocate(), quint16(4));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(Tst_QMqttPacketIdentifierAllocator)
+
+#include "tst_qmqttpacketidentifierallocator.moc"
@@ -8,6 +8,7 @@
 #include <QtMqtt/QMqttClient>
 #include <QtMqtt/QMqttPublishProperties>
 #include <QtMqtt/QMqttSubscription>
+#include <QtMqtt/private/qmqttpublishproperties_p.h>
 
 class tst_QMqttPublishProperties : public QObject
 {
@@ -22,6 +23,7 @@ private Q_SLOTS:
     void getSet();
     void propertyConsistency();
     void topicAlias();
+    void propertyBlock();
 
 private:
     QProcess m_brokerProcess;
@@ -188,6 +190,54 @@ void tst_QMqttPublishProperties::topicAlias()
     // Connection gets killed
 }
 
+void tst_QMqttPublishProperties::propertyBlock()
+{
+#ifdef QT_BUILD_INTERNAL
+    QByteArray block;
+    block.append(char(0x23)).append(char(0x00)).append(char(0x07)); // Topic alias 7
+    block.append(char(0x26)) // User property
+         .append(char(0x00)).append(char(0x01)).append('k')
+         .append(char(0x00)).append(char(0x02)).append("va");
+    block.append(char(0x0b)).append(char(0x81)).append(char(0x01)); // Subscription id 129
+    block.append(char(0x08)).append(char(0x00)).append(char(0x01)).append('r'); // Response topic
+
+    QMqttPublishPropertyBlock::Summary summary;
+    QVERIFY(QMqttPublishPropertyBlock::validate(block, &summary));
+    QCOMPARE(summary.topicAlias, quint16(7));
+    QCOMPARE(summary.details, QMqttPublishProperties::TopicAlias
+                              | QMqttPublishProperties::UserProperty
+                              | QMqttPublishProperties::SubscriptionIdentifier
+                              | QMqttPublishProperties::ResponseTopic);
+    QCOMPARE(summary.subscriptionIdentifiers.size(), 1);
+    QCOMPARE(summary.subscriptionIdentifiers.at(0), quint32(129));
+
+    const QMqttPublishProperties decoded = QMqttPublishPropertyBlock::decode(block);
+    QCOMPARE(decoded.availableProperties(), summary.details);
+    QCOMPARE(decoded.topicAlias(), quint16(7));
+    QCOMPARE(decoded.userProperties().size(), 1);
+    QCOMPARE(decoded.userProperties().at(0).name(), QLatin1String("k"));
+    QCOMPARE(decoded.userProperties().at(0).value(), QLatin1String("va"));
+    QCOMPARE(decoded.subscriptionIdentifiers(), QList<quint32>{129});
+    QCOMPARE(decoded.responseTopic(), QLatin1String("r"));
+
+    // Empty blocks contain no properties
+    QVERIFY(QMqttPublishPropertyBlock::validate(QByteArrayView(), &summary));
+    QCOMPARE(summary.details, QMqttPublishProperties::PublishPropertyDetails());
+    QVERIFY(summary.subscriptionIdentifiers.isEmpty());
+    QCOMPARE(QMqttPublishPropertyBlock::decode(QByteArrayView()).availableProperties(),
+             QMqttPublishProperties::PublishPropertyDetails());
+
+    // Truncated and unknown properties are malformed
+    QVERIFY(!QMqttPublishPropertyBlock::validate(block.chopped(1), &summary));
+    QVERIFY(!QMqttPublishPropertyBlock::validate(QByteArray(1, char(0x7f)), &summary));
+    const char overlongId[] = { 0x0b, char(0x80), char(0x80), char(0x80), char(0x80), 0x01 };
+    QVERIFY(!QMqttPublishPropertyBlock::validate(QByteArrayView(overlongId, sizeof(overlongId)),
+                                                 &summary));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
 QTEST_MAIN(tst_QMqttPublishProperties)
 
 #include "tst_qmqttpublishproperties.moc"
@@ -0,0 +1,215 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTemporaryDir>
+#include <QtMqtt/QMqttSessionStore>
+#include <QtTest/QtTest>
+
+class Tst_QMqttSessionStore : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void storeLoad();
+    void replaceMessage();
+    void incompleteRecord();
+    void invalidFile();
+    void compaction();
+    void clear();
+    void deferredRemoval();
+
+private:
+    QString fileName() const;
+    QTemporaryDir m_dir;
+};
+
+static QByteArray publishPacket(int index)
+{
+    // PUBLISH, QoS 1, topic "a", packet identifier, payload
+    const QByteArray payload = QByteArray::number(index);
+    QByteArray packet;
+    packet.append(char(0x32));
+    packet.append(char(5 + payload.size()));
+    packet.append(QByteArray::fromHex("000161"));
+    packet.append(char(index >> 8));
+    packet.append(char(index & 0xFF));
+    packet.append(payload);
+    return packet;
+}
+
+void Tst_QMqttSessionStore::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString Tst_QMqttSessionStore::fileName() const
+{
+    return m_dir.filePath(QString::fromLatin1(QTest::currentTestFunction()) + QLatin1String(".log"));
+}
+
+void Tst_QMqttSessionStore::storeLoad()
+{
+    {
+        QMqttFileSessionStore store(fileName());
+        QVERIFY(store.load().isEmpty());
+        store.storeMessage(1, publishPacket(1));
+        store.storeMessage(2, publishPacket(2));
+        store.storeMessage(3, publishPacket(3));
+        store.releaseMessage(2);
+        store.removeMessage(1);
+        QVERIFY(store.sync());
+    }
+
+    QMqttFileSessionStore store(fileName());
+    const QList<QMqttSessionStore::Message> messages = store.load();
+    QCOMPARE(messages.size(), 2);
+    QCOMPARE(messages.at(0).packetIdentifier, quint16(2));
+    QCOMPARE(messages.at(0).released, true);
+    QCOMPARE(messages.at(0).packet, publishPacket(2));
+    QCOMPARE(messages.at(1).packetIdentifier, quint16(3));
+    QCOMPARE(messages.at(1).released, false);
+    QCOMPARE(messages.at(1).packet, publishPacket(3));
+}
+
+void Tst_QMqttSessionStore::replaceMessage()
+{
+    {
+        QMqttFileSessionStore store(fileName());
+        store.storeMessage(7, publishPacket(1));
+        store.storeMessage(8, publishPacket(2));
+        store.storeMessage(7, publishPacket(3));
+    }
+
+    // Replacing a message moves it to the end
+    QMqttFileSessionStore store(fileName());
+    const QList<QMqttSessionStore::Message> messages = store.load();
+    QCOMPARE(messages.size(), 2);
+    QCOMPARE(messages.at(0).packetIdentifier, quint16(8));
+    QCOMPARE(messages.at(1).packetIdentifier, quint16(7));
+    QCOMPARE(messages.at(1).packet, publishPacket(3));
+}
+
+void Tst_QMqttSessionStore::incompleteRecord()
+{
+    {
+        QMqttFileSessionStore store(fileName());
+        store.storeMessage(1, publishPacket(1));
+        store.storeMessage(2, publishPacket(2));
+    }
+
+    // Simulate a crash while writing the last record
+    QFile file(fileName());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 3));
+    file.close();
+
+    {
+        QMqttFileSessionStore store(fileName());
+        const QList<QMqttSessionStore::Message> messages = store.load();
+        QCOMPARE(messages.size(), 1);
+        QCOMPARE(messages.at(0).packet, publishPacket(1));
+
+        // New records are appended after the last valid record
+        store.storeMessage(3, publishPacket(3));
+    }
+
+    QMqttFileSessionStore store(fileName());
+    QCOMPARE(store.load().size(), 2);
+}
+
+void Tst_QMqttSessionStore::invalidFile()
+{
+    QFile file(fileName());
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("This is not a session store");
+    file.close();
+
+    QMqttFileSessionStore store(fileName());
+    QVERIFY(store.load().isEmpty());
+    store.storeMessage(1, publishPacket(1));
+    QVERIFY(store.sync());
+    QCOMPARE(store.load().size(), 1);
+}
+
+void Tst_QMqttSessionStore::compaction()
+{
+    qint64 uncompactedSize = 0;
+    {
+        QMqttFileSessionStore store(fileName());
+        store.storeMessage(1, publishPacket(1));
+        // Not enough removed messages to trigger a compaction
+        for (int i = 2; i < 400; ++i) {
+            store.storeMessage(quint16(i), publishPacket(i));
+            store.removeMessage(quint16(i));
+        }
+        QVERIFY(store.sync());
+        uncompactedSize = QFileInfo(fileName()).size();
+
+        for (int i = 400; i < 2000; ++i) {
+            store.storeMessage(quint16(i), publishPacket(i));
+            store.removeMessage(quint16(i));
+        }
+        store.storeMessage(2000, publishPacket(2000));
+        QVERIFY(store.sync());
+    }
+    QVERIFY(QFileInfo(fileName()).size() < uncompactedSize);
+
+    QMqttFileSessionStore store(fileName());
+    const QList<QMqttSessionStore::Message> messages = store.load();
+    QCOMPARE(messages.size(), 2);
+    QCOMPARE(messages.at(0).packetIdentifier, quint16(1));
+    QCOMPARE(messages.at(1).packetIdentifier, quint16(2000));
+}
+
+void Tst_QMqttSessionStore::clear()
+{
+    {
+        QMqttFileSessionStore store(fileName());
+        store.storeMessage(1, publishPacket(1));
+        store.storeMessage(2, publishPacket(2));
+        store.clear();
+        store.storeMessage(3, publishPacket(3));
+    }
+
+    QMqttFileSessionStore store(fileName());
+    const QList<QMqttSessionStore::Message> messages = store.load();
+    QCOMPARE(messages.size(), 1);
+    QCOMPARE(messages.at(0).packetIdentifier, quint16(3));
+}
+
+void Tst_QMqttSessionStore::deferredRemoval()
+{
+    {
+        QMqttFileSessionStore store(fileName());
+        store.storeMessage(1, publishPacket(1));
+        store.storeMessage(2, publishPacket(2));
+        QVERIFY(store.sync());
+        const qint64 syncedSize = QFileInfo(fileName()).size();
+
+        // Removing and releasing messages does not require another flush
+        store.releaseMessage(1);
+        store.removeMessage(2);
+        QVERIFY(store.sync());
+        QCOMPARE(QFileInfo(fileName()).size(), syncedSize);
+
+        // They are flushed along with the next stored message
+        store.storeMessage(3, publishPacket(3));
+        QVERIFY(store.sync());
+        QVERIFY(QFileInfo(fileName()).size() > syncedSize);
+        store.removeMessage(3);
+    }
+
+    // Pending changes are flushed when the store is destroyed
+    QMqttFileSessionStore store(fileName());
+    const QList<QMqttSessionStore::Message> messages = store.load();
+    QCOMPARE(messages.size(), 1);
+    QCOMPARE(messages.at(0).packetIdentifier, quint16(1));
+    QVERIFY(messages.at(0).released);
+}
+
+QTEST_APPLESS_MAIN(Tst_QMqttSessionStore)
+
+#include "tst_qmqttsessionstore.moc"
@@ -0,0 +1,141 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QList>
+#include <QtMqtt/QMqttTopicFilter>
+#include <QtMqtt/QMqttTopicName>
+#include <QtMqtt/private/qmqttsubscriptiontree_p.h>
+#include <QtTest/QtTest>
+
+class Tst_QMqttSubscriptionTree : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void insertRemove();
+    void matchesFilter_data();
+    void matchesFilter();
+    void dollarTopics();
+};
+
+static QMqttSubscription *fakeSubscription(quintptr index)
+{
+    // The tree only stores the pointers, they are never dereferenced.
+    return reinterpret_cast<QMqttSubscription *>(index + 1);
+}
+
+void Tst_QMqttSubscriptionTree::insertRemove()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttSubscriptionTree tree;
+    QVERIFY(tree.isEmpty());
+
+    tree.insert(QMqttTopicFilter("a/b"), fakeSubscription(0));
+    tree.insert(QMqttTopicFilter("a/+"), fakeSubscription(1));
+    tree.insert(QMqttTopicFilter("a/#"), fakeSubscription(2));
+    QCOMPARE(tree.size(), 3);
+
+    // Replacing an existing filter does not change the size
+    tree.insert(QMqttTopicFilter("a/b"), fakeSubscription(3));
+    QCOMPARE(tree.size(), 3);
+
+    QList<QMqttSubscription *> result;
+    tree.match("a/b", result);
+    QCOMPARE(result.size(), 3);
+    QVERIFY(result.contains(fakeSubscription(3)));
+    QVERIFY(!result.contains(fakeSubscription(0)));
+
+    QVERIFY(tree.remove(QMqttTopicFilter("a/+")));
+    QVERIFY(!tree.remove(QMqttTopicFilter("a/+")));
+    QVERIFY(!tree.remove(QMqttTopicFilter("a/c")));
+    QCOMPARE(tree.size(), 2);
+
+    result.clear();
+    tree.match("a/b", result);
+    QCOMPARE(result.size(), 2);
+
+    tree.clear();
+    QVERIFY(tree.isEmpty());
+    result.clear();
+    tree.match("a/b", result);
+    QVERIFY(result.isEmpty());
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttSubscriptionTree::matchesFilter_data()
+{
+    QTest::addColumn<QString>("topic");
+
+    QTest::newRow("plain") << QString::fromLatin1("sport/tennis/player1");
+    QTest::newRow("deep") << QString::fromLatin1("sport/tennis/player1/score/wimbledon");
+    QTest::newRow("parent") << QString::fromLatin1("sport");
+    QTest::newRow("trailing") << QString::fromLatin1("sport/");
+    QTest::newRow("leading") << QString::fromLatin1("/finance");
+    QTest::newRow("separator") << QString::fromLatin1("/");
+    QTest::newRow("similar") << QString::fromLatin1("xy/foo");
+    QTest::newRow("dollar") << QString::fromLatin1("$SYS/monitor/Clients");
+    QTest::newRow("utf8") << QString::fromUtf8("sport/ténnis/player1");
+}
+
+void Tst_QMqttSubscriptionTree::matchesFilter()
+{
+#ifdef QT_BUILD_INTERNAL
+    QFETCH(QString, topic);
+
+    const QStringList filters = {
+        "#", "/#", "+", "/+", "+/+", "+/#", "sport", "sport/", "sport/#", "sport/+",
+        "sport/tennis/+", "sport/tennis/player1/#", "sport/+/player1/#", "sport/+/+",
+        "+/tennis/#", "x/#", "$SYS/#", "$SYS/monitor/+", "+/monitor/Clients",
+        QString::fromUtf8("sport/ténnis/+")
+    };
+
+    QMqttSubscriptionTree tree;
+    for (int i = 0; i < filters.size(); ++i)
+        tree.insert(QMqttTopicFilter(filters.at(i)), fakeSubscription(i));
+
+    QList<QMqttSubscription *> result;
+    tree.match(topic.toUtf8(), result);
+
+    QList<QMqttSubscription *> expected;
+    for (int i = 0; i < filters.size(); ++i) {
+        if (QMqttTopicFilter(filters.at(i)).match(QMqttTopicName(topic),
+                                                  QMqttTopicFilter::WildcardsDontMatchDollarTopicMatchOption))
+            expected.append(fakeSubscription(i));
+    }
+
+    std::sort(result.begin(), result.end());
+    std::sort(expected.begin(), expected.end());
+    QCOMPARE(result, expected);
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttSubscriptionTree::dollarTopics()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttSubscriptionTree tree;
+    tree.insert(QMqttTopicFilter("#"), fakeSubscription(0));
+    tree.insert(QMqttTopicFilter("+/foo"), fakeSubscription(1));
+    tree.insert(QMqttTopicFilter("$SYS/#"), fakeSubscription(2));
+    tree.insert(QMqttTopicFilter("$SYS/+"), fakeSubscription(3));
+
+    QList<QMqttSubscription *> result;
+    tree.match("$SYS/foo", result);
+    std::sort(result.begin(), result.end());
+    QCOMPARE(result, QList<QMqttSubscription *>({fakeSubscription(2), fakeSubscription(3)}));
+
+    result.clear();
+    tree.match("SYS/foo", result);
+    std::sort(result.begin(), result.end());
+    QCOMPARE(result, QList<QMqttSubscription *>({fakeSubscription(0), fakeSubscription(1)}));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(Tst_QMqttSubscriptionTree)
+
+#include "tst_qmqttsubscriptiontree.moc"
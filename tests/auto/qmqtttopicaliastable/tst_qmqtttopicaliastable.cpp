@@ -0,0 +1,119 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtMqtt/QMqttTopicName>
+#include <QtMqtt/private/qmqtttopicaliastable_p.h>
+#include <QtTest/QtTest>
+
+class Tst_QMqttTopicAliasTable : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void assignFind();
+    void leastRecentlyUsed();
+    void setExplicitly();
+    void noAliases();
+};
+
+static QMqttTopicName topicName(int index)
+{
+    return QMqttTopicName(QLatin1String("site/device/%1").arg(index));
+}
+
+void Tst_QMqttTopicAliasTable::assignFind()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttTopicAliasTable table;
+    table.reset(10);
+    QCOMPARE(table.maximum(), quint16(10));
+
+    QCOMPARE(table.find(topicName(0)), quint16(0));
+    QCOMPARE(table.assign(topicName(0)), quint16(1));
+    QCOMPARE(table.assign(topicName(1)), quint16(2));
+    QCOMPARE(table.find(topicName(0)), quint16(1));
+    QCOMPARE(table.find(topicName(1)), quint16(2));
+    QCOMPARE(table.topic(2), topicName(1));
+    QCOMPARE(table.topic(3), QMqttTopicName());
+    QCOMPARE(table.size(), 2);
+
+    table.reset(10);
+    QCOMPARE(table.size(), 0);
+    QCOMPARE(table.find(topicName(0)), quint16(0));
+    QCOMPARE(table.assign(topicName(1)), quint16(1));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttTopicAliasTable::leastRecentlyUsed()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttTopicAliasTable table;
+    table.reset(3);
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(table.assign(topicName(i)), quint16(i + 1));
+
+    // Topic 0 is used frequently, hence topic 1 is replaced first
+    QCOMPARE(table.find(topicName(0)), quint16(1));
+    QCOMPARE(table.assign(topicName(3)), quint16(2));
+    QCOMPARE(table.find(topicName(1)), quint16(0));
+    QCOMPARE(table.topic(2), topicName(3));
+    QCOMPARE(table.size(), 3);
+
+    QCOMPARE(table.assign(topicName(4)), quint16(3));
+    QCOMPARE(table.assign(topicName(5)), quint16(1));
+    QCOMPARE(table.find(topicName(3)), quint16(2));
+    QCOMPARE(table.find(topicName(4)), quint16(3));
+    QCOMPARE(table.find(topicName(5)), quint16(1));
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttTopicAliasTable::setExplicitly()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttTopicAliasTable table;
+    table.reset(4);
+
+    QVERIFY(table.set(2, topicName(0)));
+    QVERIFY(!table.set(2, topicName(0)));
+    QCOMPARE(table.find(topicName(0)), quint16(2));
+
+    // Automatic assignment skips explicitly set aliases
+    QCOMPARE(table.assign(topicName(1)), quint16(1));
+    QCOMPARE(table.assign(topicName(2)), quint16(3));
+
+    // Overwriting an alias removes the previous topic
+    QVERIFY(table.set(3, topicName(3)));
+    QCOMPARE(table.find(topicName(2)), quint16(0));
+    QCOMPARE(table.find(topicName(3)), quint16(3));
+
+    // Moving a topic to another alias makes its previous alias available
+    QVERIFY(table.set(4, topicName(1)));
+    QCOMPARE(table.find(topicName(1)), quint16(4));
+    QCOMPARE(table.topic(1), QMqttTopicName());
+    QCOMPARE(table.assign(topicName(5)), quint16(1));
+    QCOMPARE(table.size(), 4);
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+void Tst_QMqttTopicAliasTable::noAliases()
+{
+#ifdef QT_BUILD_INTERNAL
+    QMqttTopicAliasTable table;
+    QCOMPARE(table.maximum(), quint16(0));
+    QCOMPARE(table.assign(topicName(0)), quint16(0));
+    QCOMPARE(table.find(topicName(0)), quint16(0));
+    QCOMPARE(table.size(), 0);
+#else
+    QSKIP("This test requires a Qt -developer-build.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(Tst_QMqttTopicAliasTable)
+
+#include "tst_qmqtttopicaliastable.moc"
@@ -14,6 +14,7 @@ class Tst_QMqttTopicFilter : public QObject
 private Q_SLOTS:
     void checkValidity();
     void matches();
+    void utf8();
 
     void usableWithQList();
     void usableWithQMap();
@@ -107,6 +108,21 @@ void Tst_QMqttTopicFilter::matches()
     QVERIFY(!QMqttTopicFilter{QLatin1String("x/y/#")}.match(QLatin1String("x")));
 }
 
+void Tst_QMqttTopicFilter::utf8()
+{
+    const QString filterString = QString::fromUtf8("haus/\xc3\xa4/+/t\xc3\xbcr");
+    const QMqttTopicFilter filter(filterString);
+    QCOMPARE(filter.toUtf8(), filterString.toUtf8());
+    QCOMPARE(QMqttTopicFilter::fromUtf8(filterString.toUtf8()), filter);
+    QCOMPARE(QMqttTopicFilter::fromUtf8(filterString.toUtf8()).filter(), filterString);
+    QVERIFY(QMqttTopicFilter::fromUtf8("a/+").isValid());
+    QVERIFY(!QMqttTopicFilter::fromUtf8("a/b+").isValid());
+
+    QVERIFY(filter.match(QMqttTopicName::fromUtf8("haus/\xc3\xa4/k\xc3\xbc" "che/t\xc3\xbcr")));
+    QVERIFY(!filter.match(QMqttTopicName::fromUtf8("haus/a/k\xc3\xbc" "che/t\xc3\xbcr")));
+    QVERIFY(QMqttTopicFilter::fromUtf8("\xc3\xa4/#").match(QMqttTopicName(QString(QChar(0x00E4)))));
+}
+
 void Tst_QMqttTopicFilter::usableWithQList()
 {
     const QMqttTopicFilter topic{"a/b"};
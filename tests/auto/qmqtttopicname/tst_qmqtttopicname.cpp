@@ -16,6 +16,7 @@ private Q_SLOTS:
     void checkLevelCount();
     void checkLevels_data();
     void checkLevels();
+    void utf8();
     void usableWithQList();
     void usableWithQMap();
     void usableWithQHash();
@@ -31,6 +32,19 @@ void Tst_QMqttTopicName::checkValidity()
     QVERIFY(!QMqttTopicName("/a/#").isValid());
     QVERIFY(!QMqttTopicName("/+/a").isValid());
     QVERIFY(!QMqttTopicName(QString(3, QChar(QChar::Null))).isValid());
+
+    // The length limit applies to the UTF-8 encoded topic [MQTT-4.7.3-3]
+    QVERIFY(QMqttTopicName(QString(65535, QLatin1Char('a'))).isValid());
+    QVERIFY(!QMqttTopicName(QString(65536, QLatin1Char('a'))).isValid());
+    QVERIFY(QMqttTopicName(QString(32767, QChar(0x00E4))).isValid());
+    QVERIFY(!QMqttTopicName(QString(32768, QChar(0x00E4))).isValid());
+
+    QMqttTopicName topic;
+    QVERIFY(!topic.isValid());
+    topic.setName(QLatin1String("a/b"));
+    QVERIFY(topic.isValid());
+    topic.setName(QLatin1String("a/#"));
+    QVERIFY(!topic.isValid());
 }
 
 void Tst_QMqttTopicName::checkLevelCount()
@@ -66,6 +80,23 @@ void Tst_QMqttTopicName::checkLevels()
     QCOMPARE(name.levels(), levels);
 }
 
+void Tst_QMqttTopicName::utf8()
+{
+    const QString nameString = QString::fromUtf8("haus/k\xc3\xbc" "che/\xf0\x9f\x92\xa1");
+    const QMqttTopicName name(nameString);
+    QCOMPARE(name.toUtf8(), nameString.toUtf8());
+    QCOMPARE(name.levelCount(), 3);
+
+    const QMqttTopicName fromUtf8 = QMqttTopicName::fromUtf8(nameString.toUtf8());
+    QCOMPARE(fromUtf8, name);
+    QCOMPARE(qHash(fromUtf8), qHash(name));
+    QCOMPARE(fromUtf8.name(), nameString);
+    QCOMPARE(fromUtf8.levels(), nameString.split(QLatin1Char('/')));
+    QVERIFY(fromUtf8.isValid());
+    QVERIFY(!QMqttTopicName::fromUtf8("a/#").isValid());
+    QVERIFY(!QMqttTopicName::fromUtf8(QByteArray()).isValid());
+}
+
 void Tst_QMqttTopicName::usableWithQList()
 {
     const QMqttTopicName topic{"a/b"};
@@ -0,0 +1,495 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QIODevice>
+#include <QtMqtt/QMqttClient>
+#include <QtTest/QtTest>
+
+// Transport replacing a broker. Any CONNECT is answered with a CONNACK,
+// incoming data is injected via feed(). With acknowledge set, PUBLISH and
+// PUBREL packets are answered like a broker would do, the answers are
+// collected until flushAnswers() is called.
+class FakeTransport : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit FakeTransport(QMqttClient::ProtocolVersion version = QMqttClient::MQTT_3_1_1,
+                           QObject *parent = nullptr)
+        : QIODevice(parent)
+        , m_version(version)
+    {
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    void feed(const QByteArray &data)
+    {
+        m_data = data;
+        m_offset = 0;
+        emit readyRead();
+    }
+
+    void flushAnswers()
+    {
+        QByteArray answers;
+        answers.swap(m_answers);
+        feed(answers);
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        const qint64 size = qMin<qint64>(maxlen, m_data.size() - m_offset);
+        memcpy(data, m_data.constData() + m_offset, size_t(size));
+        m_offset += size;
+        return size;
+    }
+
+    qint64 writeData(const char *data, qint64 len) override
+    {
+        ++writeCount;
+        bytesWritten += len;
+        // A write contains one or more complete packets
+        qint64 offset = 0;
+        while (offset < len) {
+            const quint8 header = quint8(data[offset]);
+            qint64 position = offset + 1;
+            qint64 remaining = 0;
+            int shift = 0;
+            quint8 byte = 0;
+            do {
+                byte = quint8(data[position++]);
+                remaining |= qint64(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            handlePacket(header, data + position);
+            offset = position + remaining;
+        }
+        return len;
+    }
+
+public:
+    bool acknowledge{false};
+    int writeCount{0};
+    qint64 bytesWritten{0};
+
+private:
+    void handlePacket(quint8 header, const char *body)
+    {
+        const quint8 type = header & 0xF0;
+        if (type == 0x10) { // CONNECT
+            static const char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+            static const char connack5[] = { 0x20, 0x03, 0x00, 0x00, 0x00 };
+            if (m_version == QMqttClient::MQTT_5_0)
+                feed(QByteArray::fromRawData(connack5, sizeof(connack5)));
+            else
+                feed(QByteArray::fromRawData(connack, sizeof(connack)));
+        } else if (acknowledge && type == 0x30) {
+            const quint8 qos = (header >> 1) & 0x03;
+            if (qos == 0)
+                return;
+            const int topicLength = quint8(body[0]) << 8 | quint8(body[1]);
+            answer(qos == 1 ? 0x40 : 0x50, body + 2 + topicLength);
+        } else if (acknowledge && type == 0x60) { // PUBREL
+            answer(0x70, body);
+        }
+    }
+
+    void answer(char type, const char *identifier)
+    {
+        m_answers.append(type);
+        m_answers.append(char(0x02));
+        m_answers.append(identifier, 2);
+    }
+
+    QMqttClient::ProtocolVersion m_version;
+    QByteArray m_data;
+    qint64 m_offset{0};
+    QByteArray m_answers;
+};
+
+// Reports messages and bytes per second of the measured code, in addition to
+// the time per iteration reported by QBENCHMARK.
+class Throughput
+{
+public:
+    ~Throughput()
+    {
+        if (m_nsecs <= 0)
+            return;
+        const double seconds = double(m_nsecs) / 1e9;
+        qInfo("%s: %.0f msgs/s, %.0f bytes/s", QTest::currentDataTag(),
+              double(m_messages) / seconds, double(m_bytes) / seconds);
+    }
+
+    void start() { m_timer.start(); }
+    void stop(qint64 messages, qint64 bytes)
+    {
+        m_nsecs += m_timer.nsecsElapsed();
+        m_messages += messages;
+        m_bytes += bytes;
+    }
+
+private:
+    QElapsedTimer m_timer;
+    qint64 m_nsecs{0};
+    qint64 m_messages{0};
+    qint64 m_bytes{0};
+};
+
+class Tst_Bench_QMqttConnection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void receiveStream_data();
+    void receiveStream();
+    void dispatch_data();
+    void dispatch();
+    void dispatchSubscriptions_data();
+    void dispatchSubscriptions();
+    void publish_data();
+    void publish();
+    void publishSerialization_data();
+    void publishSerialization();
+    void acknowledgedPublish_data();
+    void acknowledgedPublish();
+};
+
+static void appendVariableByteInteger(QByteArray &stream, quint32 value)
+{
+    do {
+        quint8 b = value % 128;
+        value /= 128;
+        if (value > 0)
+            b |= 0x80;
+        stream.append(char(b));
+    } while (value > 0);
+}
+
+// A subscription identifier of 0 is not included in the properties.
+static void appendPublish(QByteArray &stream, const QByteArray &topic, const QByteArray &payload,
+                          QMqttClient::ProtocolVersion version = QMqttClient::MQTT_3_1_1,
+                          quint32 subscriptionIdentifier = 0)
+{
+    QByteArray properties;
+    if (version == QMqttClient::MQTT_5_0) {
+        QByteArray property;
+        if (subscriptionIdentifier != 0) {
+            property.append(char(0x0B));
+            appendVariableByteInteger(property, subscriptionIdentifier);
+        }
+        appendVariableByteInteger(properties, quint32(property.size()));
+        properties.append(property);
+    }
+
+    stream.append(char(0x30)); // PUBLISH, QoS 0
+    appendVariableByteInteger(stream, quint32(2 + topic.size() + properties.size() + payload.size()));
+    stream.append(char(topic.size() >> 8));
+    stream.append(char(topic.size() & 0xFF));
+    stream.append(topic);
+    stream.append(properties);
+    stream.append(payload);
+}
+
+void Tst_Bench_QMqttConnection::receiveStream_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::addColumn<bool>("payloadSharing");
+    QTest::addColumn<QMqttClient::ProtocolVersion>("version");
+    for (const auto version : { QMqttClient::MQTT_3_1_1, QMqttClient::MQTT_5_0 }) {
+        const char *name = version == QMqttClient::MQTT_5_0 ? "5.0" : "3.1.1";
+        QTest::addRow("1KiB reads, %s", name) << 1024 << false << version;
+        QTest::addRow("16KiB reads, %s", name) << 16 * 1024 << false << version;
+        QTest::addRow("64KiB reads, %s", name) << 64 * 1024 << false << version;
+        QTest::addRow("1KiB reads, shared payload, %s", name) << 1024 << true << version;
+        QTest::addRow("16KiB reads, shared payload, %s", name) << 16 * 1024 << true << version;
+        QTest::addRow("64KiB reads, shared payload, %s", name) << 64 * 1024 << true << version;
+    }
+}
+
+void Tst_Bench_QMqttConnection::receiveStream()
+{
+    QFETCH(int, chunkSize);
+    QFETCH(bool, payloadSharing);
+    QFETCH(QMqttClient::ProtocolVersion, version);
+
+    FakeTransport transport(version);
+    QMqttClient client;
+    client.setProtocolVersion(version);
+    client.setPayloadSharingEnabled(payloadSharing);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+    QVERIFY(client.subscribe(QLatin1String("bench/#")));
+
+    // Synthetic stream of mostly small packets with a few large ones in between.
+    static const int payloadSizes[] = { 16, 48, 100, 16, 512, 32, 4096, 64 };
+    const int messageCount = 2000;
+    QByteArray stream;
+    for (int i = 0; i < messageCount; ++i) {
+        const int payloadSize = payloadSizes[i % std::size(payloadSizes)];
+        appendPublish(stream, QByteArrayLiteral("bench/sensor/value"), QByteArray(payloadSize, 'x'),
+                      version);
+    }
+
+    QList<QByteArray> chunks;
+    for (qsizetype offset = 0; offset < stream.size(); offset += chunkSize)
+        chunks.append(stream.mid(offset, chunkSize));
+
+    int received = 0;
+    connect(&client, &QMqttClient::messageReceived, this, [&received]() { ++received; });
+
+    Throughput throughput;
+    QBENCHMARK {
+        received = 0;
+        throughput.start();
+        for (const QByteArray &chunk : std::as_const(chunks))
+            transport.feed(chunk);
+        throughput.stop(messageCount, stream.size());
+    }
+    QCOMPARE(received, messageCount);
+}
+
+void Tst_Bench_QMqttConnection::dispatch_data()
+{
+    QTest::addColumn<bool>("handler");
+    QTest::addColumn<bool>("clientSignal");
+    QTest::newRow("signals") << false << true;
+    QTest::newRow("handler") << true << true;
+    QTest::newRow("handler, no client signal") << true << false;
+}
+
+void Tst_Bench_QMqttConnection::dispatch()
+{
+    QFETCH(bool, handler);
+    QFETCH(bool, clientSignal);
+
+    FakeTransport transport;
+    QMqttClient client;
+    client.setMessageReceivedSignalEnabled(clientSignal);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // One second worth of a 100k messages/s stream of small messages
+    const int messageCount = 100000;
+    QByteArray stream;
+    for (int i = 0; i < messageCount; ++i)
+        appendPublish(stream, QByteArrayLiteral("bench/sensor/value"), QByteArray(16, 'x'));
+
+    int received = 0;
+    if (handler) {
+        QVERIFY(client.subscribe(QLatin1String("bench/#"), 0,
+                                 [&received](const QMqttMessage &) { ++received; }));
+    } else {
+        QMqttSubscription *subscription = client.subscribe(QLatin1String("bench/#"));
+        QVERIFY(subscription);
+        connect(subscription, &QMqttSubscription::messageReceived, this,
+                [&received](const QMqttMessage &) { ++received; });
+    }
+
+    Throughput throughput;
+    QBENCHMARK {
+        received = 0;
+        throughput.start();
+        transport.feed(stream);
+        throughput.stop(messageCount, stream.size());
+    }
+    QCOMPARE(received, messageCount);
+}
+
+void Tst_Bench_QMqttConnection::dispatchSubscriptions_data()
+{
+    QTest::addColumn<int>("subscriptionCount");
+    QTest::addColumn<QMqttClient::ProtocolVersion>("version");
+    QTest::addColumn<bool>("identifiers");
+    for (const int count : { 1, 10, 100, 1000 }) {
+        QTest::addRow("%d subscriptions, 3.1.1", count) << count << QMqttClient::MQTT_3_1_1 << false;
+        QTest::addRow("%d subscriptions, 5.0", count) << count << QMqttClient::MQTT_5_0 << false;
+        QTest::addRow("%d subscriptions, 5.0, subscription identifiers", count)
+                << count << QMqttClient::MQTT_5_0 << true;
+    }
+}
+
+void Tst_Bench_QMqttConnection::dispatchSubscriptions()
+{
+    QFETCH(int, subscriptionCount);
+    QFETCH(QMqttClient::ProtocolVersion, version);
+    QFETCH(bool, identifiers);
+
+    FakeTransport transport(version);
+    QMqttClient client;
+    client.setProtocolVersion(version);
+    client.setMessageReceivedSignalEnabled(false);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    // Subscription identifiers are assigned in order of subscription,
+    // starting at 1. Without them in the PUBLISH, the topic is matched.
+    int received = 0;
+    QList<QByteArray> topics;
+    for (int i = 0; i < subscriptionCount; ++i) {
+        topics.append("bench/" + QByteArray::number(i) + "/value");
+        const QString filter = QLatin1String("bench/%1/+").arg(i);
+        QVERIFY(client.subscribe(QMqttTopicFilter(filter), 0,
+                                 [&received](const QMqttMessage &) { ++received; }));
+    }
+
+    const int messageCount = 100000;
+    QByteArray stream;
+    for (int i = 0; i < messageCount; ++i) {
+        const int index = i % subscriptionCount;
+        appendPublish(stream, topics.at(index), QByteArray(16, 'x'), version,
+                      identifiers ? quint32(index + 1) : 0);
+    }
+
+    Throughput throughput;
+    QBENCHMARK {
+        received = 0;
+        throughput.start();
+        transport.feed(stream);
+        throughput.stop(messageCount, stream.size());
+    }
+    QCOMPARE(received, messageCount);
+}
+
+void Tst_Bench_QMqttConnection::publish_data()
+{
+    QTest::addColumn<bool>("batch");
+    QTest::newRow("single writes") << false;
+    QTest::newRow("batch") << true;
+}
+
+void Tst_Bench_QMqttConnection::publish()
+{
+    QFETCH(bool, batch);
+
+    FakeTransport transport;
+    QMqttClient client;
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    const QMqttTopicName topic(QLatin1String("gateway/device/value"));
+    const QByteArray message(64, 'x');
+    const int messageCount = 10000;
+
+    Throughput throughput;
+    QBENCHMARK {
+        transport.writeCount = 0;
+        const qint64 bytesBefore = transport.bytesWritten;
+        throughput.start();
+        if (batch)
+            client.beginBatch();
+        for (int i = 0; i < messageCount; ++i)
+            client.publish(topic, message);
+        if (batch)
+            QVERIFY(client.endBatch());
+        throughput.stop(messageCount, transport.bytesWritten - bytesBefore);
+    }
+    if (batch)
+        QVERIFY(transport.writeCount < messageCount / 100);
+    else
+        QCOMPARE(transport.writeCount, messageCount);
+}
+
+void Tst_Bench_QMqttConnection::publishSerialization_data()
+{
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<QMqttClient::ProtocolVersion>("version");
+    QTest::addColumn<bool>("userProperties");
+    for (const int size : { 16, 1024, 64 * 1024 }) {
+        QTest::addRow("%d bytes, 3.1.1", size) << size << QMqttClient::MQTT_3_1_1 << false;
+        QTest::addRow("%d bytes, 5.0", size) << size << QMqttClient::MQTT_5_0 << false;
+        QTest::addRow("%d bytes, 5.0, user properties", size)
+                << size << QMqttClient::MQTT_5_0 << true;
+    }
+}
+
+void Tst_Bench_QMqttConnection::publishSerialization()
+{
+    QFETCH(int, payloadSize);
+    QFETCH(QMqttClient::ProtocolVersion, version);
+    QFETCH(bool, userProperties);
+
+    FakeTransport transport(version);
+    QMqttClient client;
+    client.setProtocolVersion(version);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+
+    const QMqttTopicName topic(QLatin1String("gateway/device/value"));
+    const QByteArray message(payloadSize, 'x');
+    QMqttPublishProperties properties;
+    if (userProperties) {
+        QMqttUserProperties user;
+        user.append(QMqttStringPair(QLatin1String("device"), QLatin1String("sensor-0042")));
+        user.append(QMqttStringPair(QLatin1String("unit"), QLatin1String("celsius")));
+        properties.setUserProperties(user);
+    }
+    const int messageCount = payloadSize > 1024 ? 1000 : 10000;
+
+    Throughput throughput;
+    QBENCHMARK {
+        const qint64 bytesBefore = transport.bytesWritten;
+        throughput.start();
+        for (int i = 0; i < messageCount; ++i)
+            client.publish(topic, properties, message);
+        throughput.stop(messageCount, transport.bytesWritten - bytesBefore);
+    }
+}
+
+void Tst_Bench_QMqttConnection::acknowledgedPublish_data()
+{
+    QTest::addColumn<quint8>("qos");
+    QTest::addColumn<QMqttClient::ProtocolVersion>("version");
+    QTest::addRow("QoS 1, 3.1.1") << quint8(1) << QMqttClient::MQTT_3_1_1;
+    QTest::addRow("QoS 1, 5.0") << quint8(1) << QMqttClient::MQTT_5_0;
+    QTest::addRow("QoS 2, 3.1.1") << quint8(2) << QMqttClient::MQTT_3_1_1;
+    QTest::addRow("QoS 2, 5.0") << quint8(2) << QMqttClient::MQTT_5_0;
+}
+
+void Tst_Bench_QMqttConnection::acknowledgedPublish()
+{
+    QFETCH(quint8, qos);
+    QFETCH(QMqttClient::ProtocolVersion, version);
+
+    FakeTransport transport(version);
+    QMqttClient client;
+    client.setProtocolVersion(version);
+    client.setTransport(&transport, QMqttClient::IODevice);
+    client.connectToHost();
+    QCOMPARE(client.state(), QMqttClient::Connected);
+    transport.acknowledge = true;
+
+    int sent = 0;
+    connect(&client, &QMqttClient::messageSent, this, [&sent]() { ++sent; });
+
+    const QMqttTopicName topic(QLatin1String("gateway/device/value"));
+    const QByteArray message(64, 'x');
+    // Stays below the default Receive Maximum, nothing is queued
+    const int messageCount = 10000;
+
+    // Time from publishing until the delivery has been completed, including
+    // the PUBREL sent for QoS 2.
+    Throughput throughput;
+    QBENCHMARK {
+        sent = 0;
+        const qint64 bytesBefore = transport.bytesWritten;
+        throughput.start();
+        for (int i = 0; i < messageCount; ++i)
+            client.publish(topic, message, qos);
+        transport.flushAnswers(); // PUBACK or PUBREC
+        if (qos == 2)
+            transport.flushAnswers(); // PUBCOMP
+        throughput.stop(messageCount, transport.bytesWritten - bytesBefore);
+    }
+    QCOMPARE(sent, messageCount);
+}
+
+QTEST_MAIN(Tst_Bench_QMqttConnection)
+
+#include "tst_bench_qmqttconnection.moc"
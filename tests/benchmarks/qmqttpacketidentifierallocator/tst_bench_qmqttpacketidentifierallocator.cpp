@@ -0,0 +1,103 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QHash>
+#include <QtCore/QQueue>
+#include <QtMqtt/private/qmqttpacketidentifierallocator_p.h>
+#include <QtTest/QtTest>
+
+class Tst_Bench_QMqttPacketIdentifierAllocator : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void hashProbing_data();
+    void hashProbing();
+    void bitmap_data();
+    void bitmap();
+
+private:
+    static void createData();
+};
+
+static const int operationCount = 100000;
+
+void Tst_Bench_QMqttPacketIdentifierAllocator::createData()
+{
+    // Number of identifiers in flight while acknowledgments arrive in order
+    QTest::addColumn<int>("inflight");
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("30000") << 30000;
+    QTest::newRow("65000") << 65000;
+}
+
+void Tst_Bench_QMqttPacketIdentifierAllocator::hashProbing_data()
+{
+    createData();
+}
+
+void Tst_Bench_QMqttPacketIdentifierAllocator::hashProbing()
+{
+    QFETCH(int, inflight);
+
+    // Previous approach: increment a counter and probe the pending hashes
+    // until an unused identifier is found.
+    QHash<quint16, int> pendingSubscriptions;
+    QHash<quint16, int> pendingUnsubscriptions;
+    QHash<quint16, int> pendingMessages;
+    QHash<quint16, int> pendingReleases;
+    quint16 counter = 1;
+    auto allocate = [&]() {
+        do {
+            counter = counter == 65535 ? 1 : counter + 1;
+        } while (pendingSubscriptions.contains(counter)
+                 || pendingUnsubscriptions.contains(counter)
+                 || pendingMessages.contains(counter)
+                 || pendingReleases.contains(counter));
+        pendingMessages.insert(counter, 0);
+        return counter;
+    };
+
+    QQueue<quint16> queue;
+    for (int i = 0; i < inflight; ++i)
+        queue.enqueue(allocate());
+
+    QBENCHMARK {
+        for (int i = 0; i < operationCount; ++i) {
+            pendingMessages.remove(queue.dequeue());
+            queue.enqueue(allocate());
+        }
+    }
+    QCOMPARE(queue.size(), inflight);
+}
+
+void Tst_Bench_QMqttPacketIdentifierAllocator::bitmap_data()
+{
+    createData();
+}
+
+void Tst_Bench_QMqttPacketIdentifierAllocator::bitmap()
+{
+#ifdef QT_BUILD_INTERNAL
+    QFETCH(int, inflight);
+
+    QMqttPacketIdentifierAllocator allocator;
+    QQueue<quint16> queue;
+    for (int i = 0; i < inflight; ++i)
+        queue.enqueue(allocator.allocate());
+
+    QBENCHMARK {
+        for (int i = 0; i < operationCount; ++i) {
+            allocator.release(queue.dequeue());
+            queue.enqueue(allocator.allocate());
+        }
+    }
+    QCOMPARE(allocator.count(), inflight);
+#else
+    QSKIP("This benchmark requires a Qt -developer-build.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(Tst_Bench_QMqttPacketIdentifierAllocator)
+
+#include "tst_bench_qmqttpacketidentifierallocator.moc"
@@ -0,0 +1,125 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtMqtt/QMqttTopicFilter>
+#include <QtMqtt/QMqttTopicName>
+#include <QtMqtt/private/qmqttsubscriptiontree_p.h>
+#include <QtTest/QtTest>
+
+class Tst_Bench_QMqttSubscriptionTree : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void linearScan_data();
+    void linearScan();
+    void subscriptionTree_data();
+    void subscriptionTree();
+
+private:
+    static void createData();
+    static QList<QMqttTopicFilter> createFilters(int count);
+};
+
+static QMqttSubscription *fakeSubscription(quintptr index)
+{
+    return reinterpret_cast<QMqttSubscription *>(index + 1);
+}
+
+void Tst_Bench_QMqttSubscriptionTree::createData()
+{
+    QTest::addColumn<int>("subscriptionCount");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("5000") << 5000;
+    QTest::newRow("20000") << 20000;
+}
+
+QList<QMqttTopicFilter> Tst_Bench_QMqttSubscriptionTree::createFilters(int count)
+{
+    // Mix of plain filters and wildcard filters as typically used by a
+    // gateway subscribing to many devices.
+    QList<QMqttTopicFilter> filters;
+    filters.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QString site = QString::number(i % 50);
+        const QString device = QString::number(i);
+        switch (i % 4) {
+        case 0:
+            filters.append(QMqttTopicFilter(QLatin1String("site/%1/device/%2/temperature").arg(site, device)));
+            break;
+        case 1:
+            filters.append(QMqttTopicFilter(QLatin1String("site/%1/device/%2/#").arg(site, device)));
+            break;
+        case 2:
+            filters.append(QMqttTopicFilter(QLatin1String("site/%1/+/%2/status").arg(site, device)));
+            break;
+        default:
+            filters.append(QMqttTopicFilter(QLatin1String("site/+/device/%1/+").arg(device)));
+            break;
+        }
+    }
+    return filters;
+}
+
+void Tst_Bench_QMqttSubscriptionTree::linearScan_data()
+{
+    createData();
+}
+
+void Tst_Bench_QMqttSubscriptionTree::linearScan()
+{
+    QFETCH(int, subscriptionCount);
+
+    QHash<QMqttTopicFilter, QMqttSubscription *> subscriptions;
+    const QList<QMqttTopicFilter> filters = createFilters(subscriptionCount);
+    for (int i = 0; i < filters.size(); ++i)
+        subscriptions.insert(filters.at(i), fakeSubscription(i));
+
+    const QMqttTopicName topic(QLatin1String("site/7/device/7/temperature"));
+    qsizetype matches = 0;
+    QBENCHMARK {
+        QList<QMqttSubscription *> subscribers;
+        for (const auto [key, value] : subscriptions.asKeyValueRange()) {
+            if (key.match(topic))
+                subscribers.append(value);
+        }
+        matches = subscribers.size();
+    }
+    QVERIFY(matches > 0);
+}
+
+void Tst_Bench_QMqttSubscriptionTree::subscriptionTree_data()
+{
+    createData();
+}
+
+void Tst_Bench_QMqttSubscriptionTree::subscriptionTree()
+{
+#ifdef QT_BUILD_INTERNAL
+    QFETCH(int, subscriptionCount);
+
+    QMqttSubscriptionTree tree;
+    const QList<QMqttTopicFilter> filters = createFilters(subscriptionCount);
+    for (int i = 0; i < filters.size(); ++i)
+        tree.insert(filters.at(i), fakeSubscription(i));
+
+    const QByteArray topic("site/7/device/7/temperature");
+    qsizetype matches = 0;
+    QBENCHMARK {
+        QList<QMqttSubscription *> subscribers;
+        tree.match(topic, subscribers);
+        matches = subscribers.size();
+    }
+    QVERIFY(matches > 0);
+#else
+    QSKIP("This benchmark requires a Qt -developer-build.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(Tst_Bench_QMqttSubscriptionTree)
+
+#include "tst_bench_qmqttsubscriptiontree.moc"
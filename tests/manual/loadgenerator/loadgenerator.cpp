@@ -0,0 +1,204 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "loadgenerator.h"
+
+#include <QCoreApplication>
+#include <QMqttMessage>
+#include <QMqttSubscription>
+#include <QTimer>
+#include <QtEndian>
+
+#include <chrono>
+
+qint64 timestamp()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+Worker::Worker(const Configuration &config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_random(quint32(QRandomGenerator::global()->generate()))
+    , m_payload(qMax(config.payloadSize, int(sizeof(qint64))), 'x')
+{
+}
+
+Worker::~Worker()
+{
+    for (Client *c : std::as_const(m_clients))
+        delete c->client;
+    qDeleteAll(m_clients);
+}
+
+void Worker::start(int firstPublisher, int publisherCount, int firstSubscriber,
+                   int subscriberCount)
+{
+    m_running = true;
+
+    // Spread the connection attempts over the ramp up period instead of
+    // hitting the broker with all of them at once
+    const int total = publisherCount + subscriberCount;
+    int n = 0;
+    const auto delay = [this, total, &n]() {
+        return total > 1 ? int(qint64(m_config.rampUpMilliseconds) * n++ / total) : 0;
+    };
+    const QString processId = QString::number(QCoreApplication::applicationPid());
+    for (int i = 0; i < subscriberCount; ++i) {
+        addClient(QLatin1String("qtmqtt-load-%1-sub-%2").arg(processId).arg(firstSubscriber + i),
+                  false, delay());
+    }
+    for (int i = 0; i < publisherCount; ++i) {
+        addClient(QLatin1String("qtmqtt-load-%1-pub-%2").arg(processId).arg(firstPublisher + i),
+                  true, delay());
+    }
+
+    // Tick often enough that a single publisher does not need to burst
+    const int interval = qBound(1, int(1000 / qMax(m_config.rate, 1.)), 10);
+    m_publishTimer = new QTimer(this);
+    m_publishTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_publishTimer, &QTimer::timeout, this, &Worker::publishDue);
+    m_publishTimer->start(interval);
+}
+
+void Worker::stop()
+{
+    m_running = false;
+    if (m_publishTimer)
+        m_publishTimer->stop();
+}
+
+void Worker::disconnectAll()
+{
+    for (Client *c : std::as_const(m_clients)) {
+        if (c->client->state() != QMqttClient::Disconnected)
+            c->client->disconnectFromHost();
+    }
+}
+
+void Worker::addClient(const QString &clientId, bool publisher, int connectDelay)
+{
+    auto *c = new Client;
+    c->publisher = publisher;
+    c->client = new QMqttClient(this);
+    c->client->setClientId(clientId);
+    c->client->setHostname(m_config.hostName);
+    c->client->setPort(m_config.port);
+    c->client->setProtocolVersion(m_config.protocolVersion);
+    c->client->setKeepAlive(m_config.keepAlive);
+    m_clients.append(c);
+
+    connect(c->client, &QMqttClient::stateChanged, this, [this, c](QMqttClient::ClientState s) {
+        clientStateChanged(c, s);
+    });
+    connect(c->client, &QMqttClient::errorChanged, this, [this](QMqttClient::ClientError e) {
+        if (e != QMqttClient::NoError)
+            m_statistics.errors.fetchAndAddRelaxed(1);
+    });
+    if (publisher) {
+        connect(c->client, &QMqttClient::messageSent, this, [this](qint32) {
+            m_statistics.acknowledged.fetchAndAddRelaxed(1);
+        });
+    }
+
+    QTimer::singleShot(connectDelay, c->client, [this, c]() {
+        if (m_running)
+            c->client->connectToHost();
+    });
+}
+
+void Worker::clientStateChanged(Client *c, QMqttClient::ClientState state)
+{
+    if (state == QMqttClient::Connected) {
+        c->connected = true;
+        m_statistics.connected.fetchAndAddRelaxed(1);
+        if (c->disconnectedTimer.isValid()) {
+            m_statistics.reconnects.fetchAndAddRelaxed(1);
+            m_statistics.reconnectTime.record(c->disconnectedTimer.nsecsElapsed() / 1000);
+            c->disconnectedTimer.invalidate();
+        }
+        if (c->publisher) {
+            // Messages missed while disconnected are not caught up
+            c->sent = 0;
+            c->publishTimer.start();
+        } else {
+            c->client->subscribe(QMqttTopicFilter(m_config.subscriptionFilter),
+                                 m_config.subscriptionQos,
+                                 [this](const QMqttMessage &message) {
+                messageReceived(message);
+            });
+        }
+        return;
+    }
+
+    if (state != QMqttClient::Disconnected)
+        return;
+
+    if (c->connected) {
+        c->connected = false;
+        m_statistics.connected.fetchAndSubRelaxed(1);
+        if (!m_running)
+            return;
+        m_statistics.disconnects.fetchAndAddRelaxed(1);
+        c->disconnectedTimer.start();
+    }
+
+    if (m_running) {
+        QTimer::singleShot(m_config.reconnectDelayMilliseconds, c->client, [this, c]() {
+            if (m_running && c->client->state() == QMqttClient::Disconnected)
+                c->client->connectToHost();
+        });
+    }
+}
+
+void Worker::publishDue()
+{
+    for (Client *c : std::as_const(m_clients)) {
+        if (!c->publisher || !c->connected)
+            continue;
+        const quint64 due = quint64(m_config.rate * double(c->publishTimer.nsecsElapsed()) / 1e9);
+        while (c->sent < due && c->connected)
+            publishOne(c);
+    }
+}
+
+void Worker::publishOne(Client *c)
+{
+    ++c->sent;
+
+    QByteArray payload = m_payload;
+    qToBigEndian(timestamp(), payload.data());
+
+    const QMqttTopicName &topic = m_config.topics.at(m_random.bounded(m_config.topics.size()));
+    if (c->client->publish(topic, payload, randomQos()) == -1)
+        m_statistics.publishFailed.fetchAndAddRelaxed(1);
+    else
+        m_statistics.published.fetchAndAddRelaxed(1);
+}
+
+void Worker::messageReceived(const QMqttMessage &message)
+{
+    const QByteArray &payload = message.payload();
+    if (payload.size() < qsizetype(sizeof(qint64))) {
+        m_statistics.malformed.fetchAndAddRelaxed(1);
+        return;
+    }
+    const qint64 sent = qFromBigEndian<qint64>(payload.constData());
+    m_statistics.received.fetchAndAddRelaxed(1);
+    m_statistics.receivedBytes.fetchAndAddRelaxed(quint64(payload.size()));
+    m_statistics.latency.record((timestamp() - sent) / 1000);
+}
+
+quint8 Worker::randomQos()
+{
+    const auto &weights = m_config.qosWeights;
+    const int total = weights[0] + weights[1] + weights[2];
+    int value = int(m_random.bounded(total));
+    for (quint8 qos = 0; qos < 2; ++qos) {
+        if (value < weights[qos])
+            return qos;
+        value -= weights[qos];
+    }
+    return 2;
+}
@@ -0,0 +1,177 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMqttClient>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QString>
+
+#include <array>
+
+struct Configuration
+{
+    QString hostName{QLatin1String("localhost")};
+    quint16 port{1883};
+    QMqttClient::ProtocolVersion protocolVersion{QMqttClient::MQTT_3_1_1};
+    quint16 keepAlive{60};
+    int publishers{1000};
+    int subscribers{1};
+    int threads{1};
+    // Topics are <prefix>/<l1>/<l2>/.../<ldepth>, each level having fanout values
+    QString topicPrefix{QLatin1String("qtmqtt/load")};
+    int topicDepth{2};
+    int topicFanout{10};
+    QString subscriptionFilter;
+    quint8 subscriptionQos{0};
+    int payloadSize{64};
+    // Relative weights for publishing with QoS 0, 1 and 2
+    std::array<int, 3> qosWeights{1, 0, 0};
+    double rate{1.0}; // Messages per second and publisher
+    int durationSeconds{30};
+    int reportSeconds{1};
+    int rampUpMilliseconds{5000};
+    int reconnectDelayMilliseconds{1000};
+    int drainMilliseconds{2000};
+
+    // Generated from the topic options, shared by all workers
+    QList<QMqttTopicName> topics;
+};
+
+// Log-linear histogram of microsecond values. Values below 64 have their own
+// bucket, above that each power of two is split into 32 buckets, giving a
+// relative error of about three percent. Buckets are relaxed atomics so that
+// the reporting thread can read them while a worker thread records values.
+class Histogram
+{
+public:
+    static constexpr int Linear = 64;
+    static constexpr int SubBuckets = 32;
+    static constexpr int BucketCount = Linear + SubBuckets * 40;
+    using Buckets = std::array<quint64, BucketCount>;
+
+    void record(qint64 value)
+    {
+        m_buckets[bucketIndex(value)].fetchAndAddRelaxed(1);
+    }
+
+    void addTo(Buckets *buckets) const
+    {
+        for (int i = 0; i < BucketCount; ++i)
+            (*buckets)[i] += m_buckets[i].loadRelaxed();
+    }
+
+    static int bucketIndex(qint64 value)
+    {
+        if (value < Linear)
+            return value < 0 ? 0 : int(value);
+        const int shift = qFloorLog2(quint64(value)) - 5;
+        const int index = Linear + (shift - 1) * SubBuckets + int(value >> shift) - SubBuckets;
+        return qMin(index, BucketCount - 1);
+    }
+
+    // Upper bound of the values counted in bucket index
+    static qint64 bucketValue(int index)
+    {
+        if (index < Linear)
+            return index;
+        const int shift = (index - Linear) / SubBuckets + 1;
+        const qint64 mantissa = (index - Linear) % SubBuckets + SubBuckets;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    static quint64 count(const Buckets &buckets)
+    {
+        quint64 total = 0;
+        for (quint64 c : buckets)
+            total += c;
+        return total;
+    }
+
+    static qint64 percentile(const Buckets &buckets, double fraction)
+    {
+        const quint64 total = count(buckets);
+        if (total == 0)
+            return 0;
+        const quint64 rank = qMax<quint64>(1, quint64(fraction * double(total) + 0.5));
+        quint64 seen = 0;
+        for (int i = 0; i < BucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= rank)
+                return bucketValue(i);
+        }
+        return bucketValue(BucketCount - 1);
+    }
+
+private:
+    std::array<QAtomicInteger<quint64>, BucketCount> m_buckets{};
+};
+
+// Counters of one worker, written by its thread and read by the reporter
+struct Statistics
+{
+    QAtomicInteger<quint64> published{0};
+    QAtomicInteger<quint64> publishFailed{0};
+    QAtomicInteger<quint64> acknowledged{0};
+    QAtomicInteger<quint64> received{0};
+    QAtomicInteger<quint64> receivedBytes{0};
+    QAtomicInteger<quint64> malformed{0};
+    QAtomicInteger<quint32> connected{0};
+    QAtomicInteger<quint32> disconnects{0};
+    QAtomicInteger<quint32> reconnects{0};
+    QAtomicInteger<quint32> errors{0};
+    Histogram latency;
+    Histogram reconnectTime;
+};
+
+// Owns a share of the clients and runs in a thread of its own. All clients are
+// driven by a single timer, which publishes the messages due for each
+// connected publisher since the last tick.
+class Worker : public QObject
+{
+public:
+    explicit Worker(const Configuration &config, QObject *parent = nullptr);
+    ~Worker() override;
+
+    void start(int firstPublisher, int publisherCount, int firstSubscriber, int subscriberCount);
+    void stop();
+    void disconnectAll();
+
+    const Statistics &statistics() const { return m_statistics; }
+
+private:
+    struct Client
+    {
+        QMqttClient *client{nullptr};
+        QElapsedTimer disconnectedTimer;
+        QElapsedTimer publishTimer;
+        quint64 sent{0};
+        bool publisher{false};
+        bool connected{false};
+    };
+
+    void addClient(const QString &clientId, bool publisher, int connectDelay);
+    void clientStateChanged(Client *client, QMqttClient::ClientState state);
+    void publishDue();
+    void publishOne(Client *client);
+    void messageReceived(const QMqttMessage &message);
+    quint8 randomQos();
+
+    const Configuration &m_config;
+    bool m_running{false};
+    QList<Client *> m_clients;
+    QTimer *m_publishTimer{nullptr};
+    QRandomGenerator m_random;
+    QByteArray m_payload;
+    alignas(64) Statistics m_statistics;
+};
+
+// Nanoseconds of a monotonic clock shared by all threads of the process
+qint64 timestamp();
+
+#endif // LOADGENERATOR_H
@@ -0,0 +1,450 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "loadgenerator.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QThread>
+#include <QTimer>
+
+#include <memory>
+#include <vector>
+
+static bool parseConfiguration(QCoreApplication *app, Configuration *config)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String(
+            "Qt MQTT load generator\n\n"
+            "Connects many publishing and subscribing clients to a broker and reports the "
+            "throughput, the end-to-end latency and the reconnects. Each payload starts with "
+            "the time it was published at, the latency is measured by the subscribers of the "
+            "same process."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption optionDebug("d",
+                                   QLatin1String("Enable debug messages / logging categories"));
+    parser.addOption(optionDebug);
+
+    QCommandLineOption optionHost("s",
+                                  QLatin1String("MQTT server to connect to. Defaults to localhost."),
+                                  QLatin1String("hostName"),
+                                  QLatin1String("localhost"));
+    parser.addOption(optionHost);
+
+    QCommandLineOption optionPort("p",
+                                  QLatin1String("Network port to connect to. Defaults to 1883."),
+                                  QLatin1String("hostPort"),
+                                  QLatin1String("1883"));
+    parser.addOption(optionPort);
+
+    QCommandLineOption optionVersion("V",
+                                     QLatin1String("Specify the protocol version. Options are "
+                                                   "mqtt31, mqtt311, mqtt5. Defaults to mqtt311."),
+                                     QLatin1String("protocolVersion"),
+                                     QLatin1String("mqtt311"));
+    parser.addOption(optionVersion);
+
+    QCommandLineOption optionKeepAlive("k",
+                                       QLatin1String("Specify the keep-alive value in seconds."),
+                                       QLatin1String("keepAlive"),
+                                       QLatin1String("60"));
+    parser.addOption(optionKeepAlive);
+
+    QCommandLineOption optionPublishers({"c", "publishers"},
+                                        QLatin1String("Number of publishing clients. "
+                                                      "Defaults to 1000."),
+                                        QLatin1String("count"),
+                                        QLatin1String("1000"));
+    parser.addOption(optionPublishers);
+
+    QCommandLineOption optionSubscribers("subscribers",
+                                         QLatin1String("Number of subscribing clients. Each of "
+                                                       "them receives all messages matching the "
+                                                       "filter. Defaults to 1."),
+                                         QLatin1String("count"),
+                                         QLatin1String("1"));
+    parser.addOption(optionSubscribers);
+
+    QCommandLineOption optionThreads({"j", "threads"},
+                                     QLatin1String("Number of threads the clients are "
+                                                   "distributed to. Defaults to the number of "
+                                                   "cores."),
+                                     QLatin1String("count"),
+                                     QString::number(QThread::idealThreadCount()));
+    parser.addOption(optionThreads);
+
+    QCommandLineOption optionTopicPrefix("topic-prefix",
+                                         QLatin1String("Root of the topic tree. Defaults to "
+                                                       "qtmqtt/load."),
+                                         QLatin1String("topic"),
+                                         QLatin1String("qtmqtt/load"));
+    parser.addOption(optionTopicPrefix);
+
+    QCommandLineOption optionTopicDepth("topic-depth",
+                                        QLatin1String("Number of levels below the root of the "
+                                                      "topic tree. Defaults to 2."),
+                                        QLatin1String("levels"),
+                                        QLatin1String("2"));
+    parser.addOption(optionTopicDepth);
+
+    QCommandLineOption optionTopicFanout("topic-fanout",
+                                         QLatin1String("Number of topics per level of the topic "
+                                                       "tree. Defaults to 10."),
+                                         QLatin1String("count"),
+                                         QLatin1String("10"));
+    parser.addOption(optionTopicFanout);
+
+    QCommandLineOption optionFilter("filter",
+                                    QLatin1String("Topic filter of the subscribers. Defaults to "
+                                                  "the whole topic tree."),
+                                    QLatin1String("filter"));
+    parser.addOption(optionFilter);
+
+    QCommandLineOption optionSubscriptionQos("subscription-qos",
+                                             QLatin1String("Quality of service level of the "
+                                                           "subscriptions. Defaults to 0."),
+                                             QLatin1String("qos"),
+                                             QLatin1String("0"));
+    parser.addOption(optionSubscriptionQos);
+
+    QCommandLineOption optionPayloadSize({"l", "payload-size"},
+                                         QLatin1String("Payload size in bytes, at least 8. "
+                                                       "Defaults to 64."),
+                                         QLatin1String("bytes"),
+                                         QLatin1String("64"));
+    parser.addOption(optionPayloadSize);
+
+    QCommandLineOption optionQosMix({"q", "qos-mix"},
+                                    QLatin1String("Relative weights of publishing with QoS 0, 1 "
+                                                  "and 2, for instance 80,15,5. Defaults to "
+                                                  "1,0,0."),
+                                    QLatin1String("weights"),
+                                    QLatin1String("1,0,0"));
+    parser.addOption(optionQosMix);
+
+    QCommandLineOption optionRate({"r", "rate"},
+                                  QLatin1String("Messages per second of each publisher. "
+                                                "Defaults to 1."),
+                                  QLatin1String("rate"),
+                                  QLatin1String("1"));
+    parser.addOption(optionRate);
+
+    QCommandLineOption optionDuration({"t", "duration"},
+                                      QLatin1String("Seconds to publish for. Defaults to 30."),
+                                      QLatin1String("seconds"),
+                                      QLatin1String("30"));
+    parser.addOption(optionDuration);
+
+    QCommandLineOption optionInterval("interval",
+                                      QLatin1String("Seconds between two reports. Defaults to "
+                                                    "1."),
+                                      QLatin1String("seconds"),
+                                      QLatin1String("1"));
+    parser.addOption(optionInterval);
+
+    QCommandLineOption optionRampUp("ramp-up",
+                                    QLatin1String("Milliseconds to spread the initial connection "
+                                                  "attempts over. Defaults to 5000."),
+                                    QLatin1String("milliseconds"),
+                                    QLatin1String("5000"));
+    parser.addOption(optionRampUp);
+
+    QCommandLineOption optionReconnectDelay("reconnect-delay",
+                                            QLatin1String("Milliseconds to wait before "
+                                                          "reconnecting a disconnected client. "
+                                                          "Defaults to 1000."),
+                                            QLatin1String("milliseconds"),
+                                            QLatin1String("1000"));
+    parser.addOption(optionReconnectDelay);
+
+    parser.process(*app);
+
+    const auto toInt = [&parser](const QCommandLineOption &option, int minimum, int *value) {
+        bool ok = false;
+        *value = parser.value(option).toInt(&ok);
+        if (!ok || *value < minimum) {
+            qWarning() << "Invalid value specified for" << option.names().constLast() << ":"
+                       << parser.value(option);
+            return false;
+        }
+        return true;
+    };
+
+    int value = 0;
+    config->hostName = parser.value(optionHost);
+    if (!toInt(optionPort, 1, &value) || value > 65535)
+        return false;
+    config->port = quint16(value);
+    if (!toInt(optionKeepAlive, 0, &value) || value > 65535)
+        return false;
+    config->keepAlive = quint16(value);
+
+    const QString version = parser.value(optionVersion);
+    if (version == QLatin1String("mqtt31")) {
+        config->protocolVersion = QMqttClient::MQTT_3_1;
+    } else if (version == QLatin1String("mqtt311")) {
+        config->protocolVersion = QMqttClient::MQTT_3_1_1;
+    } else if (version == QLatin1String("mqtt5")) {
+        config->protocolVersion = QMqttClient::MQTT_5_0;
+    } else {
+        qWarning() << "Invalid protocol version specified:" << version;
+        return false;
+    }
+
+    if (!toInt(optionPublishers, 0, &config->publishers)
+            || !toInt(optionSubscribers, 0, &config->subscribers)
+            || !toInt(optionThreads, 1, &config->threads)
+            || !toInt(optionTopicDepth, 0, &config->topicDepth)
+            || !toInt(optionTopicFanout, 1, &config->topicFanout)
+            || !toInt(optionPayloadSize, int(sizeof(qint64)), &config->payloadSize)
+            || !toInt(optionDuration, 1, &config->durationSeconds)
+            || !toInt(optionInterval, 1, &config->reportSeconds)
+            || !toInt(optionRampUp, 0, &config->rampUpMilliseconds)
+            || !toInt(optionReconnectDelay, 0, &config->reconnectDelayMilliseconds)) {
+        return false;
+    }
+
+    if (!toInt(optionSubscriptionQos, 0, &value) || value > 2)
+        return false;
+    config->subscriptionQos = quint8(value);
+
+    bool ok = false;
+    config->rate = parser.value(optionRate).toDouble(&ok);
+    if (!ok || config->rate <= 0) {
+        qWarning() << "Invalid publish rate specified:" << parser.value(optionRate);
+        return false;
+    }
+
+    const QStringList weights = parser.value(optionQosMix).split(QLatin1Char(','));
+    int weightSum = 0;
+    for (int qos = 0; qos < 3; ++qos) {
+        config->qosWeights[qos] = qos < weights.size() ? weights.at(qos).toInt(&ok) : 0;
+        if (!ok || config->qosWeights[qos] < 0 || weights.size() > 3) {
+            qWarning() << "Invalid QoS mix specified:" << parser.value(optionQosMix);
+            return false;
+        }
+        weightSum += config->qosWeights[qos];
+    }
+    if (weightSum == 0) {
+        qWarning() << "The QoS mix must not be all zero.";
+        return false;
+    }
+
+    // Build the topic tree
+    config->topicPrefix = parser.value(optionTopicPrefix);
+    qint64 topicCount = 1;
+    for (int level = 0; level < config->topicDepth; ++level) {
+        topicCount *= config->topicFanout;
+        if (topicCount > 1000000) {
+            qWarning() << "The topic tree must not contain more than 1000000 topics.";
+            return false;
+        }
+    }
+    QStringList topics{config->topicPrefix};
+    for (int level = 0; level < config->topicDepth; ++level) {
+        QStringList next;
+        next.reserve(topics.size() * config->topicFanout);
+        for (const QString &topic : std::as_const(topics)) {
+            for (int i = 0; i < config->topicFanout; ++i)
+                next.append(topic + QLatin1Char('/') + QString::number(i));
+        }
+        topics.swap(next);
+    }
+    config->topics.reserve(topics.size());
+    for (const QString &topic : std::as_const(topics))
+        config->topics.append(QMqttTopicName(topic));
+    if (!config->topics.constFirst().isValid()) {
+        qWarning() << "The specified topic prefix is invalid.";
+        return false;
+    }
+
+    config->subscriptionFilter = parser.isSet(optionFilter)
+            ? parser.value(optionFilter)
+            : config->topicPrefix + QLatin1String(config->topicDepth > 0 ? "/#" : "");
+    if (!QMqttTopicFilter(config->subscriptionFilter).isValid()) {
+        qWarning() << "The specified subscription topic is invalid.";
+        return false;
+    }
+
+    if (parser.isSet(optionDebug))
+        QLoggingCategory::setFilterRules(QLatin1String("qt.mqtt.*=true"));
+
+    // Output:
+    qInfo() << "Load configuration:";
+    qInfo() << "  Host:" << config->hostName << " Port:" << config->port
+            << " Protocol:" << config->protocolVersion;
+    qInfo() << "  Publishers:" << config->publishers << " Subscribers:" << config->subscribers
+            << " Threads:" << config->threads;
+    qInfo() << "  Topics:" << config->topics.size() << " Filter:" << config->subscriptionFilter;
+    qInfo() << "  Rate:" << config->rate << "msg/s per publisher  Payload:" << config->payloadSize
+            << "bytes  QoS mix:" << config->qosWeights[0] << config->qosWeights[1]
+            << config->qosWeights[2];
+
+    return true;
+}
+
+// Sum of the statistics of all workers at one point in time
+struct Totals
+{
+    quint64 published{0};
+    quint64 publishFailed{0};
+    quint64 acknowledged{0};
+    quint64 received{0};
+    quint64 receivedBytes{0};
+    quint64 malformed{0};
+    quint32 connected{0};
+    quint32 disconnects{0};
+    quint32 reconnects{0};
+    quint32 errors{0};
+    Histogram::Buckets latency{};
+    Histogram::Buckets reconnectTime{};
+
+    void add(const Statistics &s)
+    {
+        published += s.published.loadRelaxed();
+        publishFailed += s.publishFailed.loadRelaxed();
+        acknowledged += s.acknowledged.loadRelaxed();
+        received += s.received.loadRelaxed();
+        receivedBytes += s.receivedBytes.loadRelaxed();
+        malformed += s.malformed.loadRelaxed();
+        connected += s.connected.loadRelaxed();
+        disconnects += s.disconnects.loadRelaxed();
+        reconnects += s.reconnects.loadRelaxed();
+        errors += s.errors.loadRelaxed();
+        s.latency.addTo(&latency);
+        s.reconnectTime.addTo(&reconnectTime);
+    }
+};
+
+static QString formatMicroseconds(qint64 value)
+{
+    if (value < 1000)
+        return QString::number(value) + QLatin1String("us");
+    if (value < 1000000)
+        return QString::number(double(value) / 1000, 'f', 2) + QLatin1String("ms");
+    return QString::number(double(value) / 1000000, 'f', 2) + QLatin1String("s");
+}
+
+static QString formatLatency(const Histogram::Buckets &buckets)
+{
+    return QLatin1String("p50 %1 p99 %2 p999 %3")
+            .arg(formatMicroseconds(Histogram::percentile(buckets, 0.5)),
+                 formatMicroseconds(Histogram::percentile(buckets, 0.99)),
+                 formatMicroseconds(Histogram::percentile(buckets, 0.999)));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("qtmqtt_loadgenerator"));
+    QCoreApplication::setApplicationVersion(QStringLiteral("1.0"));
+
+    Configuration config;
+    if (!parseConfiguration(&a, &config))
+        return -1;
+
+    // Distribute the clients evenly, each worker gets a thread of its own
+    const int threadCount = qMin(config.threads, qMax(1, config.publishers + config.subscribers));
+    std::vector<std::unique_ptr<QThread>> threads;
+    QList<Worker *> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        auto *worker = new Worker(config);
+        threads.emplace_back(new QThread);
+        threads.back()->setObjectName(QLatin1String("Worker %1").arg(QString::number(i)));
+        worker->moveToThread(threads.back().get());
+        threads.back()->start();
+        workers.append(worker);
+
+        const auto share = [threadCount, i](int count) {
+            return std::make_pair(count * i / threadCount, count * (i + 1) / threadCount);
+        };
+        const auto publishers = share(config.publishers);
+        const auto subscribers = share(config.subscribers);
+        QMetaObject::invokeMethod(worker, [=]() {
+            worker->start(publishers.first, publishers.second - publishers.first,
+                          subscribers.first, subscribers.second - subscribers.first);
+        });
+    }
+
+    const auto totals = [&workers]() {
+        Totals t;
+        for (const Worker *worker : std::as_const(workers))
+            t.add(worker->statistics());
+        return t;
+    };
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    Totals previous;
+    QTimer reportTimer;
+    QObject::connect(&reportTimer, &QTimer::timeout, [&]() {
+        const Totals current = totals();
+        const auto perSecond = [&config](quint64 now, quint64 before) {
+            return qRound64(double(now - before) / config.reportSeconds);
+        };
+        Histogram::Buckets latency;
+        for (int i = 0; i < Histogram::BucketCount; ++i)
+            latency[i] = current.latency[i] - previous.latency[i];
+
+        qInfo().noquote() << QString::asprintf("%6.1fs", double(elapsed.elapsed()) / 1000)
+                          << "connected" << current.connected
+                          << "| pub" << perSecond(current.published, previous.published)
+                          << "msg/s | ack" << perSecond(current.acknowledged, previous.acknowledged)
+                          << "msg/s | sub" << perSecond(current.received, previous.received)
+                          << "msg/s" << perSecond(current.receivedBytes, previous.receivedBytes)
+                          << "B/s |" << formatLatency(latency)
+                          << "| disconnects" << current.disconnects - previous.disconnects
+                          << "reconnects" << current.reconnects - previous.reconnects;
+        previous = current;
+    });
+    reportTimer.start(config.reportSeconds * 1000);
+
+    const auto onAllWorkers = [&workers](void (Worker::*function)()) {
+        for (Worker *worker : std::as_const(workers))
+            QMetaObject::invokeMethod(worker, function, Qt::BlockingQueuedConnection);
+    };
+
+    const int runTime = config.rampUpMilliseconds + config.durationSeconds * 1000;
+    QTimer::singleShot(runTime, &a, [&]() {
+        // Stop publishing, but give the subscribers time to receive what is in flight
+        onAllWorkers(&Worker::stop);
+        QTimer::singleShot(config.drainMilliseconds, &a, [&]() {
+            reportTimer.stop();
+            const Totals t = totals();
+            const double seconds = double(elapsed.elapsed()) / 1000;
+
+            qInfo() << "Summary:";
+            qInfo() << "  Published:" << t.published << " Failed:" << t.publishFailed
+                    << " Acknowledged:" << t.acknowledged;
+            qInfo() << "  Received:" << t.received << " Bytes:" << t.receivedBytes
+                    << " Malformed:" << t.malformed;
+            qInfo() << "  Throughput:" << qRound64(double(t.published) / seconds)
+                    << "msg/s published," << qRound64(double(t.received) / seconds)
+                    << "msg/s received";
+            qInfo().noquote() << "  Latency:" << formatLatency(t.latency) << "max"
+                              << formatMicroseconds(Histogram::percentile(t.latency, 1.0));
+            qInfo().noquote() << "  Disconnects:" << t.disconnects << " Reconnects:"
+                              << t.reconnects << " Errors:" << t.errors
+                              << " Time to reconnect:" << formatLatency(t.reconnectTime);
+
+            onAllWorkers(&Worker::disconnectAll);
+            QTimer::singleShot(500, &a, &QCoreApplication::quit);
+        });
+    });
+
+    const int result = a.exec();
+
+    for (int i = 0; i < threadCount; ++i) {
+        Worker *worker = workers.at(i);
+        QMetaObject::invokeMethod(worker, [worker]() { delete worker; },
+                                  Qt::BlockingQueuedConnection);
+        threads[i]->quit();
+        threads[i]->wait();
+    }
+    return result;
+}